@@ -14,12 +14,7 @@
     ENTITY_TYPE(FirePlant)\
     ENTITY_TYPE(Star)\
     ENTITY_TYPE(Fireball)\
-    ENTITY_TYPE(TileBreakAnim)\
-    ENTITY_TYPE(EnemyFallAnim)\
     ENTITY_TYPE(CameraRegion)\
-    ENTITY_TYPE(TimedSprite)\
-    ENTITY_TYPE(TimedAnim)\
-    ENTITY_TYPE(CoinDropAnim)\
     ENTITY_TYPE(BackgroundPlane)\
     ENTITY_TYPE(BackgroundSprite)\
     ENTITY_TYPE(FireBar)\
@@ -28,7 +23,6 @@
     ENTITY_TYPE(Coin)\
     ENTITY_TYPE(Portal)\
     ENTITY_TYPE(MovingPlatform)\
-    ENTITY_TYPE(FloatingText)\
     ENTITY_TYPE(Trigger)\
     ENTITY_TYPE(TriggerableText)\
     ENTITY_TYPE(BackgroundImage)\
@@ -68,6 +62,15 @@
     SERIALIZE(Mushroom)\
     SERIALIZE(SideMovingPlatform)
 
+// Serialized entities that can be kept in level sections when the level is streamed, none of these are referenced by other entities
+#define TO_STREAM\
+    STREAM(Goomba)\
+    STREAM(Koopa)\
+    STREAM(Piranha)\
+    STREAM(FireBar)\
+    STREAM(Coin)\
+    STREAM(BackgroundSprite)
+
 #define Z_PLAYER_POS    0
 #define Z_GOOMBA_POS    1
 #define Z_KOOPA_POS     1
@@ -122,6 +125,7 @@
     IFD_PROC(init_koopa_common_data)\
     IFD_PROC(init_piranha_common_data)\
     IFD_PROC(init_tilemap_common_data)\
+    IFD_PROC(init_level_effects_common_data)\
     IFD_PROC(init_power_up_common_data)\
     IFD_PROC(init_fire_bar_common_data)\
     IFD_PROC(init_level_entities_common_data)\
@@ -1,15 +1,611 @@
 #include "audio_player.h"
 #include "common.h"
 #include "data.h"
+#include "parallel_update.h"
+#include "profiler.h"
+#include "memory_tags.h"
 
 #include <SDL_mixer.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_MIX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define AUDIO_MIX_BLOCK_FRAMES 512 // A buffer is mixed in blocks of this, so any buffer size works
+
+static_assert((AUDIO_QUEUE_CAPACITY & (AUDIO_QUEUE_CAPACITY - 1)) == 0);
+
+// Decoded samples of a track at the device rate, mono when both channels were the same all the way through
+struct MusicPcm {
+    int16_t *samples;
+    int32_t  frame_count;
+    int32_t  channels;
+};
+
+struct MusicTrack {
+    std::string filepath;
+
+    // Written by the decode thread before prefix_ready, read only after it by the mixer
+    MusicPcm prefix;
+    bool     prefix_is_whole_track; // The file was smaller than AUDIO_MUSIC_PREFIX_FILE_SIZE
+    std::atomic<bool> prefix_ready;
+
+    // Decoded while it's the requested track, the main thread takes it away once another one is requested
+    std::atomic<MusicPcm *> whole;
+};
 
 namespace {
+    enum EAudioRequest : int32_t {
+        AUDIO_REQUEST_PLAY_SOUND,
+        AUDIO_REQUEST_STOP_SOUNDS,
+        AUDIO_REQUEST_SOUND_VOLUME,
+        AUDIO_REQUEST_PLAY_MUSIC,
+        AUDIO_REQUEST_STOP_MUSIC,
+        AUDIO_REQUEST_PAUSE_MUSIC,
+        AUDIO_REQUEST_RESUME_MUSIC,
+        AUDIO_REQUEST_MUSIC_VOLUME
+    };
+
+    struct AudioRequest {
+        EAudioRequest type;
+        Sound      *sound;
+        MusicTrack *track;
+        int32_t     value; // Loops or volume
+    };
+
+    // Single producer, single consumer. The indices only grow, the slot is the index modulo the capacity.
+    // Requests up to queue_pending are written, a_flush_requests publishes them to the mixer by moving queue_write
+    AudioRequest requests[AUDIO_QUEUE_CAPACITY];
+    uint32_t queue_pending = 0;
+    std::atomic<uint32_t> queue_write = 0;
+    std::atomic<uint32_t> queue_read  = 0;
+    std::atomic<uint32_t> queue_applied = 0; // Requests before it took effect, the mixer stores it before mixing the buffer
+
+    /* Mixer state, only touched by the audio callback */
+    struct Voice {
+        Sound   *sound; // NULL when free
+        int32_t  position;
+        int32_t  loops;
+        uint64_t started; // Orders the voices so the oldest one gets stolen
+    };
+
+    Voice    voices[AUDIO_VOICES];
+    uint64_t voices_started = 0;
+    int32_t  mixer_sound_volume = 0;
+    int32_t  mixer_music_volume = 0;
+
+    MusicTrack *mixer_track = NULL;
+    int32_t     mixer_music_position = 0;
+    int32_t     mixer_music_loops    = 0;
+    bool        mixer_music_paused   = false;
+    bool        mixer_thread_named   = false;
+
+    alignas(16) int32_t mix_buffer[AUDIO_MIX_BLOCK_FRAMES * 2];
+
+    // Bumped after every mixed buffer, a whole track taken away at epoch n isn't read anymore once this is past n
+    std::atomic<uint64_t> mix_epoch = 0;
+    std::atomic<bool>     mixer_music_playing = false;
+    std::atomic<int32_t>  deduplicated_count  = 0;
+    std::atomic<int32_t>  stolen_count        = 0;
+    std::atomic<int32_t>  underrun_count      = 0;
+
+    /* Decode thread */
+    struct DecodeJob {
+        MusicTrack *track;
+        bool        whole; // Otherwise only the prefix
+    };
+
+    std::thread             decode_thread;
+    std::mutex              decode_mutex;
+    std::condition_variable decode_cv;
+    std::deque<DecodeJob>   decode_jobs;
+    MusicTrack             *decoding_track = NULL;
+    bool                    decode_quit    = false;
+
+    std::atomic<MusicTrack *> requested_track = NULL;
+
+    /* Main thread */
+    struct RetiredMusic {
+        MusicPcm *pcm;
+        uint64_t  epoch;
+    };
+
+    std::vector<MusicTrack *>  tracks;
+    std::vector<RetiredMusic>  retired_music;
+    uint32_t music_switch_request = 0; // Queue index after the last play or stop music request
+
+    AudioQueueStats queue_stats;
+
     bool _initialized = false;
     bool allow_play_sounds = true;
 
+    // Requested state, the queries can't wait for the mixer
     int32_t last_set_non_zero_music_volume;
-    Mix_Music *last_played_music;
+    int32_t music_volume;
+    bool    music_paused;
+    MusicTrack *last_played_music;
+}
+
+static
+void push_request(EAudioRequest type, Sound *sound, MusicTrack *track, int32_t value) {
+    const uint32_t pending = queue_pending;
+    if(pending - queue_read.load(std::memory_order_acquire) == AUDIO_QUEUE_CAPACITY) {
+        queue_stats.dropped += 1;
+        return;
+    }
+
+    AudioRequest *request = &requests[pending & (AUDIO_QUEUE_CAPACITY - 1)];
+    request->type  = type;
+    request->sound = sound;
+    request->track = track;
+    request->value = value;
+    queue_pending = pending + 1;
+}
+
+// Up to the write index the caller loaded, requests published meanwhile wait for the next buffer
+static
+bool pop_request(AudioRequest *out_request, uint32_t write) {
+    const uint32_t read = queue_read.load(std::memory_order_relaxed);
+    if(read == write) {
+        return false;
+    }
+
+    *out_request = requests[read & (AUDIO_QUEUE_CAPACITY - 1)];
+    queue_read.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+/* --- Decoding --- */
+
+static
+void free_music_pcm(MusicPcm *pcm) {
+    tagged_free(pcm->samples);
+    pcm->samples = NULL;
+    pcm->frame_count = 0;
+}
+
+// Copies up to max_frames of the chunk, which SDL_mixer converted to the device format
+static
+void fill_music_pcm(MusicPcm *out_pcm, Mix_Chunk *chunk, int32_t max_frames) {
+    const int16_t *samples = chunk != NULL ? (const int16_t *)chunk->abuf : NULL;
+    const int32_t frame_count = chunk != NULL ? min_value((int32_t)(chunk->alen / (2 * sizeof(int16_t))), max_frames) : 0;
+
+    bool mono = true;
+    for(int32_t frame = 0; frame < frame_count && mono; ++frame) {
+        mono = samples[frame * 2] == samples[frame * 2 + 1];
+    }
+
+    out_pcm->frame_count = frame_count;
+    out_pcm->channels    = mono ? 1 : 2;
+    out_pcm->samples     = (int16_t *)tagged_malloc(MEMORY_TAG_AUDIO, max_value(frame_count, 1) * out_pcm->channels * sizeof(int16_t));
+    if(mono) {
+        for(int32_t frame = 0; frame < frame_count; ++frame) {
+            out_pcm->samples[frame] = samples[frame * 2];
+        }
+    } else if(frame_count > 0) {
+        memcpy(out_pcm->samples, samples, frame_count * 2 * sizeof(int16_t));
+    }
+}
+
+// The start of the file decodes to the same samples as the start of the whole file, so the mixer can go on in the whole track where the prefix ends
+static
+void decode_music_prefix(MusicTrack *track) {
+    PROFILE_FUNCTION();
+
+    void  *file_data = tagged_malloc(MEMORY_TAG_FILE_DATA, AUDIO_MUSIC_PREFIX_FILE_SIZE);
+    size_t file_size = 0;
+
+    FILE *file = NULL;
+    if(fopen_s(&file, track->filepath.c_str(), "rb") == 0) {
+        file_size = fread(file_data, 1, AUDIO_MUSIC_PREFIX_FILE_SIZE, file);
+        fclose(file);
+    }
+
+    Mix_Chunk *chunk = file_size > 0 ? Mix_LoadWAV_RW(SDL_RWFromConstMem(file_data, (int32_t)file_size), 1) : NULL;
+    if(chunk == NULL) {
+        fprintf(stderr, "Couldn't decode the start of \"%s\".\n", track->filepath.c_str());
+    }
+
+    // A broken file becomes an empty track that ends right away
+    track->prefix_is_whole_track = file_size < AUDIO_MUSIC_PREFIX_FILE_SIZE || chunk == NULL;
+    fill_music_pcm(&track->prefix, chunk, track->prefix_is_whole_track ? INT32_MAX : AUDIO_MUSIC_PREFIX_SECONDS * AUDIO_FREQUENCY);
+    track->prefix_ready.store(true, std::memory_order_release);
+
+    if(chunk != NULL) {
+        Mix_FreeChunk(chunk);
+    }
+    tagged_free(file_data);
+}
+
+static
+MusicPcm *decode_whole_music(MusicTrack *track) {
+    PROFILE_FUNCTION();
+
+    Mix_Chunk *chunk = Mix_LoadWAV_RW(SDL_RWFromFile(track->filepath.c_str(), "rb"), 1);
+    if(chunk == NULL) {
+        fprintf(stderr, "Couldn't decode \"%s\".\n", track->filepath.c_str());
+        return NULL;
+    }
+
+    MusicPcm *pcm = tagged_malloc_and_zero_struct(MEMORY_TAG_AUDIO, MusicPcm);
+    fill_music_pcm(pcm, chunk, INT32_MAX);
+    Mix_FreeChunk(chunk);
+    return pcm;
+}
+
+static
+void run_decode_job(DecodeJob job) {
+    MusicTrack *track = job.track;
+    if(!track->prefix_ready.load(std::memory_order_acquire)) {
+        decode_music_prefix(track);
+    }
+
+    // Skipped when another track got requested while this one waited
+    if(!job.whole || track->prefix_is_whole_track || requested_track.load(std::memory_order_acquire) != track || track->whole.load(std::memory_order_acquire) != NULL) {
+        return;
+    }
+
+    MusicPcm *whole = decode_whole_music(track);
+    MusicPcm *expected = NULL;
+    if(whole != NULL && !track->whole.compare_exchange_strong(expected, whole, std::memory_order_acq_rel)) {
+        free_music_pcm(whole);
+        tagged_free(whole);
+    }
+}
+
+static
+void decode_worker(void) {
+    set_profiler_thread_name("audio decode");
+
+    std::unique_lock<std::mutex> lock(decode_mutex);
+    for(;;) {
+        decode_cv.wait(lock, [] { return decode_quit || !decode_jobs.empty(); });
+        if(decode_quit) {
+            break;
+        }
+
+        DecodeJob job = decode_jobs.front();
+        decode_jobs.pop_front();
+        decoding_track = job.track;
+
+        lock.unlock();
+        run_decode_job(job);
+        lock.lock();
+
+        decoding_track = NULL;
+        decode_cv.notify_all();
+    }
+}
+
+// Whole tracks go first, something is waiting for them
+static
+void queue_decode(MusicTrack *track, bool whole) {
+    if(!_initialized) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex);
+        if(whole) {
+            decode_jobs.push_front({ track, true });
+        } else {
+            decode_jobs.push_back({ track, false });
+        }
+    }
+    decode_cv.notify_all();
+}
+
+// Whole tracks other than the requested one are taken away, the mixer is done with one once the buffer it might have been mixing is done.
+// Not before the mixer applied the request that switched away from it, until then the old track is still the one being mixed.
+static
+void release_whole_music(bool force) {
+    MusicTrack *requested = requested_track.load(std::memory_order_relaxed);
+    const bool switch_applied = (int32_t)(queue_applied.load(std::memory_order_acquire) - music_switch_request) >= 0;
+    for(MusicTrack *track : tracks) {
+        if((track == requested || !switch_applied) && !force) {
+            continue;
+        }
+
+        MusicPcm *whole = track->whole.exchange(NULL, std::memory_order_acq_rel);
+        if(whole != NULL) {
+            retired_music.push_back({ whole, mix_epoch.load(std::memory_order_acquire) });
+        }
+    }
+
+    const uint64_t epoch = mix_epoch.load(std::memory_order_acquire);
+    for(int32_t idx = (int32_t)retired_music.size() - 1; idx >= 0; --idx) {
+        if(epoch > retired_music[idx].epoch || force || !_initialized) {
+            free_music_pcm(retired_music[idx].pcm);
+            tagged_free(retired_music[idx].pcm);
+            retired_music[idx] = retired_music.back();
+            retired_music.pop_back();
+        }
+    }
+}
+
+/* --- Mixing --- */
+
+// Adds sample * volume to both channels of the mix, a mono source goes to both
+static
+void mix_samples(int32_t *mix, const int16_t *samples, int32_t channels, int32_t frame_count, int32_t volume) {
+    int32_t frame = 0;
+#if AUDIO_MIX_SSE2
+    // (volume, 0) pairs, madd multiplies a sample by the volume and the zero next to it by 0
+    const __m128i volume_pairs = _mm_set1_epi32(volume);
+    const __m128i zero = _mm_setzero_si128();
+    for(; frame + 4 <= frame_count; frame += 4) {
+        __m128i stereo;
+        if(channels == 2) {
+            stereo = _mm_loadu_si128((const __m128i *)(samples + frame * 2));
+        } else {
+            const __m128i mono = _mm_loadl_epi64((const __m128i *)(samples + frame));
+            stereo = _mm_unpacklo_epi16(mono, mono);
+        }
+
+        __m128i *out = (__m128i *)(mix + frame * 2); // Voices start anywhere in the block, so unaligned
+        _mm_storeu_si128(out,     _mm_add_epi32(_mm_loadu_si128(out),     _mm_madd_epi16(_mm_unpacklo_epi16(stereo, zero), volume_pairs)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_madd_epi16(_mm_unpackhi_epi16(stereo, zero), volume_pairs)));
+    }
+#endif
+
+    for(; frame < frame_count; ++frame) {
+        mix[frame * 2]     += (int32_t)samples[frame * channels] * volume;
+        mix[frame * 2 + 1] += (int32_t)samples[frame * channels + channels - 1] * volume;
+    }
+}
+
+// Volumes are 0 to MIX_MAX_VOLUME (128) like SDL_mixer's, the sum is clipped once instead of after every voice
+static
+void write_mix(int16_t *out, const int32_t *mix, int32_t sample_count) {
+    int32_t idx = 0;
+#if AUDIO_MIX_SSE2
+    for(; idx + 8 <= sample_count; idx += 8) {
+        const __m128i lo = _mm_srai_epi32(_mm_load_si128((const __m128i *)(mix + idx)), 7);
+        const __m128i hi = _mm_srai_epi32(_mm_load_si128((const __m128i *)(mix + idx + 4)), 7);
+        _mm_storeu_si128((__m128i *)(out + idx), _mm_packs_epi32(lo, hi));
+    }
+#endif
+
+    for(; idx < sample_count; ++idx) {
+        out[idx] = (int16_t)clamp(mix[idx] >> 7, -32768, 32767);
+    }
+}
+
+// A free voice unless the sound is at its limit, then its oldest voice. Without a free voice the oldest voice of all
+static
+int32_t find_voice_for(Sound *sound, bool *out_stolen) {
+    int32_t free_voice  = -1;
+    int32_t oldest_same = -1;
+    int32_t oldest_any  = -1;
+    int32_t same_count  = 0;
+
+    for(int32_t idx = 0; idx < AUDIO_VOICES; ++idx) {
+        if(voices[idx].sound == NULL) {
+            if(free_voice == -1) free_voice = idx;
+            continue;
+        }
+
+        if(voices[idx].sound == sound) {
+            same_count += 1;
+            if(oldest_same == -1 || voices[idx].started < voices[oldest_same].started) oldest_same = idx;
+        }
+        if(oldest_any == -1 || voices[idx].started < voices[oldest_any].started) oldest_any = idx;
+    }
+
+    if(same_count >= max_value(sound->max_voices, 1)) {
+        *out_stolen = true;
+        return oldest_same;
+    }
+
+    *out_stolen = free_voice == -1;
+    return free_voice != -1 ? free_voice : oldest_any;
+}
+
+static
+void start_voice(Sound *sound, int32_t loops) {
+    if(sound->frame_count == 0) {
+        return;
+    }
+
+    bool stolen = false;
+    Voice *voice = &voices[find_voice_for(sound, &stolen)];
+    if(stolen) {
+        stolen_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    voice->sound    = sound;
+    voice->position = 0;
+    voice->loops    = loops;
+    voice->started  = voices_started++;
+}
+
+// Everything published since the last buffer. A row of goombas dying in the same frame is one kill sound
+static
+void apply_requests(void) {
+    Sound  *played[AUDIO_QUEUE_CAPACITY];
+    int32_t played_loops[AUDIO_QUEUE_CAPACITY];
+    int32_t played_count = 0;
+
+    // At most AUDIO_QUEUE_CAPACITY requests up to this, so they fit into played
+    const uint32_t write = queue_write.load(std::memory_order_acquire);
+
+    AudioRequest request;
+    while(pop_request(&request, write)) {
+        switch(request.type) {
+            case AUDIO_REQUEST_PLAY_SOUND: {
+                bool duplicate = false;
+                for(int32_t idx = 0; idx < played_count && !duplicate; ++idx) {
+                    duplicate = played[idx] == request.sound && played_loops[idx] == request.value;
+                }
+                if(duplicate) {
+                    deduplicated_count.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+
+                played[played_count] = request.sound;
+                played_loops[played_count] = request.value;
+                played_count += 1;
+                start_voice(request.sound, request.value);
+            } break;
+
+            case AUDIO_REQUEST_STOP_SOUNDS: {
+                for(Voice &voice : voices) {
+                    voice.sound = NULL;
+                }
+                played_count = 0;
+            } break;
+
+            case AUDIO_REQUEST_SOUND_VOLUME: {
+                mixer_sound_volume = min_value(request.value, MIX_MAX_VOLUME);
+            } break;
+
+            case AUDIO_REQUEST_PLAY_MUSIC: {
+                mixer_track = request.track;
+                mixer_music_position = 0;
+                mixer_music_loops    = request.value > 0 ? request.value - 1 : request.value; // Mix_PlayMusic counted plays, not repeats
+                mixer_music_paused   = false;
+            } break;
+
+            case AUDIO_REQUEST_STOP_MUSIC: {
+                mixer_track = NULL;
+            } break;
+
+            case AUDIO_REQUEST_PAUSE_MUSIC: {
+                mixer_music_paused = true;
+            } break;
+
+            case AUDIO_REQUEST_RESUME_MUSIC: {
+                mixer_music_paused = false;
+            } break;
+
+            case AUDIO_REQUEST_MUSIC_VOLUME: {
+                mixer_music_volume = min_value(request.value, MIX_MAX_VOLUME);
+            } break;
+        }
+    }
+    queue_applied.store(write, std::memory_order_release);
+}
+
+static
+void mix_voices(int32_t *mix, int32_t frame_count) {
+    for(Voice &voice : voices) {
+        int32_t mixed = 0;
+        while(voice.sound != NULL && mixed < frame_count) {
+            const int32_t count = min_value(frame_count - mixed, voice.sound->frame_count - voice.position);
+            mix_samples(mix + mixed * 2, voice.sound->samples + voice.position * 2, 2, count, mixer_sound_volume);
+            voice.position += count;
+            mixed += count;
+
+            if(voice.position == voice.sound->frame_count) {
+                if(voice.loops == 0) {
+                    voice.sound = NULL;
+                } else {
+                    voice.position = 0;
+                    voice.loops -= voice.loops > 0 ? 1 : 0;
+                }
+            }
+        }
+    }
+}
+
+// The whole track once it's decoded, the prefix until then. Returns false if the prefix ran out before the whole track was there
+static
+bool mix_music(int32_t *mix, int32_t frame_count) {
+    int32_t mixed = 0;
+    while(mixer_track != NULL && !mixer_music_paused && mixed < frame_count) {
+        MusicTrack *track = mixer_track;
+        const MusicPcm *whole = track->whole.load(std::memory_order_acquire);
+        const bool prefix_ready = track->prefix_ready.load(std::memory_order_acquire);
+
+        const MusicPcm *source = whole != NULL ? whole : (prefix_ready ? &track->prefix : NULL);
+        const bool source_is_whole = whole != NULL || (prefix_ready && track->prefix_is_whole_track);
+        if(source == NULL || (mixer_music_position >= source->frame_count && !source_is_whole)) {
+            return false;
+        }
+
+        if(mixer_music_position >= source->frame_count) {
+            if(mixer_music_loops == 0 || source->frame_count == 0) {
+                mixer_track = NULL;
+            } else {
+                mixer_music_position = 0;
+                mixer_music_loops -= mixer_music_loops > 0 ? 1 : 0;
+            }
+            continue;
+        }
+
+        const int32_t count = min_value(frame_count - mixed, source->frame_count - mixer_music_position);
+        mix_samples(mix + mixed * 2, source->samples + mixer_music_position * source->channels, source->channels, count, mixer_music_volume);
+        mixer_music_position += count;
+        mixed += count;
+    }
+    return true;
+}
+
+// Hooked in as SDL_mixer's music mixer, so it gets the whole buffer of the audio callback. SDL_mixer has no channels to add to it
+static
+void SDLCALL mix_audio(void *user_data, Uint8 *stream, int byte_count) {
+    if(!mixer_thread_named) {
+        set_profiler_thread_name("audio");
+        mixer_thread_named = true;
+    }
+    PROFILE_FUNCTION();
+
+    apply_requests();
+
+    int16_t *out = (int16_t *)stream;
+    const int32_t frame_count = byte_count / (int32_t)(2 * sizeof(int16_t));
+    bool underrun = false;
+
+    for(int32_t block = 0; block < frame_count; block += AUDIO_MIX_BLOCK_FRAMES) {
+        const int32_t block_frames = min_value(frame_count - block, AUDIO_MIX_BLOCK_FRAMES);
+        zero_memory(mix_buffer, block_frames * 2 * sizeof(int32_t));
+
+        mix_voices(mix_buffer, block_frames);
+        underrun |= !mix_music(mix_buffer, block_frames);
+        write_mix(out + block * 2, mix_buffer, block_frames * 2);
+    }
+
+    if(underrun) {
+        underrun_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    mixer_music_playing.store(mixer_track != NULL, std::memory_order_relaxed);
+    mix_epoch.fetch_add(1, std::memory_order_release);
+}
+
+/* --- Requests --- */
+
+void audio_player::a_flush_requests(void) {
+    PROFILE_FUNCTION();
+
+    queue_stats.requests = (int32_t)(queue_pending - queue_write.load(std::memory_order_relaxed));
+    queue_write.store(queue_pending, std::memory_order_release);
+
+    // Nothing mixes them without a device
+    if(!_initialized) {
+        queue_read.store(queue_pending, std::memory_order_release);
+        queue_applied.store(queue_pending, std::memory_order_release);
+    }
+
+    release_whole_music(false);
+}
+
+AudioQueueStats audio_player::a_get_queue_stats(void) {
+    AudioQueueStats stats = queue_stats;
+    stats.deduplicated    = deduplicated_count.load(std::memory_order_relaxed);
+    stats.stolen          = stolen_count.load(std::memory_order_relaxed);
+    stats.music_underruns = underrun_count.load(std::memory_order_relaxed);
+    stats.resident_music  = 0;
+    for(MusicTrack *track : tracks) {
+        stats.resident_music += track->whole.load(std::memory_order_relaxed) != NULL ? 1 : 0;
+    }
+    return stats;
 }
 
 void audio_player::a_set_allow_play_sounds(bool allow) {
@@ -17,73 +613,114 @@ void audio_player::a_set_allow_play_sounds(bool allow) {
 }
 
 void audio_player::a_set_sound_volume(uint8_t volume) {
-    Mix_Volume(-1, volume);
+    push_request(AUDIO_REQUEST_SOUND_VOLUME, NULL, NULL, volume);
 }
 
 void audio_player::a_set_music_volume(uint8_t volume) {
-    Mix_VolumeMusic(volume);
+    push_request(AUDIO_REQUEST_MUSIC_VOLUME, NULL, NULL, volume);
+    music_volume = volume;
 
     if(volume > 0) {
         last_set_non_zero_music_volume = volume;
     }
 }
 
-Sound *load_sound_wav(const char *filepath) {
-    Sound *sound = malloc_and_zero_struct(Sound);
+Sound *load_sound_wav(const char *filepath, int32_t max_voices) {
+    Sound *sound = tagged_malloc_and_zero_struct(MEMORY_TAG_AUDIO, Sound);
     if(sound == NULL) {
         // fprintf(stderr, "Couldn't create memory for Sound.\n");
         return NULL;
     }
 
-    sound->chunk = Mix_LoadWAV(filepath);
-    if(sound->chunk == NULL) {
+    // SDL_mixer converts it to the device format
+    Mix_Chunk *chunk = Mix_LoadWAV(filepath);
+    if(chunk == NULL) {
         // fprintf(stderr, "Couldn't load .wav sound from filepath.\n");
-        free(sound);
+        tagged_free(sound);
         return NULL;
     }
+    sound->chunk       = chunk;
+    sound->samples     = (int16_t *)chunk->abuf;
+    sound->frame_count = (int32_t)(chunk->alen / (2 * sizeof(int16_t)));
+    sound->max_voices  = max_voices;
 
+    add_tagged_bytes(MEMORY_TAG_AUDIO, chunk->alen); // Decoded samples, allocated by SDL_mixer
     return sound;
 }
 
 void delete_sound(Sound *sound) {
     assert(sound != NULL);
+    add_tagged_bytes(MEMORY_TAG_AUDIO, -(int64_t)((Mix_Chunk *)sound->chunk)->alen);
     Mix_FreeChunk((Mix_Chunk *)sound->chunk);
-    free(sound);
+    tagged_free(sound);
 }
 
 Music *load_music(const char *filepath) {
-    Music *music = malloc_and_zero_struct(Music);
-    if(music == NULL) {
-        fprintf(stderr, "Couldn't create memory for Music.\n");
+    FILE *file = NULL;
+    if(fopen_s(&file, filepath, "rb") != 0) {
+        fprintf(stderr, "Couldn't load music file from filepath.\n");
         return NULL;
     }
+    fclose(file);
 
-    music->music = Mix_LoadMUS(filepath);
-    if(music->music == NULL) {
-        fprintf(stderr, "Couldn't load music file from filepath.\n");
-        free(music);
+    Music *music = tagged_malloc_and_zero_struct(MEMORY_TAG_AUDIO, Music);
+    if(music == NULL) {
+        fprintf(stderr, "Couldn't create memory for Music.\n");
         return NULL;
     }
 
+    music->track = new MusicTrack();
+    music->track->filepath = filepath;
+    tracks.push_back(music->track);
+
+    queue_decode(music->track, false);
     return music;
 }
 
 void delete_music(Music *music) {
     assert(music != NULL);
-    Mix_FreeMusic((Mix_Music *)music->music);
-    free(music);
+    MusicTrack *track = music->track;
+
+    /* Out of the decode queue */ {
+        std::unique_lock<std::mutex> lock(decode_mutex);
+        for(size_t idx = 0; idx < decode_jobs.size(); ) {
+            if(decode_jobs[idx].track == track) {
+                decode_jobs.erase(decode_jobs.begin() + idx);
+            } else {
+                ++idx;
+            }
+        }
+        decode_cv.wait(lock, [track] { return decoding_track != track; });
+    }
+
+    tracks.erase(std::find(tracks.begin(), tracks.end(), track));
+    MusicPcm *whole = track->whole.exchange(NULL);
+    if(whole != NULL) {
+        free_music_pcm(whole);
+        tagged_free(whole);
+    }
+    if(track->prefix_ready.load()) {
+        free_music_pcm(&track->prefix);
+    }
+    delete track;
+    tagged_free(music);
 }
 
-bool audio_player::a_init(void) {
+bool audio_player::a_init(int32_t buffer_frames) {
     assert(_initialized == false);
 
-    bool audio_open = Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, 1024) == 0;
+    // No format changes allowed, SDL converts for the device if it has to and the mixer only deals with 16 bit stereo
+    bool audio_open = Mix_OpenAudioDevice(AUDIO_FREQUENCY, AUDIO_S16SYS, 2, buffer_frames, NULL, 0) == 0;
     if(!audio_open) {
         fprintf(stderr, "Couldn't open audio device.");
         return false;
     }
 
-    Mix_AllocateChannels(32);
+    Mix_AllocateChannels(0);
+    Mix_HookMusic(mix_audio, NULL);
+
+    decode_quit = false;
+    decode_thread = std::thread(decode_worker);
 
     last_set_non_zero_music_volume = 15;
 
@@ -97,23 +734,39 @@ bool audio_player::a_init(void) {
 }
 
 void audio_player::a_quit(void) {
+    if(!_initialized) {
+        return;
+    }
+
+    Mix_HookMusic(NULL, NULL);
+
+    {
+        std::lock_guard<std::mutex> lock(decode_mutex);
+        decode_quit = true;
+    }
+    decode_cv.notify_all();
+    decode_thread.join();
+
+    release_whole_music(true);
     Mix_CloseAudio();
+    _initialized = false;
 }
 
 void audio_player::a_play_sound(Sound *sound, int32_t loops) {
-    if(allow_play_sounds == false) {
+    if(defer_play_sound(sound, loops)) {
         return;
     }
 
-    assert(sound != NULL && sound->chunk != NULL);
-    bool channel = Mix_PlayChannel(-1, (Mix_Chunk *)sound->chunk, loops);
-    if(channel == -1) {
-	    fprintf(stderr, "No available channel for chunk!\n");
+    if(allow_play_sounds == false) {
+        return;
     }
+
+    assert(sound != NULL && sound->samples != NULL);
+    push_request(AUDIO_REQUEST_PLAY_SOUND, sound, NULL, loops);
 }
 
 void audio_player::a_stop_sounds(void) {
-    Mix_HaltChannel(-1);
+    push_request(AUDIO_REQUEST_STOP_SOUNDS, NULL, NULL, 0);
 }
 
 void audio_player::a_play_music(Music *music, int32_t loops) {
@@ -122,41 +775,50 @@ void audio_player::a_play_music(Music *music, int32_t loops) {
         return;
     }
 
-    assert(music->music != NULL);
-    Mix_PlayMusic((Mix_Music *)music->music, loops);
-    last_played_music = (Mix_Music *)music->music;
+    assert(music->track != NULL);
+    push_request(AUDIO_REQUEST_PLAY_MUSIC, NULL, music->track, loops);
+    requested_track.store(music->track, std::memory_order_release);
+    music_switch_request = queue_pending;
+    queue_decode(music->track, true);
+
+    last_played_music = music->track;
+    music_paused = false;
 }
 
 void audio_player::a_stop_music(void) {
-    Mix_HaltMusic();
+    push_request(AUDIO_REQUEST_STOP_MUSIC, NULL, NULL, 0);
+    requested_track.store(NULL, std::memory_order_release);
+    music_switch_request = queue_pending;
     last_played_music = NULL;
 }
 
 void audio_player::a_pause_music(void) {
-    Mix_PauseMusic();
+    push_request(AUDIO_REQUEST_PAUSE_MUSIC, NULL, NULL, 0);
+    music_paused = true;
 }
 
 void audio_player::a_resume_music(void) {
-    Mix_ResumeMusic();
+    push_request(AUDIO_REQUEST_RESUME_MUSIC, NULL, NULL, 0);
+    music_paused = false;
 }
 
 bool audio_player::a_is_music_paused(void) {
-    return Mix_PausedMusic() == 1;
+    return music_paused;
 }
 
 bool audio_player::a_is_music_playing(void) {
-    return Mix_PlayingMusic() == 1;
+    return mixer_music_playing.load(std::memory_order_relaxed);
 }
 
 bool audio_player::a_is_music(Music *music) {
     if(last_played_music == NULL && music == NULL) return true;
 
-    assert(music != NULL && music->music != NULL);
-    return music->music == last_played_music;
+    assert(music != NULL && music->track != NULL);
+    return music->track == last_played_music;
 }
 
 int32_t audio_player::a_get_music_volume(void) {
-    return Mix_VolumeMusic(-1);
+    return music_volume;
 }
 
 int32_t audio_player::a_get_last_set_music_volume(void) {
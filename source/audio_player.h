@@ -7,24 +7,52 @@
 #define DEF_SOUND_VOLUME 8
 #define DEF_MUSIC_VOLUME 3
 
+#define AUDIO_FREQUENCY              44100
+#define AUDIO_DEFAULT_BUFFER_FRAMES  256  // 5.8ms at 44100, SDL_mixer's default was 1024
+#define AUDIO_VOICES                 32
+#define AUDIO_QUEUE_CAPACITY         256  // Requests between two flushes, a power of two
+#define AUDIO_DEFAULT_MAX_VOICES     4
+#define AUDIO_MUSIC_PREFIX_SECONDS   5    // Decoded ahead for every track, the rest is decoded while this plays
+#define AUDIO_MUSIC_PREFIX_FILE_SIZE KB(256) // Of the file decoded for the prefix, 6.5 seconds even at 320 kbps
+
+// Pre-converted to the device format, 16 bit stereo at AUDIO_FREQUENCY
 struct Sound {
-    void *chunk; // struct Mix_Chunk
+    void    *chunk;       // struct Mix_Chunk, owns the samples
+    int16_t *samples;     // Interleaved left and right
+    int32_t  frame_count;
+    int32_t  max_voices;  // Of this sound at once, a new one cuts the oldest
 };
 
-Sound *load_sound_wav(const char *filepath);
-void delete_sound(Sound *sound);
+Sound *load_sound_wav(const char *filepath, int32_t max_voices = AUDIO_DEFAULT_MAX_VOICES);
+void delete_sound(Sound *sound); // Not while it's playing
 
 struct Music {
-    void *music; // struct Mix_Music
+    struct MusicTrack *track; // Decoded samples, filled by the decode thread
 };
 
-Music *load_music(const char *filepath);
-void delete_music(Music *music);
+Music *load_music(const char *filepath); // NULL if the file is missing, decoding happens in the background
+void delete_music(Music *music); // Not while it's playing
+
+struct AudioQueueStats {
+    int32_t requests;        // Published by the last flush
+    int32_t deduplicated;    // Same sound again in the same mixed buffer, since start
+    int32_t stolen;          // Voices cut for a new one, since start
+    int32_t dropped;         // Queue was full, since start
+    int32_t music_underruns; // Buffers without music because the prefix ended before the whole track was decoded, since start
+    int32_t resident_music;  // Tracks decoded in full right now
+};
 
+// Sound and music requests go into a lock-free single producer queue, a_flush_requests publishes the ones of the frame at once.
+// The mixer runs in the audio callback, takes the published requests at the start of every buffer and mixes the voices and the music.
+// Requests are made on the main thread, parallel updates defer their sounds to it. The music queries answer with what was requested.
+// Music switches are instant because every track's first AUDIO_MUSIC_PREFIX_SECONDS are decoded at load, the whole track is decoded
+// in the background once it's played and dropped again once another track is played.
 namespace audio_player {
     void a_set_allow_play_sounds(bool allow);
+    void a_flush_requests(void);
+    AudioQueueStats a_get_queue_stats(void);
 
-    bool a_init(void);
+    bool a_init(int32_t buffer_frames = AUDIO_DEFAULT_BUFFER_FRAMES); // Frames per mixed buffer, the output latency
     void a_quit(void);
     void a_set_sound_volume(uint8_t volume);
     void a_set_music_volume(uint8_t volume);
@@ -35,7 +63,7 @@ namespace audio_player {
     void a_pause_music(void);
     void a_resume_music(void);
     bool a_is_music_paused(void);
-    bool a_is_music_playing(void);
+    bool a_is_music_playing(void); // As of the last mixed buffer, false after music that doesn't loop ended
     bool a_is_music(Music *music); // Is this music currently playing
     int32_t a_get_music_volume(void);
     int32_t a_get_last_set_music_volume(void);
@@ -0,0 +1,640 @@
+#include <SDL.h>
+
+#include "common.h"
+#include "renderer.h"
+#include "audio_player.h"
+#include "data.h"
+#include "level.h"
+#include "save_data.h"
+#include "all_entities.h"
+#include "memory_tags.h"
+#include "stub_gl.h"
+#include "stress_level.h"
+#include "replay.h"
+#include "entity_costs.h"
+#include "game.h"
+#include "parallel_update.h"
+
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <new>
+
+// Microbenchmarks of the engine's hot paths, no_name_bench [filter] runs the ones with filter in their name.
+// The renderer runs against install_stub_gl, so only the CPU side of batching is measured.
+// Prints CSV to stdout: the median and fastest of BENCH_REPETITIONS runs, allocations are operator new and tagged_malloc calls.
+// The stress/ benchmarks run generated levels at multiples of the 1_2 density, their memory and entity cost tables go to stderr.
+// no_name_bench --write-stress-level <path> <density> [length] [--goombas n ...] only writes such a level, the STRESS_LEVEL_FIELDS options
+// replace single fields of stress_level_desc(density, length).
+// no_name_bench --replay <session> [--runs n] [--jobs n] [--baseline csv] [--write-baseline csv] [--tolerance 0.1] is the frame time check of replay.h.
+// The stress levels and the replay update with the parallel update like the game, the replay's --jobs sets the workers.
+
+#define BENCH_REPETITIONS  7
+#define BENCH_MIN_RUN_TIME 0.02 // Seconds, iterations are doubled until a run takes this long
+
+#define STRESS_FRAMES_PER_CLONE 120 // The level is restarted after this many frames, before the enemies reach the player
+#define SLAB_BENCH_ENTITIES     3000 // Goombas and as many coins on top of 1_1
+
+#define STRESS_LEVEL_FIELDS\
+    STRESS_LEVEL_FIELD("--x-tiles",        x_tiles)\
+    STRESS_LEVEL_FIELD("--y-tiles",        y_tiles)\
+    STRESS_LEVEL_FIELD("--goombas",        goombas)\
+    STRESS_LEVEL_FIELD("--koopas",         koopas)\
+    STRESS_LEVEL_FIELD("--piranhas",       piranhas)\
+    STRESS_LEVEL_FIELD("--coins",          coins)\
+    STRESS_LEVEL_FIELD("--fire-bars",      fire_bars)\
+    STRESS_LEVEL_FIELD("--platforms",      platforms)\
+    STRESS_LEVEL_FIELD("--camera-regions", camera_regions)
+
+namespace {
+    std::atomic<int64_t> new_count = 0;
+
+    // Taken off the current run by UntimedScope
+    uint64_t untimed_ticks = 0;
+    int64_t  untimed_allocations = 0;
+
+    volatile int32_t result_sink = 0; // Results of benchmarks that only count, so the loops aren't optimized away
+
+    const char *shipped_levels[] = { "1_1", "1_2", "1_3", "1_4", "main_menu" };
+    const int32_t stress_densities[] = { 1, 10, 100 };
+}
+
+void *operator new(size_t bytes) {
+    new_count.fetch_add(1, std::memory_order_relaxed);
+    void *memory = malloc(bytes > 0 ? bytes : 1);
+    if(memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+
+static
+int64_t count_allocations(void) {
+    int64_t count = new_count.load(std::memory_order_relaxed);
+    for(int32_t tag = 0; tag < MEMORY_TAG__COUNT; ++tag) {
+        count += get_memory_tag_stats((EMemoryTag)tag).total_allocations;
+    }
+    return count;
+}
+
+static
+float64_t ticks_to_ns(uint64_t ticks) {
+    return (float64_t)ticks * 1000000000.0 / (float64_t)SDL_GetPerformanceFrequency();
+}
+
+// Deterministic, every run sees the same data
+static
+uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Setup inside a proc that isn't part of the operation, its time and allocations don't count
+struct UntimedScope {
+    uint64_t begin_ticks;
+    int64_t  begin_allocations;
+
+    UntimedScope(void) {
+        begin_allocations = count_allocations();
+        begin_ticks = SDL_GetPerformanceCounter();
+    }
+
+    ~UntimedScope(void) {
+        untimed_ticks += SDL_GetPerformanceCounter() - begin_ticks;
+        untimed_allocations += count_allocations() - begin_allocations;
+    }
+};
+
+template<typename Proc>
+static uint64_t timed_run(Proc &proc, int64_t iterations) {
+    untimed_ticks = 0;
+    const uint64_t begin = SDL_GetPerformanceCounter();
+    proc(iterations);
+    return SDL_GetPerformanceCounter() - begin - untimed_ticks;
+}
+
+// proc(iterations) does iterations operations
+template<typename Proc>
+static void run_bench(const char *name, const char *filter, Proc proc) {
+    if(filter != NULL && strstr(name, filter) == NULL) {
+        return;
+    }
+
+    proc(1); // Warm up
+
+    int64_t iterations = 1;
+    for(;;) {
+        if(ticks_to_ns(timed_run(proc, iterations)) >= BENCH_MIN_RUN_TIME * 1000000000.0 || iterations >= ((int64_t)1 << 32)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    float64_t ns_per_op[BENCH_REPETITIONS];
+    untimed_allocations = 0;
+    const int64_t allocations_begin = count_allocations();
+    for(int32_t rep = 0; rep < BENCH_REPETITIONS; ++rep) {
+        ns_per_op[rep] = ticks_to_ns(timed_run(proc, iterations)) / (float64_t)iterations;
+    }
+    const float64_t allocs_per_op = (float64_t)(count_allocations() - allocations_begin - untimed_allocations) / (float64_t)(iterations * BENCH_REPETITIONS);
+
+    std::sort(ns_per_op, ns_per_op + BENCH_REPETITIONS);
+    printf("%s,%lld,%.2f,%.2f,%.3f\n", name, (long long)iterations, ns_per_op[BENCH_REPETITIONS / 2], ns_per_op[0], allocs_per_op);
+    fflush(stdout);
+}
+
+static
+Level *load_shipped_level(const char *level_name) {
+    Level *level = create_empty_level();
+    load_level(level, (global_data::get_data_path() + "\\levels\\" + level_name + ".level").c_str());
+    return level;
+}
+
+static
+void bench_collisions(const char *filter) {
+    /* aabb */ {
+        vec2i positions[1024];
+        vec2i sizes[1024];
+        uint32_t state = 0x12345678;
+        for(int32_t idx = 0; idx < 1024; ++idx) {
+            positions[idx] = { (int32_t)(next_random(&state) % 512), (int32_t)(next_random(&state) % 256) };
+            sizes[idx]     = { (int32_t)(next_random(&state) % 32) + 1, (int32_t)(next_random(&state) % 32) + 1 };
+        }
+
+        run_bench("aabb", filter, [&] (int64_t iterations) {
+            int32_t hits = 0;
+            for(int64_t it = 0; it < iterations; ++it) {
+                const int32_t a = it & 1023;
+                const int32_t b = (it * 7 + 1) & 1023;
+                hits += aabb(positions[a], sizes[a], positions[b], sizes[b]);
+            }
+            result_sink = hits;
+        });
+    }
+
+    // Player on the ground at the start of 1_1, what every walker checks each frame
+    Level *level = load_shipped_level("1_1");
+    Player *player = get_player(level);
+    assert(player != NULL, "1_1 has no player.");
+
+    const vec2i below = { 0, -1 };
+    FindCollisionsOpts opts;
+    opts.id_to_ignore = player->unique_id;
+    opts.entity_flags = E_FLAG_IS_GAMEPLAY_ENTITY;
+
+    run_bench("find_collisions/entities", filter, [&] (int64_t iterations) {
+        for(int64_t it = 0; it < iterations; ++it) {
+            auto found = find_collisions(level, player->position, player->has_collider, opts, below);
+        }
+    });
+
+    Tilemap *ground = NULL;
+    for_tilemap_overlapping(level, player->position, player->has_collider, below, tilemap) {
+        ground = tilemap;
+        break;
+    }
+    assert(ground != NULL, "Player in 1_1 doesn't start on a tilemap.");
+
+    run_bench("find_collisions/tiles", filter, [&] (int64_t iterations) {
+        for(int64_t it = 0; it < iterations; ++it) {
+            auto found = find_collisions(player->position, player->has_collider, ground, below);
+        }
+    });
+
+    run_bench("is_colliding_with_any_tile", filter, [&] (int64_t iterations) {
+        int32_t hits = 0;
+        for(int64_t it = 0; it < iterations; ++it) {
+            hits += is_colliding_with_any_tile(player->position, player->has_collider, ground, below);
+        }
+        result_sink = hits;
+    });
+
+    delete_level(level);
+}
+
+// Every op moves the entity a pixel right and into the ground, then restores it so each op sees the same state.
+// The restore is a memcpy of the entity and is included in the time.
+static
+void bench_move(const char *name, const char *filter, Entity *entity) {
+    std::vector<uint8_t> snapshot(entity->size_of_entity);
+    entity->has_move_data->speed    = { 60.0f, -60.0f };
+    entity->has_move_data->reminder = { 0.0f, 0.0f };
+    memcpy(snapshot.data(), entity, entity->size_of_entity);
+
+    run_bench(name, filter, [&] (int64_t iterations) {
+        for(int64_t it = 0; it < iterations; ++it) {
+            do_move(entity, entity->has_move_data, 1.0f / 60.0f);
+            memcpy(entity, snapshot.data(), snapshot.size());
+        }
+    });
+}
+
+static
+void bench_moves(const char *filter) {
+    Level *level = load_shipped_level("1_1");
+
+    bench_move("do_move/player", filter, get_player(level));
+    for_entity_type(level, Goomba, goomba) {
+        bench_move("do_move/goomba", filter, goomba);
+        break;
+    }
+
+    delete_level(level);
+}
+
+static
+void bench_entity_pool(const char *filter) {
+    const int32_t count = 1024;
+    std::vector<Entity> entities(count);
+
+    // Removed out of order, like entities getting deleted during play
+    std::vector<int32_t> remove_order(count);
+    uint32_t state = 0x9e3779b9;
+    for(int32_t idx = 0; idx < count; ++idx) {
+        remove_order[idx] = idx;
+    }
+    for(int32_t idx = count - 1; idx > 0; --idx) {
+        swap_2(remove_order[idx], remove_order[next_random(&state) % (idx + 1)]);
+    }
+
+    // An op is a push and the remove of the same entity, iterations are rounded up to whole pools
+    run_bench("entity_pool_push_remove", filter, [&] (int64_t iterations) {
+        EntityPool pool = { };
+        for(int64_t it = 0; it < iterations; it += count) {
+            for(int32_t idx = 0; idx < count; ++idx) {
+                entity_pool_push(&pool, &entities[idx], idx % entity_type_count());
+            }
+            for(int32_t idx = 0; idx < count; ++idx) {
+                entity_pool_remove(&pool, &entities[remove_order[idx]], remove_order[idx] % entity_type_count());
+            }
+        }
+    });
+}
+
+// 1_1 with thousands of goombas and coins, spawned interleaved and with some deleted in between so the slabs have holes.
+// What the per-type slabs are for: a pass over one type only touches that type's memory.
+static
+void bench_entity_slabs(const char *filter) {
+    Level *pristine = load_shipped_level("1_1");
+    const vec2i ground = get_player(pristine)->position;
+
+    uint32_t state = 0x85ebca6b;
+    std::vector<Entity *> churn;
+    for(int32_t idx = 0; idx < SLAB_BENCH_ENTITIES; ++idx) {
+        const int32_t x = ground.x + 256 + (int32_t)(next_random(&state) % (uint32_t)(TILE_SIZE * 150));
+        churn.push_back(spawn_goomba(pristine, { x, ground.y }));
+        churn.push_back(spawn_coin(pristine, { x, ground.y + TILE_SIZE * 3 }));
+
+        if(idx % 4 == 3) {
+            // Replaced by one of the same type, so the counts stay the same
+            const int32_t remove_idx = (int32_t)(next_random(&state) % (uint32_t)churn.size());
+            const bool was_goomba = churn[remove_idx]->entity_type_id == entity_type_id(Goomba);
+            delete_entity_imm(churn[remove_idx]);
+            churn[remove_idx] = was_goomba ? (Entity *)spawn_goomba(pristine, { x, ground.y }) : (Entity *)spawn_coin(pristine, { x, ground.y + TILE_SIZE * 3 });
+        }
+    }
+
+    char name[128];
+    sprintf_s(name, array_count(name), "entity_slabs/for_entity_type/%d_goombas_%d_coins", SLAB_BENCH_ENTITIES, SLAB_BENCH_ENTITIES);
+    run_bench(name, filter, [&] (int64_t iterations) {
+        int32_t sum = 0;
+        for(int64_t it = 0; it < iterations; ++it) {
+            for_entity_type(pristine, Goomba, goomba) {
+                sum += goomba->position.x;
+            }
+            for_entity_type(pristine, Coin, coin) {
+                sum += coin->position.x;
+            }
+        }
+        result_sink = sum;
+    });
+
+    // An op is a frame of the player running right, restarted from a clone outside of the time
+    Game *game = malloc_and_zero_struct(Game);
+    Level *level = NULL;
+    int32_t frame = 0;
+    sprintf_s(name, array_count(name), "entity_slabs/update_level/%d_goombas_%d_coins", SLAB_BENCH_ENTITIES, SLAB_BENCH_ENTITIES);
+    run_bench(name, filter, [&] (int64_t iterations) {
+        for(int64_t it = 0; it < iterations; ++it) {
+            if(level == NULL || frame == STRESS_FRAMES_PER_CLONE) {
+                UntimedScope untimed;
+                recreate_level_from_clone(&level, pristine);
+                reset_session_for_level(game, "1_1.level");
+                frame = 0;
+            }
+
+            SimInput input = { };
+            input.player_move_r = true;
+            update_level(level, input, game, 1.0 / 60.0);
+            ++frame;
+        }
+    });
+
+    if(level != NULL) {
+        delete_level(level);
+    }
+    delete_level(pristine);
+    free(game);
+}
+
+static
+void bench_level_loading(const char *filter) {
+    char name[128];
+    for(int32_t idx = 0; idx < array_count(shipped_levels); ++idx) {
+        const std::string path = global_data::get_data_path() + "\\levels\\" + shipped_levels[idx] + ".level";
+
+        sprintf_s(name, array_count(name), "parse_level_save_data/%s", shipped_levels[idx]);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                LevelSaveData save_data = parse_level_save_data(path.c_str());
+            }
+        });
+
+        // Creating and deleting the level is included, the chunks come from the level memory pool after the first one
+        LevelSaveData save_data = parse_level_save_data(path.c_str());
+        sprintf_s(name, array_count(name), "load_level_from_save_data/%s", shipped_levels[idx]);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                Level *level = create_empty_level();
+                load_level_from_save_data(level, &save_data);
+                delete_level(level);
+            }
+        });
+    }
+}
+
+static
+void bench_renderer(const char *filter) {
+    RenderSetup setup;
+    setup.proj_m = mat4x4::orthographic(0, 0, 256, 240, -100, 100);
+    setup.view_m = mat4x4::identity();
+    setup.viewport = { 0, 0, 256, 240 };
+    setup.framebuffer = NULL;
+
+    // Flushes every QUADS_PER_DRAW_CALL quads like a full frame would
+    Sprite sprite = global_data::get_sprite(SPRITE_MARIO_IDLE);
+    run_bench("quad_base/r_sprite", filter, [&] (int64_t iterations) {
+        render::r_begin(setup);
+        for(int64_t it = 0; it < iterations; ++it) {
+            render::r_sprite({ (int32_t)(it & 255), (int32_t)((it >> 8) & 255) }, 0, { 16, 16 }, sprite, { 1.0f, 1.0f, 1.0f, 1.0f });
+        }
+        render::r_end();
+    });
+
+    run_bench("quad_base/r_quad", filter, [&] (int64_t iterations) {
+        render::r_begin(setup);
+        for(int64_t it = 0; it < iterations; ++it) {
+            render::r_quad({ (int32_t)(it & 255), (int32_t)((it >> 8) & 255) }, 0, { 16, 16 }, { 1.0f, 0.0f, 0.0f, 1.0f });
+        }
+        render::r_end();
+    });
+
+    // An op is a whole 32 character line
+    run_bench("r_text/32_chars", filter, [&] (int64_t iterations) {
+        render::r_begin(setup);
+        for(int64_t it = 0; it < iterations; ++it) {
+            render::r_text({ 0, (int32_t)(it & 255) }, 0, "delta time: 0.0166666666 (60fps)", render::def_font());
+        }
+        render::r_end();
+    });
+}
+
+// Load, update and render of the same content at every density, how each one scales is what the numbers are for
+static
+void bench_stress_levels(const char *filter) {
+    RenderSetup setup;
+    setup.viewport = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
+    setup.framebuffer = NULL;
+
+    init_parallel_update(-1);
+    fprintf(stderr, "stress levels with %d parallel update workers\n", get_parallel_update_worker_count());
+
+    Game *game = malloc_and_zero_struct(Game);
+    char name[128];
+    for(int32_t idx = 0; idx < array_count(stress_densities); ++idx) {
+        const int32_t density = stress_densities[idx];
+        char path[64];
+        sprintf_s(path, array_count(path), "stress_%dx.level", density);
+        if(!write_stress_level(path, stress_level_desc((float32_t)density))) {
+            fprintf(stderr, "Couldn't write %s.\n", path);
+            continue;
+        }
+
+        sprintf_s(name, array_count(name), "stress/%dx/parse_level_save_data", density);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                LevelSaveData save_data = parse_level_save_data(path);
+            }
+        });
+
+        LevelSaveData save_data = parse_level_save_data(path);
+        sprintf_s(name, array_count(name), "stress/%dx/load_level_from_save_data", density);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                Level *level = create_empty_level();
+                load_level_from_save_data(level, &save_data);
+                delete_level(level);
+            }
+        });
+
+        reset_memory_tag_peaks();
+        Level *pristine = create_empty_level();
+        load_level_from_save_data(pristine, &save_data);
+        fprintf(stderr, "stress/%dx memory after load:\n%s\n", density, format_memory_tags().c_str());
+
+        // An op is a frame of the player running right, the level is restarted from a clone outside of the time
+        Level *level = NULL;
+        int32_t frame = 0;
+        auto restart_level = [&] () {
+            recreate_level_from_clone(&level, pristine);
+            reset_session_for_level(game, path);
+            frame = 0;
+        };
+        auto update_frame = [&] () {
+            SimInput input = { };
+            input.player_move_r = true;
+            input.player_jump   = frame % 40 < 10;
+            update_level(level, input, game, 1.0 / 60.0);
+            ++frame;
+        };
+
+        reset_entity_costs();
+        sprintf_s(name, array_count(name), "stress/%dx/update_level", density);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                if(level == NULL || frame == STRESS_FRAMES_PER_CLONE) {
+                    UntimedScope untimed;
+                    restart_level();
+                }
+                update_frame();
+            }
+        });
+
+        // Same frames, only drawn, the update to get there doesn't count
+        sprintf_s(name, array_count(name), "stress/%dx/render_level", density);
+        run_bench(name, filter, [&] (int64_t iterations) {
+            for(int64_t it = 0; it < iterations; ++it) {
+                /* Next frame */ {
+                    UntimedScope untimed;
+                    if(level == NULL || frame == STRESS_FRAMES_PER_CLONE) {
+                        restart_level();
+                    }
+                    update_frame();
+                }
+
+                RenderView *view = &level->render_view;
+                setup.proj_m = view->calc_proj();
+                setup.view_m = view->calc_view();
+                render::r_begin(setup);
+                render_level(level);
+                render::r_end();
+            }
+        });
+
+        if(level != NULL) {
+            fprintf(stderr, "stress/%dx entity costs:\n%s\n", density, format_entity_costs(EEntityCostSort::UPDATE_TIME).c_str());
+            delete_level(level);
+        }
+        delete_level(pristine);
+        std::filesystem::remove(path);
+    }
+
+    free(game);
+    free_parallel_update();
+}
+
+// Pairs of option and value from first_arg on, false on anything unknown or a value missing
+static
+bool apply_stress_level_overrides(int32_t argc, char *argv[], int32_t first_arg, StressLevelDesc *desc) {
+    for(int32_t idx = first_arg; idx < argc; idx += 2) {
+        if(idx + 1 >= argc) {
+            return false;
+        }
+        const char *option = argv[idx];
+        const char *value  = argv[idx + 1];
+
+#define STRESS_LEVEL_FIELD(name, field) if(strcmp(option, name) == 0) { desc->field = atoi(value); continue; }
+        STRESS_LEVEL_FIELDS
+#undef STRESS_LEVEL_FIELD
+
+        if(strcmp(option, "--sections") == 0) {
+            desc->stream_sections = atoi(value) != 0;
+        } else if(strcmp(option, "--seed") == 0) {
+            desc->seed = (uint32_t)strtoul(value, NULL, 0);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    SDL_SetMainReady();
+
+    // Paths on the command line are relative to where it was started, the data is found from the executable
+    const std::filesystem::path launch_directory = std::filesystem::current_path();
+    auto launch_path = [&] (const char *path) { return (launch_directory / path).string(); };
+    std::filesystem::current_path(std::filesystem::path(argv[0]).parent_path());
+
+    const bool write_stress = argc > 1 && strcmp(argv[1], "--write-stress-level") == 0;
+    const bool replay       = argc > 1 && strcmp(argv[1], "--replay") == 0;
+    const char *filter = argc > 1 && !write_stress && !replay ? argv[1] : NULL;
+
+    StressLevelDesc stress_desc = { };
+    if(write_stress) {
+        const bool has_length = argc > 4 && strncmp(argv[4], "--", 2) != 0;
+        bool valid = argc >= 4;
+        if(valid) {
+            stress_desc = stress_level_desc((float32_t)atof(argv[3]), has_length ? (float32_t)atof(argv[4]) : 1.0f);
+            valid = apply_stress_level_overrides(argc, argv, has_length ? 5 : 4, &stress_desc) && is_stress_level_desc_valid(stress_desc);
+        }
+
+        if(!valid) {
+            fprintf(stderr, "usage: no_name_bench --write-stress-level <path> <density> [length] [--x-tiles n] [--y-tiles n] [--goombas n] [--koopas n] [--piranhas n]\n"
+                            "                     [--coins n] [--fire-bars n] [--platforms n] [--camera-regions n] [--sections 0|1] [--seed n]\n");
+            return 1;
+        }
+    }
+
+    std::string session_path, baseline_path, write_baseline_path;
+    ReplayOptions replay_options = { };
+    replay_options.runs      = 5;
+    replay_options.jobs      = -1;
+    replay_options.tolerance = 0.1;
+    if(replay) {
+        bool valid = argc > 2;
+        if(valid) {
+            session_path = launch_path(argv[2]);
+            replay_options.session_path = session_path.c_str();
+        }
+
+        for(int32_t idx = 3; idx < argc && valid; idx += 2) {
+            const char *value = idx + 1 < argc ? argv[idx + 1] : NULL;
+            valid = value != NULL;
+            if(!valid) break;
+
+            if(strcmp(argv[idx], "--runs") == 0) {
+                replay_options.runs = atoi(value);
+            } else if(strcmp(argv[idx], "--jobs") == 0) {
+                replay_options.jobs = atoi(value);
+            } else if(strcmp(argv[idx], "--baseline") == 0) {
+                baseline_path = launch_path(value);
+                replay_options.baseline_path = baseline_path.c_str();
+            } else if(strcmp(argv[idx], "--write-baseline") == 0) {
+                write_baseline_path = launch_path(value);
+                replay_options.write_baseline_path = write_baseline_path.c_str();
+            } else if(strcmp(argv[idx], "--tolerance") == 0) {
+                replay_options.tolerance = atof(value);
+            } else {
+                valid = false;
+            }
+        }
+
+        if(!valid) {
+            fprintf(stderr, "usage: no_name_bench --replay <session> [--runs n] [--jobs n] [--baseline csv] [--write-baseline csv] [--tolerance 0.1]\n");
+            return 2;
+        }
+    }
+
+    install_stub_gl();
+    render::r_init();
+    audio_player::a_set_allow_play_sounds(false);
+    global_data::init();
+    init_entities_data();
+
+    if(write_stress) {
+        const bool written = write_stress_level(launch_path(argv[2]).c_str(), stress_desc);
+        if(!written) {
+            fprintf(stderr, "Couldn't write %s.\n", argv[2]);
+        }
+
+        global_data::free();
+        render::r_quit();
+        return written ? 0 : 1;
+    }
+
+    if(replay) {
+        const int32_t result = run_replay(replay_options);
+        global_data::free();
+        render::r_quit();
+        return result;
+    }
+
+    printf("benchmark,iterations,ns_per_op,min_ns_per_op,allocs_per_op\n");
+    bench_collisions(filter);
+    bench_moves(filter);
+    bench_entity_pool(filter);
+    bench_entity_slabs(filter);
+    bench_level_loading(filter);
+    bench_renderer(filter);
+    bench_stress_levels(filter);
+
+    global_data::free();
+    render::r_quit();
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "data.h"
+#include "memory_tags.h"
 
 bool read_file(const char *filepath, void **out_file_data, size_t *out_size, bool null_terminated) {
     assert(out_file_data && out_size);
@@ -18,12 +19,12 @@ bool read_file(const char *filepath, void **out_file_data, size_t *out_size, boo
     fseek(file, 0, SEEK_SET);
 
     if(null_terminated) {
-        file_data = malloc(file_size + 1);
+        file_data = tagged_malloc(MEMORY_TAG_FILE_DATA, file_size + 1);
         assert(file_data);
         fread(file_data, 1, file_size, file);
         ((char *)file_data)[file_size] = '\0';
     } else {
-        file_data = malloc(file_size);
+        file_data = tagged_malloc(MEMORY_TAG_FILE_DATA, file_size);
         assert(file_data);
         fread(file_data, 1, file_size, file);
     }
@@ -36,7 +37,7 @@ bool read_file(const char *filepath, void **out_file_data, size_t *out_size, boo
 }
 
 void free_file(void *file_data) {
-    free(file_data);
+    tagged_free(file_data);
 }
 
 bool save_file(const char *filepath, void *buffer, size_t buffer_size) {
@@ -100,7 +101,7 @@ namespace global_data {
 #undef IMAGE
 
         // Load sounds
-#define SOUND(sound_name, filename) _sounds[sound_name] = load_sound_wav((_data_path.string().append(filename)).c_str());
+#define SOUND(sound_name, filename, max_voices) _sounds[sound_name] = load_sound_wav((_data_path.string().append(filename)).c_str(), max_voices);
         ALL_SOUNDS;
 #undef SOUND
 
@@ -260,20 +260,20 @@ inline int32_t image_id_from_string(const char *image_string) { ALL_IMAGES; retu
 
 /* --- Sounds --- */
 
-#define SOUND(sound_name, filename)
+#define SOUND(sound_name, filename, max_voices) // max_voices of the same sound play at once, a new one cuts the oldest
 #define ALL_SOUNDS\
-    SOUND(SOUND_COIN,          "sounds/coin.wav")\
-    SOUND(SOUND_JUMP_1,        "sounds/jump_01.wav")\
-    SOUND(SOUND_JUMP_2,        "sounds/jump_02.wav")\
-    SOUND(SOUND_POWER_UP,      "sounds/power_up.wav")\
-    SOUND(SOUND_PLAYER_HIT,    "sounds/player_hit.wav")\
-    SOUND(SOUND_PIPE_ENTER,    "sounds/pipe_enter.wav")\
-    SOUND(SOUND_STOMP,         "sounds/stomp.wav")\
-    SOUND(SOUND_DESTROY_BLOCK, "sounds/destroy_block.wav")\
-    SOUND(SOUND_KILL_ENEMY,    "sounds/kill_enemy.wav")\
-    SOUND(SOUND_FIREBALL,      "sounds/fireball_throw.wav")\
-    SOUND(SOUND_TILE_DROP,     "sounds/tile_drop.wav")\
-    SOUND(SOUND_TILE_HIT,      "sounds/tile_hit.wav")\
+    SOUND(SOUND_COIN,          "sounds/coin.wav",           2)\
+    SOUND(SOUND_JUMP_1,        "sounds/jump_01.wav",        1)\
+    SOUND(SOUND_JUMP_2,        "sounds/jump_02.wav",        1)\
+    SOUND(SOUND_POWER_UP,      "sounds/power_up.wav",       1)\
+    SOUND(SOUND_PLAYER_HIT,    "sounds/player_hit.wav",     1)\
+    SOUND(SOUND_PIPE_ENTER,    "sounds/pipe_enter.wav",     1)\
+    SOUND(SOUND_STOMP,         "sounds/stomp.wav",          3)\
+    SOUND(SOUND_DESTROY_BLOCK, "sounds/destroy_block.wav",  2)\
+    SOUND(SOUND_KILL_ENEMY,    "sounds/kill_enemy.wav",     3)\
+    SOUND(SOUND_FIREBALL,      "sounds/fireball_throw.wav", 2)\
+    SOUND(SOUND_TILE_DROP,     "sounds/tile_drop.wav",      2)\
+    SOUND(SOUND_TILE_HIT,      "sounds/tile_hit.wav",       2)\
 
 #undef SOUND
 
@@ -376,12 +376,14 @@ void render_editor(Editor *editor) {
 
         ImGui::Text("est.fps: %.1f", (1.0 / editor->delta_time));
         ImGui::Text("Used entities: %d", editor->level->entities.count);
-        ImGui::Text("memory size: %db", editor->level->memory_size);
+        ImGui::Text("memory size: %db, %d chunks", editor->level->memory_size, editor->level->memory_chunk_count);
         ImGui::Text("memory used: %db, %.1f%%", editor->level->memory_used, ((float64_t)editor->level->memory_used / (float64_t)editor->level->memory_size) * 100.0);
+        ImGui::Text("memory high water: %db", editor->level->memory_high_water);
         ImGui::Text("next_entity_unique_id: %d", editor->level->next_entity_id);
         ImGui::NewLine();
 
         ImGui::Checkbox("Disable level timer", &editor->level->disable_level_timer);
+        ImGui::Checkbox("Stream level sections", &editor->level->stream_sections);
 
         if(ImGui::Button(editor->show_level_music_window ? "Hide level music window" : "Set level music", { (float32_t)max_item_width, 0 })) {
             editor->show_level_music_window = !editor->show_level_music_window;
@@ -555,8 +557,8 @@ void update_spawn_mode(SpawnModeData *spawn_data, Editor *editor, Input *input)
         switch(spawn_data->spawn_type) {
             case SPAWN_PLAYER: {
                 if(lpm_pressed) {
-                    if(editor->level->entities.first_of_type[entity_type_id(Player)]) {
-                        delete_entity_imm(editor->level->entities.first_of_type[entity_type_id(Player)]);
+                    if(get_player(editor->level)) {
+                        delete_entity_imm(get_player(editor->level));
                     }
                     spawn_player(editor->level, editor->ti_cursor.position - vec2i{ 0, 1 });
                 }
@@ -926,12 +928,12 @@ void render_transparent_blocks_drops(Tilemap *tilemap) {
     for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
         for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
             auto tile = tilemap->get_tile(x_tile, y_tile);
-            if(tile == NULL || !tile->is_not_empty || tile->tile_desc.tile_drop == TILE_DROP_NONE) {
+            if(tile == NULL || !tile->is_not_empty() || tile->get_desc().tile_drop == TILE_DROP_NONE) {
                 continue;
             }
 
             int32_t sprite_id = SPRITE__INVALID;
-            switch(tile->tile_desc.tile_drop) {
+            switch(tile->get_desc().tile_drop) {
                 case TILE_DROP_COINS:   { sprite_id = SPRITE_COIN_ENTITY_1; } break;
                 case TILE_DROP_POWERUP: { sprite_id = SPRITE_MUSHROOM; } break;
                 case TILE_DROP_STAR:    { sprite_id = SPRITE_STAR_1; } break;
@@ -1292,10 +1294,12 @@ void init_modify_mode(ModifyModeData *modify_data, Editor *editor) {
 }
 
 Entity *find_prev_of_type(Entity *entity) {
-    for(Entity *entity_b = entity->level->entities.first_of_type[entity->entity_type_id]; entity_b != NULL; entity_b = entity_b->next_of_type) {
-        if(entity_b != entity && entity_b->next_of_type && entity_b->next_of_type == entity) {
-            return entity_b;
+    Entity *prev = NULL;
+    for_entity_type_id(entity->level, entity->entity_type_id, entity_b) {
+        if(entity_b == entity) {
+            return prev;
         }
+        prev = entity_b;
     }
     return NULL;
 }
@@ -1303,8 +1307,9 @@ Entity *find_prev_of_type(Entity *entity) {
 static
 void modify_mode_delete_selected_entity(ModifyModeData *modify_data) {
     auto entity = modify_data->selected_entity;
-    if(entity->next_of_type != NULL) {
-        modify_data->selected_entity = entity->next_of_type;
+    Entity *next_of_type = next_entity_of_type(entity);
+    if(next_of_type != NULL) {
+        modify_data->selected_entity = next_of_type;
     } else {
         auto prev = find_prev_of_type(entity);
         if(prev != NULL) {
@@ -1348,6 +1353,11 @@ void update_modify_mode(ModifyModeData *modify_data, Editor *editor, Input *inpu
     if(modify_data->drag_selected_entity) {
         if(modify_data->selected_entity) {
             modify_data->selected_entity->position = editor->mouse_pos_in_game_space - modify_data->offset_of_selected_entity;
+            if(modify_data->selected_entity->entity_type_id == entity_type_id(Tilemap)) {
+                editor->level->tile_index->dirty = true;
+            } else if(modify_data->selected_entity->entity_type_id == entity_type_id(CameraRegion)) {
+                editor->level->camera_region_index->dirty = true;
+            }
         }
         modify_data->hovered_entity = NULL;
     } else {
@@ -1449,7 +1459,7 @@ void imgui_modify_mode(ModifyModeData *modify_data, Editor *editor, int32_t max_
     
         ImGui::SetNextItemWidth(max_item_width);
         if(ImGui::BeginListBox("##entitites")) {
-            for(Entity *entity = editor->level->entities.first_of_type[modify_data->entity_type_id_filter]; entity != NULL; entity = entity->next_of_type) {
+            for_entity_type_id(editor->level, modify_data->entity_type_id_filter, entity) {
                 char buffer[64];
                 sprintf_s(buffer, array_count(buffer), "ID: %d", entity->unique_id);
                 if(ImGui::Selectable(buffer, entity == modify_data->selected_entity)) {
@@ -1481,7 +1491,7 @@ void imgui_modify_mode(ModifyModeData *modify_data, Editor *editor, int32_t max_
         const float32_t half_padding = ImGui::GetStyle().ItemSpacing.x * 0.5f;
         
         if(ImGui::Button("Delete all", { (float32_t)max_item_width * 0.5f - half_padding, 0.0f })) {
-            while(editor->level->entities.first_of_type[modify_data->entity_type_id_filter] != NULL) {
+            while(editor->level->entities.count_of_type[modify_data->entity_type_id_filter] != 0) {
                 modify_mode_delete_selected_entity(modify_data);
             }
             return;
@@ -1542,6 +1552,7 @@ void imgui_modify_mode(ModifyModeData *modify_data, Editor *editor, int32_t max_
                 if(x_tiles_width != region->x_tiles_width && x_tiles_width > 0) {
                     region->x_tiles_width = x_tiles_width;
                     region->x_width = x_tiles_width * TILE_SIZE;
+                    editor->level->camera_region_index->dirty = true;
                 }
             } break;
 
@@ -1695,7 +1706,7 @@ void update_paint_mode(PaintModeData *paint_data, Editor *editor, Input *input)
                 vec2i rel_tile_xy = editor->ti_cursor.tile - origin_tile;
                 Tile *tile = tilemap->get_tile(rel_tile_xy.x, rel_tile_xy.y);
                 if(tile != NULL) {
-                    paint_data->tile_desc = tile->tile_desc;
+                    paint_data->tile_desc = tile->get_desc();
                 }
             } else {
                 paint_data->clear_selected_tiles = input->keys[key_left_shift] & input_is_down;
@@ -1768,7 +1779,7 @@ void render_invisible_blocks_outline(Tilemap *tilemap, float32_t time_elapsed) {
     for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
         for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
             Tile *tile = tilemap->get_tile(x_tile, y_tile);
-            if(tile != NULL && (tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE || tile->tile_desc.tile_flags & TILE_FLAG_NO_RENDER)) {
+            if(tile != NULL && (tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE || tile->get_desc().tile_flags & TILE_FLAG_NO_RENDER)) {
                 const auto ti = tile->get_ti();
                 render::r_quad_marching_ants(ti.position, -10, TILE_SIZE_2, 8, { 1.0f, 1.0f, 1.0f, 0.8f }, time_elapsed);
                 render::r_sprite(ti.position, -8, TILE_SIZE_2, global_data::get_sprite(SPRITE_BLOCK_QUESTION_1), { 1.0f, 1.0f, 1.0f, 0.4f });
@@ -1848,7 +1859,7 @@ static
 void imgui_paint_mode(PaintModeData *paint_data, Editor *editor, int32_t max_item_width) {
     ImGui::SetNextItemWidth(max_item_width);
     if(ImGui::BeginListBox("##tilemaps")) {
-        for(Entity *entity = editor->level->entities.first_of_type[entity_type_id(Tilemap)]; entity != NULL; entity = entity->next_of_type) {
+        for_entity_type_id(editor->level, entity_type_id(Tilemap), entity) {
             char buffer[64];
             sprintf_s(buffer, array_count(buffer), "ID: %d", entity->unique_id);
             if(ImGui::Selectable(buffer, entity == paint_data->selected_tilemap)) {
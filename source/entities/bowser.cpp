@@ -1,6 +1,7 @@
 #include "bowser.h"
 #include "all_entities.h"
 #include "data.h"
+#include "level_effects.h"
 
 namespace {
     constexpr int32_t segment_width  = 16;
@@ -294,7 +295,7 @@ ENTITY_RENDER_PROC(render_bowser_fire) {
 
 HIT_CALLBACK_PROC(bowser_fire_hit_callback) {
     auto b_fire = self_base->as<BowserFire>();
-    if(collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE)) {
+    if(collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE)) {
         delete_entity(b_fire); // @todo Shouldn't delete here probably
         return hit_callback_result(true);
     }
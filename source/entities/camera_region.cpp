@@ -1,5 +1,7 @@
 #include "camera_region.h"
 
+#include <algorithm>
+
 ENTITY_SERIALIZE_PROC(CameraRegion) {
     auto region = self_base->as<CameraRegion>();
 
@@ -21,10 +23,106 @@ ENTITY_DESERIALIZE_PROC(CameraRegion) {
     return spawn_camera_region(level, position.x, position.y, x_tiles_width);
 }
 
+ENTITY_DELETE_PROC(delete_camera_region) {
+    auto region = self_base->as<CameraRegion>();
+    region->level->camera_region_index->dirty = true;
+}
+
 CameraRegion *spawn_camera_region(Level *level, int32_t x_origin, int32_t y_origin, int32_t x_tiles_width) {
     auto region = create_entity_m(level, CameraRegion);
+    region->delete_proc = delete_camera_region;
     region->position = { x_origin, y_origin };
     region->x_tiles_width = x_tiles_width;
     region->x_width = x_tiles_width * TILE_SIZE;
+
+    level->camera_region_index->dirty = true;
     return region;
+}
+
+static
+void rebuild_camera_region_index(Level *level) {
+    CameraRegionIndex *index = level->camera_region_index;
+    index->regions.clear();
+    index->slab_order.clear();
+    index->max_right.clear();
+    index->current = NULL;
+    index->dirty = false;
+
+    std::vector<std::pair<CameraRegion *, int32_t>> sorted;
+    for_entity_type(level, CameraRegion, region) {
+        sorted.push_back({ region, (int32_t)sorted.size() });
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [] (const std::pair<CameraRegion *, int32_t> &a, const std::pair<CameraRegion *, int32_t> &b) {
+        return a.first->position.x != b.first->position.x ? a.first->position.x < b.first->position.x : a.second < b.second;
+    });
+
+    int32_t max_right = INT32_MIN;
+    for(auto &entry : sorted) {
+        CameraRegion *region = entry.first;
+        max_right = max_value(max_right, region->position.x + region->x_width);
+
+        index->regions.push_back(region);
+        index->slab_order.push_back(entry.second);
+        index->max_right.push_back(max_right);
+
+        if(region->unique_id == level->current_region_unique_id) {
+            index->current = region;
+        }
+    }
+
+    // The current region is gone
+    if(index->current == NULL) {
+        level->current_region_unique_id = 0;
+    }
+}
+
+static inline
+bool overlaps_camera_region(CameraRegion *region, vec2i position, vec2i size) {
+    return aabb(position, size, region->position, { region->x_width, CameraRegion::const_height_in_pixels });
+}
+
+CameraRegion *find_camera_region(Level *level, vec2i position, vec2i size) {
+    CameraRegionIndex *index = level->camera_region_index;
+    if(index->dirty) {
+        rebuild_camera_region_index(level);
+    }
+
+    index->tested_last_frame = 0;
+    if(index->current != NULL) {
+        index->tested_last_frame += 1;
+        if(overlaps_camera_region(index->current, position, size)) {
+            return index->current;
+        }
+    }
+
+    // Regions before this one end left of the position
+    const int32_t first = (int32_t)(std::upper_bound(index->max_right.begin(), index->max_right.end(), position.x) - index->max_right.begin());
+
+    int32_t best = -1;
+    for(int32_t idx = first; idx < (int32_t)index->regions.size(); ++idx) {
+        CameraRegion *region = index->regions[idx];
+        if(region->position.x >= position.x + size.x) {
+            break;
+        }
+
+        index->tested_last_frame += 1;
+        if(overlaps_camera_region(region, position, size) && (best == -1 || index->slab_order[idx] < index->slab_order[best])) {
+            best = idx;
+        }
+    }
+    return best != -1 ? index->regions[best] : NULL;
+}
+
+CameraRegion *get_current_camera_region(Level *level) {
+    CameraRegionIndex *index = level->camera_region_index;
+    if(index->dirty) {
+        rebuild_camera_region_index(level);
+    }
+    return index->current;
+}
+
+void set_current_camera_region(Level *level, CameraRegion *region) {
+    level->camera_region_index->current = region;
+    level->current_region_unique_id = region != NULL ? region->unique_id : 0;
 }
\ No newline at end of file
@@ -18,4 +18,9 @@ struct CameraRegion : Entity {
 
 CameraRegion *spawn_camera_region(Level *level, int32_t x_origin, int32_t y_origin, int32_t x_tiles_width);
 
+// Lookups go through level->camera_region_index, set its dirty flag after moving or resizing a region
+CameraRegion *find_camera_region(Level *level, vec2i position, vec2i size); // Prefers the current region, otherwise the first overlapping one in slab order
+CameraRegion *get_current_camera_region(Level *level);
+void set_current_camera_region(Level *level, CameraRegion *region);
+
 #endif /* _CAMERA_REGION_H */
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "renderer.h"
 #include "data.h"
 #include "all_entities.h"
+#include "parallel_update.h"
 
 namespace {
     constexpr vec2i     fire_size          = { 8, 8 };
@@ -77,6 +78,10 @@ FireBar *spawn_fire_bar(Level *level, vec2i position, int32_t fire_num) {
     return fire_bar;
 }
 
+static DEFERRED_PROC(fire_bar_hit_player) {
+    hit_player(entity->as<Player>());
+}
+
 ENTITY_UPDATE_PROC(update_fire_bar) {
     auto fire_bar = self_base->as<FireBar>();
 
@@ -100,7 +105,7 @@ ENTITY_UPDATE_PROC(update_fire_bar) {
             
             // Check if any fire collides with player
             if(aabb(fire_pos, fire_bar->fire_size, player->position + player->has_collider->offset, player->has_collider->size)) {
-                hit_player(player);
+                run_or_defer(player, fire_bar_hit_player); // Fire bars are updated in parallel
             }
         }
     }
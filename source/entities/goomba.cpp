@@ -1,6 +1,7 @@
 #include "goomba.h"
 #include "all_entities.h"
 #include "data.h"
+#include "level_effects.h"
 
 namespace {
     constexpr float32_t goomba_gravity      = 290.0f;
@@ -41,6 +42,7 @@ ENTITY_DESERIALIZE_PROC(Goomba) {
 ENTITY_UPDATE_PROC(update_goomba);
 ENTITY_RENDER_PROC(render_goomba);
 HIT_CALLBACK_PROC(goomba_hit_callback);
+MOVE_PREPARE_PROC(prepare_goomba_move);
 
 Goomba *spawn_goomba(Level *level, vec2i position, EGoombaType goomba_type) {
     auto goomba = create_entity_m(level, Goomba);
@@ -61,6 +63,7 @@ Goomba *spawn_goomba(Level *level, vec2i position, EGoombaType goomba_type) {
 
     auto move_data = &goomba->move_data;
     move_data->hit_callback = goomba_hit_callback;
+    move_data->prepare_proc = prepare_goomba_move;
     goomba->has_move_data = move_data;
 
     goomba->move_dir = 1;
@@ -73,19 +76,25 @@ Goomba *spawn_goomba(Level *level, vec2i position, EGoombaType goomba_type) {
 
 ENTITY_UPDATE_PROC(update_goomba) {
     auto goomba = self_base->as<Goomba>();
-    
+
+    prepare_move(goomba, &goomba->move_data, delta_time);
+    do_move(goomba, &goomba->move_data, delta_time);
+
+    update_anim(&goomba->anim_player, delta_time);
+}
+
+MOVE_PREPARE_PROC(prepare_goomba_move) {
+    auto goomba = self_base->as<Goomba>();
+
     if(goomba->change_move_dir_next_frame) {
         goomba->move_dir *= -1;
         goomba->change_move_dir_next_frame = false;
     }
 
     const int32_t dir = sign(goomba->move_dir);
-    auto move_data = &goomba->move_data;
-    move_data->speed.x = dir * goomba_speed;
-    move_data->speed.y -= goomba_gravity * delta_time;
-    do_move(goomba, &goomba->move_data, delta_time);
-
-    update_anim(&goomba->anim_player, delta_time);
+    goomba->move_data.speed.x = dir * goomba_speed;
+    *gravity = goomba_gravity;
+    return true;
 }
 
 ENTITY_RENDER_PROC(render_goomba) {
@@ -101,7 +110,7 @@ HIT_CALLBACK_PROC(goomba_hit_callback) {
 
     if(collision.with_tile) {
         Tile *tile = collision.with_tile;
-        if(tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && collision.axis == X_AXIS) {
+        if(tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && collision.axis == X_AXIS) {
             goomba->change_move_dir_next_frame = true;
             return hit_callback_result(true);
         }
@@ -125,8 +134,7 @@ void kill_goomba(Goomba *goomba, bool by_stomping, int32_t fall_dir /* matters i
     add_points_with_text_above_entity(level, POINTS_FOR_GOOMBA, goomba);
     
     if(by_stomping) {
-        auto t_sprite = spawn_timed_sprite(goomba->level, goomba->position, goomba_stomp_time, sprite_goomba_flat[goomba->goomba_type]);
-        t_sprite->z_position = Z_GOOMBA_POS;
+        spawn_timed_sprite(goomba->level, goomba->position, goomba_stomp_time, sprite_goomba_flat[goomba->goomba_type], Z_GOOMBA_POS);
         audio_player::a_play_sound(global_data::get_sound(SOUND_STOMP));
     } else {
         Sprite *sprite = &anim_sets[goomba->goomba_type].frames[0].sprite;
@@ -1,6 +1,7 @@
 #include "koopa.h"
 #include "all_entities.h"
 #include "data.h"
+#include "level_effects.h"
 
 namespace {
     constexpr float32_t koopa_speed   = 40.0f;
@@ -149,12 +150,12 @@ ENTITY_RENDER_PROC(render_koopa) {
 HIT_CALLBACK_PROC(koopa_hit_callback) {
     auto koopa = self_base->as<Koopa>();
 
-    if(((collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) || (collision.with_entity != NULL && collision.with_entity->entity_type_id == entity_type_id(Koopa))) && collision.axis == X_AXIS) {
+    if(((collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) || (collision.with_entity != NULL && collision.with_entity->entity_type_id == entity_type_id(Koopa))) && collision.axis == X_AXIS) {
         koopa->change_move_dir_next_frame = true;
         return hit_callback_result(true);
     }
 
-    if((koopa->koopa_type == KOOPA_TYPE_RED_FLYING || koopa->koopa_type == KOOPA_TYPE_GREEN_FLYING) && collision.with_tile != NULL && collision.axis == Y_AXIS && collision.unit == -1 && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
+    if((koopa->koopa_type == KOOPA_TYPE_RED_FLYING || koopa->koopa_type == KOOPA_TYPE_GREEN_FLYING) && collision.with_tile != NULL && collision.axis == Y_AXIS && collision.unit == -1 && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
         koopa->bounce_next_frame = true;
         return hit_callback_result(true);
     }
@@ -185,6 +186,7 @@ void hit_koopa(Koopa *koopa) {
 ENTITY_UPDATE_PROC(update_koopa_shell);
 ENTITY_RENDER_PROC(render_koopa_shell);
 HIT_CALLBACK_PROC(shell_hit_callback);
+MOVE_PREPARE_PROC(prepare_shell_move);
 
 const float32_t shell_speed   = 240.0f;
 const float32_t shell_gravity = 200.0f;
@@ -209,6 +211,7 @@ KoopaShell *spawn_koopa_shell(Koopa *koopa, EKoopaType koopa_type) {
 
     auto move_data = &shell->move_data;
     move_data->hit_callback = shell_hit_callback;
+    move_data->prepare_proc = prepare_shell_move;
     shell->has_move_data = move_data;
 
     shell->move_dir = 0;
@@ -220,16 +223,23 @@ KoopaShell *spawn_koopa_shell(Koopa *koopa, EKoopaType koopa_type) {
 ENTITY_UPDATE_PROC(update_koopa_shell) {
     auto shell = self_base->as<KoopaShell>();
 
+    prepare_move(shell, &shell->move_data, delta_time);
+    do_move(shell, &shell->move_data, delta_time);
+
+    update_anim(&shell->anim_player, delta_time);
+}
+
+MOVE_PREPARE_PROC(prepare_shell_move) {
+    auto shell = self_base->as<KoopaShell>();
+
     if(shell->change_move_dir_next_frame) {
         shell->move_dir *= -1;
         shell->change_move_dir_next_frame = false;
     }
 
     shell->move_data.speed.x = shell_speed * shell->move_dir;
-    shell->move_data.speed.y -= shell_gravity * delta_time;
-    do_move(shell, &shell->move_data, delta_time);
-
-    update_anim(&shell->anim_player, delta_time);
+    *gravity = shell_gravity;
+    return true;
 }
 
 ENTITY_RENDER_PROC(render_koopa_shell) {
@@ -248,7 +258,7 @@ ENTITY_RENDER_PROC(render_koopa_shell) {
 HIT_CALLBACK_PROC(shell_hit_callback) {
     auto shell = self_base->as<KoopaShell>();
 
-    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
+    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
         shell->change_move_dir_next_frame = true;
         return hit_callback_result(true);
     }
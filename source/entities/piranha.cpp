@@ -1,6 +1,7 @@
 #include "piranha.h"
 #include "all_entities.h"
 #include "data.h"
+#include "level_effects.h"
 
 namespace {
     constexpr float32_t piranha_wait_time = 2.0f;
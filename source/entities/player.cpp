@@ -1,6 +1,7 @@
 #include "player.h"
 #include "data.h"
 #include "all_entities.h"
+#include "level_effects.h"
 
 #define CHEATOS aaaaa
 
@@ -92,7 +93,7 @@ ENTITY_RENDER_PROC(render_player);
 HIT_CALLBACK_PROC(player_hit_callback);
 
 Player *spawn_player(Level *level, vec2i position) {
-    assert(level->entities.first_of_type[entity_type_id(Player)] == NULL, "Only one player allowed");
+    assert(level->entities.count_of_type[entity_type_id(Player)] == 0, "Only one player allowed");
 
     auto player = create_entity_m(level, Player);
     player->position = position;
@@ -305,7 +306,7 @@ ENTITY_UPDATE_PROC(update_player) {
                     player->is_croutching = true;
                 } else {
                     bool can_be_uncroutched = true;
-                    for_entity_type(level, Tilemap, tilemap) {
+                    for_tilemap_overlapping(level, player->position, &player->collider_big, { }, tilemap) {
                         FindTileCollisionOpts opts = { };
                         opts.tile_flags_required = TILE_FLAG_BLOCKS_MOVEMENT;
                         if(find_collisions(player->position, &player->collider_big, tilemap, {}, opts).size() != 0) {
@@ -574,7 +575,7 @@ ENTITY_UPDATE_PROC(update_player) {
             FindTileCollisionOpts opts;
             opts.tile_flags_required = TILE_FLAG_BLOCKS_MOVEMENT;
             bool collided_with_tile = false;
-            for_entity_type(level, Tilemap, tilemap) {
+            for_tilemap_overlapping(level, player->position, player->has_collider, (vec2i{ 1, 0 }), tilemap) {
                 if(is_colliding_with_any_tile(player->position, player->has_collider, tilemap, { 1, 0 }, opts)) {
                     collided_with_tile = true;
                     break;
@@ -827,7 +828,7 @@ HIT_CALLBACK_PROC(player_hit_callback) {
     // Maybe hit the tile
     if(collision.axis == Y_AXIS && collision.unit == 1 && collision.with_tile != NULL) {
         Tile *tile = collision.with_tile;
-        if(tile->is_not_empty) {
+        if(tile->is_not_empty()) {
             const int32_t player_top = player->position.y + player->has_collider->offset.y + player->has_collider->size.y;
             const bool    hit_from_below = player_top - collision.unit < tile->get_ti().position.y;
             if(hit_from_below) {
@@ -881,6 +882,7 @@ void kill_player(Player *player) {
 ENTITY_UPDATE_PROC(update_fireball);
 ENTITY_RENDER_PROC(render_fireball);
 HIT_CALLBACK_PROC(fireball_hit_callback);
+MOVE_PREPARE_PROC(prepare_fireball_move);
 
 constexpr float32_t fireball_speed        = 200.0f;
 constexpr float32_t fireball_gravity      = 1300.0f;
@@ -917,6 +919,7 @@ Fireball *throw_fireball(Level *level, vec2i position, int32_t direction) {
 
     auto move_data = &fireball->move_data;
     move_data->hit_callback = fireball_hit_callback;
+    move_data->prepare_proc = prepare_fireball_move;
     fireball->has_move_data = move_data;
     fireball->move_dir = direction;
 
@@ -929,25 +932,11 @@ ENTITY_UPDATE_PROC(update_fireball) {
     auto fireball = self_base->as<Fireball>();
     auto level    = fireball->level;
 
-    if(fireball->change_move_dir_next_frame) {
-        fireball->move_dir *= -1;
-        fireball->change_move_dir_next_frame = false;
-    }
-
-    if(fireball->bounce_next_frame) {
-        fireball->bounce_count += 1;
-        fireball->move_data.speed.y = fireball_bounce_power;
-        fireball->bounce_next_frame = false;
-    }
-
-    fireball->move_data.speed.y -= fireball_gravity * delta_time;
-    fireball->move_data.speed.x = fireball->move_dir * fireball_speed;
-
+    prepare_move(fireball, &fireball->move_data, delta_time);
     do_move(fireball, &fireball->move_data, delta_time);
     
     if(fireball->bounce_count > fireball_max_bounces || fireball->delete_self) {
-        auto t_anim = spawn_timed_anim(fireball->level, fireball->position + fireball->collider.offset + fireball->collider.size / 2, &fireball_explosion_anim_set);
-        t_anim->centered = true;
+        spawn_timed_anim(fireball->level, fireball->position + fireball->collider.offset + fireball->collider.size / 2, &fireball_explosion_anim_set, true);
         delete_entity(fireball);
         return;
     }
@@ -971,14 +960,33 @@ ENTITY_RENDER_PROC(render_fireball) {
     render::r_sprite(fireball->position, 0, frame->size(), frame->sprite, color::white);
 }
 
+MOVE_PREPARE_PROC(prepare_fireball_move) {
+    auto fireball = self_base->as<Fireball>();
+
+    if(fireball->change_move_dir_next_frame) {
+        fireball->move_dir *= -1;
+        fireball->change_move_dir_next_frame = false;
+    }
+
+    if(fireball->bounce_next_frame) {
+        fireball->bounce_count += 1;
+        fireball->move_data.speed.y = fireball_bounce_power;
+        fireball->bounce_next_frame = false;
+    }
+
+    fireball->move_data.speed.x = fireball->move_dir * fireball_speed;
+    *gravity = fireball_gravity;
+    return true;
+}
+
 HIT_CALLBACK_PROC(fireball_hit_callback) {
     auto fireball = self_base->as<Fireball>();
 
-    if(collision.axis == Y_AXIS && collision.unit == -1 && ((collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE))
+    if(collision.axis == Y_AXIS && collision.unit == -1 && ((collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE))
        || collision.with_entity != NULL && (collision.with_entity->entity_flags & E_FLAG_ALWAYS_BLOCKS_MOVEMENT || collision.with_entity->entity_flags & E_FLAG_BLOCKS_MOVEMENT_FROM_ABOVE_ONLY))) {
         fireball->bounce_next_frame = true;
         return hit_callback_result(true);
-    } else if(collision.axis == X_AXIS && (collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE))
+    } else if(collision.axis == X_AXIS && (collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(collision.with_tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE))
               || (collision.with_entity != NULL && collision.with_entity->entity_flags & E_FLAG_ALWAYS_BLOCKS_MOVEMENT)) {
         fireball->change_move_dir_next_frame = true;
         return hit_callback_result(true);
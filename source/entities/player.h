@@ -132,7 +132,7 @@ void apply_star_powerup(Player *player);
 
 inline Player *get_player(Level *level) {
     assert(level->entities.count_of_type[entity_type_id(Player)] <= 1);
-    return level->entities.first_of_type[entity_type_id(Player)]->as<Player>();
+    return first_entity_of_type(level, Player);
 }
 
 struct Fireball : Entity {
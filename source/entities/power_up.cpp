@@ -61,6 +61,7 @@ ENTITY_DESERIALIZE_PROC(Mushroom) {
 ENTITY_UPDATE_PROC(update_mushroom);
 ENTITY_RENDER_PROC(render_mushroom);
 HIT_CALLBACK_PROC(mushroom_hit_callback);
+MOVE_PREPARE_PROC(prepare_mushroom_move);
 
 Mushroom *spawn_mushroom(Level *level, vec2i position) {
     auto mushroom = create_entity_m(level, Mushroom);
@@ -76,6 +77,7 @@ Mushroom *spawn_mushroom(Level *level, vec2i position) {
 
     auto move_data = &mushroom->move_data;
     move_data->hit_callback = mushroom_hit_callback;
+    move_data->prepare_proc = prepare_mushroom_move;
     mushroom->has_move_data = move_data;
 
     mushroom->spawn_anim.finished = true;
@@ -100,9 +102,7 @@ ENTITY_UPDATE_PROC(update_mushroom) {
         return;
     }
 
-    mushroom->move_data.speed.x = mushroom->direction * mushroom_speed;
-    mushroom->move_data.speed.y -= mushroom_gravity * delta_time;
-
+    prepare_move(mushroom, mushroom->has_move_data, delta_time);
     do_move(mushroom, mushroom->has_move_data, delta_time);
 
     if(mushroom->change_dir_after_move) {
@@ -111,6 +111,17 @@ ENTITY_UPDATE_PROC(update_mushroom) {
     }
 }
 
+MOVE_PREPARE_PROC(prepare_mushroom_move) {
+    auto mushroom = self_base->as<Mushroom>();
+    if(!mushroom->spawn_anim.finished) {
+        return false;
+    }
+
+    mushroom->move_data.speed.x = mushroom->direction * mushroom_speed;
+    *gravity = mushroom_gravity;
+    return true;
+}
+
 ENTITY_RENDER_PROC(render_mushroom) {
     auto mushroom = self_base->as<Mushroom>();
 
@@ -127,7 +138,7 @@ ENTITY_RENDER_PROC(render_mushroom) {
 HIT_CALLBACK_PROC(mushroom_hit_callback) {
     auto mushroom = self_base->as<Mushroom>();
 
-    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
+    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
         mushroom->change_dir_after_move = true;
         return hit_callback_result(true);
     }
@@ -192,6 +203,7 @@ ENTITY_RENDER_PROC(render_fire_plant) {
 ENTITY_UPDATE_PROC(update_star);
 ENTITY_RENDER_PROC(render_star);
 HIT_CALLBACK_PROC(star_hit_callback);
+MOVE_PREPARE_PROC(prepare_star_move);
 
 Star *spawn_star(Level *level, vec2i position) {
     auto star = create_entity_m(level, Star);
@@ -211,6 +223,7 @@ Star *spawn_star(Level *level, vec2i position) {
     move_data->speed.x = star_x_speed;
     move_data->speed.y = star_bounce_power;
     move_data->hit_callback = star_hit_callback;
+    move_data->prepare_proc = prepare_star_move;
     star->has_move_data = move_data;
 
     star->anim_player = init_anim_player(&star_anim_set);
@@ -235,9 +248,7 @@ ENTITY_UPDATE_PROC(update_star) {
         return;
     }
 
-    star->move_data.speed.x = star->direction * star_x_speed;
-    star->move_data.speed.y -= star_gravity * delta_time;
-    
+    prepare_move(star, &star->move_data, delta_time);
     do_move(star, &star->move_data, delta_time);
 
     if(star->bounce_after_move) {
@@ -267,15 +278,26 @@ ENTITY_RENDER_PROC(render_star) {
     render::r_sprite(position, z_pos, frame->size(), frame->sprite, color::white);
 }
 
+MOVE_PREPARE_PROC(prepare_star_move) {
+    auto star = self_base->as<Star>();
+    if(!star->spawn_anim.finished) {
+        return false;
+    }
+
+    star->move_data.speed.x = star->direction * star_x_speed;
+    *gravity = star_gravity;
+    return true;
+}
+
 HIT_CALLBACK_PROC(star_hit_callback) {
     auto star = self_base->as<Star>();
 
-    if(collision.axis == Y_AXIS && collision.unit == -1 && collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
+    if(collision.axis == Y_AXIS && collision.unit == -1 && collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
         star->bounce_after_move = true;
         return hit_callback_result(true);
     }
 
-    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
+    if(collision.axis == X_AXIS && collision.with_tile != NULL && collision.with_tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT) {
         star->change_dir_after_move = true;
         return hit_callback_result(true);
     }
@@ -1,6 +1,13 @@
 #include "tilemap.h"
 #include "data.h"
 #include "all_entities.h"
+#include "level_effects.h"
+#include "entity_costs.h"
+#include "memory_tags.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace {
     constexpr float32_t hit_anim_time = 0.1f;
@@ -10,26 +17,254 @@ namespace {
     AnimSet anim_sets[TILE_ANIM__COUNT];
 };
 
+static inline
+int32_t lowest_set_bit(uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, bits);
+    return (int32_t)idx;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
 TileInfo Tile::get_ti(void) {
     assert(this->tilemap != NULL, "Invalid tile.");
     return tile_info(vec2i{ this->tile_x, this->tile_y } + this->tilemap->get_position_ti().tile);
 }
 
+// Slot of the tile, NULL if its chunk isn't allocated
+static inline
+Tile *find_tile_slot(Tilemap *tilemap, int32_t x, int32_t y) {
+    TileChunk *chunk = tilemap->get_chunk(x / TILE_CHUNK_WIDTH, y / TILE_CHUNK_HEIGHT);
+    return chunk != NULL ? &chunk->tiles[y % TILE_CHUNK_HEIGHT][x % TILE_CHUNK_WIDTH] : NULL;
+}
+
+static void set_tile_desc_idx(Tile *tile, uint16_t desc_idx);
+
+static
+TileChunk *create_tile_chunk(Tilemap *tilemap, int32_t chunk_x, int32_t chunk_y) {
+    const int32_t chunk_idx = chunk_y * tilemap->x_chunks + chunk_x;
+    assert(tilemap->chunks[chunk_idx] == NULL);
+
+    TileChunk *chunk = tagged_malloc_and_zero_struct(MEMORY_TAG_TILEMAP, TileChunk);
+    tilemap->chunks[chunk_idx] = chunk;
+    tilemap->chunk_count += 1;
+
+    for(int32_t y_tile = 0; y_tile < TILE_CHUNK_HEIGHT; ++y_tile) {
+        for(int32_t x_tile = 0; x_tile < TILE_CHUNK_WIDTH; ++x_tile) {
+            Tile *tile = &chunk->tiles[y_tile][x_tile];
+            tile->tilemap  = tilemap;
+            tile->tile_x   = (int16_t)(chunk_x * TILE_CHUNK_WIDTH + x_tile);
+            tile->tile_y   = (int16_t)(chunk_y * TILE_CHUNK_HEIGHT + y_tile);
+            tile->desc_idx = TILE_DESC_EMPTY;
+        }
+    }
+
+    // Streamed back in
+    uint16_t *retired = tilemap->retired_chunks != NULL ? tilemap->retired_chunks[chunk_idx] : NULL;
+    if(retired != NULL) {
+        for(int32_t y_tile = 0; y_tile < TILE_CHUNK_HEIGHT; ++y_tile) {
+            for(int32_t x_tile = 0; x_tile < TILE_CHUNK_WIDTH; ++x_tile) {
+                set_tile_desc_idx(&chunk->tiles[y_tile][x_tile], retired[y_tile * TILE_CHUNK_WIDTH + x_tile]);
+            }
+        }
+        tagged_free(retired);
+        tilemap->retired_chunks[chunk_idx] = NULL;
+    }
+    return chunk;
+}
+
+static
+Tile *get_or_create_tile_slot(Tilemap *tilemap, int32_t x, int32_t y) {
+    TileChunk *chunk = tilemap->get_chunk(x / TILE_CHUNK_WIDTH, y / TILE_CHUNK_HEIGHT);
+    if(chunk == NULL) {
+        chunk = create_tile_chunk(tilemap, x / TILE_CHUNK_WIDTH, y / TILE_CHUNK_HEIGHT);
+    }
+    return &chunk->tiles[y % TILE_CHUNK_HEIGHT][x % TILE_CHUNK_WIDTH];
+}
+
+// Also for tiles of retired chunks
+static
+uint16_t get_tile_desc_idx(Tilemap *tilemap, int32_t x, int32_t y) {
+    Tile *tile = find_tile_slot(tilemap, x, y);
+    if(tile != NULL) {
+        return tile->desc_idx;
+    }
+
+    uint16_t *retired = tilemap->retired_chunks != NULL ? tilemap->retired_chunks[(y / TILE_CHUNK_HEIGHT) * tilemap->x_chunks + x / TILE_CHUNK_WIDTH] : NULL;
+    return retired != NULL ? retired[(y % TILE_CHUNK_HEIGHT) * TILE_CHUNK_WIDTH + x % TILE_CHUNK_WIDTH] : TILE_DESC_EMPTY;
+}
+
+static
+void update_tile_collision_bits(Tile *tile) {
+    TileChunk *chunk = tile->tilemap->get_chunk(tile->tile_x / TILE_CHUNK_WIDTH, tile->tile_y / TILE_CHUNK_HEIGHT);
+    const uint32_t flags = tile->get_desc().tile_flags;
+
+    const bool layer_bits[TILE_LAYER__COUNT] = {
+        tile->is_not_empty(),
+        (flags & TILE_FLAG_BLOCKS_MOVEMENT) != 0,
+        (flags & TILE_FLAG_IS_INVISIBLE) != 0,
+        (flags & TILE_FLAG_BREAKABLE) != 0,
+    };
+
+    const uint64_t bit = 1ull << (tile->tile_x % TILE_CHUNK_WIDTH);
+    for(int32_t layer = 0; layer < TILE_LAYER__COUNT; ++layer) {
+        uint64_t *row = &chunk->layers[layer][tile->tile_y % TILE_CHUNK_HEIGHT];
+        if(layer_bits[layer]) {
+            *row |= bit;
+        } else {
+            *row &= ~bit;
+        }
+    }
+}
+
+static
+bool tile_descs_equal(const TileDesc &a, const TileDesc &b) {
+    return a.tile_flags             == b.tile_flags
+        && a.tile_drop              == b.tile_drop
+        && a.drops_left             == b.drops_left
+        && a.is_animated            == b.is_animated
+        && a.tile_anim              == b.tile_anim
+        && a.tile_sprite            == b.tile_sprite
+        && a.tile_sprite_after_drop == b.tile_sprite_after_drop
+        && a.tile_break_anim        == b.tile_break_anim;
+}
+
+// Palette index of the desc, added if the tilemap doesn't have it yet
+static
+uint16_t intern_tile_desc(Tilemap *tilemap, TileDesc desc) {
+    for(int32_t idx = TILE_DESC_EMPTY + 1; idx < tilemap->palette_count; ++idx) {
+        if(tile_descs_equal(tilemap->palette[idx], desc)) {
+            return (uint16_t)idx;
+        }
+    }
+
+    assert(tilemap->palette_count <= UINT16_MAX, "Tilemap palette is full.");
+
+    if(tilemap->palette_count == tilemap->palette_capacity) {
+        TileDesc *old_palette = tilemap->palette;
+        tilemap->palette_capacity *= 2;
+        tilemap->palette = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, TileDesc, tilemap->palette_capacity);
+        memcpy(tilemap->palette, old_palette, sizeof(TileDesc) * tilemap->palette_count);
+        tagged_free(old_palette);
+    }
+
+    tilemap->palette[tilemap->palette_count] = desc;
+    return (uint16_t)tilemap->palette_count++;
+}
+
+static
+void set_tile_desc_idx(Tile *tile, uint16_t desc_idx) {
+    tile->desc_idx = desc_idx;
+    update_tile_collision_bits(tile);
+}
+
+// Tiles don't own their desc, changing one points the tile at the modified copy
+static
+void set_tile_desc(Tile *tile, TileDesc desc) {
+    set_tile_desc_idx(tile, intern_tile_desc(tile->tilemap, desc));
+}
+
+static
+int32_t find_hit_anim(Tilemap *tilemap, int32_t tile_idx) {
+    for(int32_t idx = 0; idx < tilemap->hit_anim_count; ++idx) {
+        if(tilemap->hit_anims[idx].tile_idx == tile_idx) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+static
+void remove_hit_anim(Tilemap *tilemap, int32_t idx) {
+    const int32_t tile_idx = tilemap->hit_anims[idx].tile_idx;
+    find_tile_slot(tilemap, tile_idx % tilemap->x_tiles, tile_idx / tilemap->x_tiles)->in_hit_anim = false;
+    for(int32_t next = idx + 1; next < tilemap->hit_anim_count; ++next) {
+        tilemap->hit_anims[next - 1] = tilemap->hit_anims[next];
+    }
+    tilemap->hit_anim_count -= 1;
+}
+
+// False if there's no free entry
+static
+bool start_hit_anim(Tile *tile) {
+    Tilemap *tilemap = tile->tilemap;
+    const int32_t tile_idx = tile->tile_y * tilemap->x_tiles + tile->tile_x;
+
+    int32_t idx = find_hit_anim(tilemap, tile_idx);
+    if(idx < 0) {
+        if(tilemap->hit_anim_count == MAX_TILE_HIT_ANIMS) {
+            return false;
+        }
+
+        // Keep them in tile order, that's the order they finish in when finishing on the same frame
+        idx = tilemap->hit_anim_count;
+        while(idx > 0 && tilemap->hit_anims[idx - 1].tile_idx > tile_idx) {
+            tilemap->hit_anims[idx] = tilemap->hit_anims[idx - 1];
+            idx -= 1;
+        }
+        tilemap->hit_anim_count += 1;
+    }
+
+    TileHitAnim *hit_anim = &tilemap->hit_anims[idx];
+    hit_anim->tile_idx = tile_idx;
+    hit_anim->counter  = 0.0f;
+    hit_anim->perc     = 0.0f;
+    hit_anim->state    = TileHitAnim::HIT_ANIM_UP;
+    tile->in_hit_anim  = true;
+    return true;
+}
+
 void clear_tile(Tile *tile) {
-    tile->is_not_empty = false;
+    if(tile->in_hit_anim) {
+        Tilemap *tilemap = tile->tilemap;
+        remove_hit_anim(tilemap, find_hit_anim(tilemap, tile->tile_y * tilemap->x_tiles + tile->tile_x));
+    }
+    set_tile_desc_idx(tile, TILE_DESC_EMPTY);
 }
 
 static
-void set_tile_sprite(Tile *tile, ETileSprite sprite) {
-    tile->tile_desc.is_animated = false;
-    tile->tile_desc.tile_sprite = sprite;
+void set_tile_sprite(TileDesc *desc, ETileSprite sprite) {
+    desc->is_animated = false;
+    desc->tile_sprite = sprite;
 }
 
 static
-void set_tile_anim(Tile *tile, ETileAnim anim) {
-    tile->tile_desc.is_animated = true;
-    tile->tile_desc.tile_anim = anim;
-    set_anim(&tile->anim_player, &anim_sets[anim]);
+void add_tile_desc(EntitySaveData *es_data, const char *token, const TileDesc &desc) {
+    std::string tile_strings[] = {
+         std::to_string(desc.tile_flags),               // tile_flag
+         tile_drop_cstr[desc.tile_drop],                // tile_drop
+         std::to_string(desc.drops_left),               // drops_left
+         std::to_string((int32_t)desc.is_animated),     // is_animated
+         desc.is_animated ? tile_anim_cstr[desc.tile_anim] : tile_sprite_cstr[desc.tile_sprite], // tile_anim or tile_sprite
+         tile_sprite_cstr[desc.tile_sprite_after_drop], // tile_sprite_after_drop
+         (!(desc.tile_flags & TILE_FLAG_BREAKABLE) || desc.tile_break_anim < 0 || desc.tile_break_anim >= TILE_BREAK_ANIM__COUNT) ? "0" : tile_break_anim_cstr[desc.tile_break_anim], // tile_break_anim
+    };
+    es_data->add_string(token, tile_strings, array_count(tile_strings));
+}
+
+static
+TileDesc parse_tile_desc(std::vector<std::string> &values) {
+    TileDesc desc = { };
+
+    desc.tile_flags  = std::stoi(values[0]);
+    desc.tile_drop   = tile_drop_from_cstr(values[1].c_str());
+    desc.drops_left  = std::stoi(values[2]);
+    desc.is_animated = (bool)std::stoi(values[3]);
+    if(desc.is_animated) {
+        desc.tile_anim = tile_anim_from_cstr(values[4].c_str());
+    } else {
+        desc.tile_sprite = tile_sprite_from_cstr(values[4].c_str());
+    }
+    desc.tile_sprite_after_drop = tile_sprite_from_cstr(values[5].c_str());
+
+    if(values.size() > 6) {
+        desc.tile_break_anim = tile_break_anim_from_cstr(values[6].c_str());
+    } else {
+        desc.tile_break_anim = TILE_BREAK_ANIM_BRICK;
+    }
+    return desc;
 }
 
 ENTITY_SERIALIZE_PROC(Tilemap) {
@@ -43,29 +278,39 @@ ENTITY_SERIALIZE_PROC(Tilemap) {
     es_data.add_int32("x_tiles", &tilemap->x_tiles, 1);
     es_data.add_int32("y_tiles", &tilemap->y_tiles, 1);
 
+    // Palette entries that are in use, renumbered in order of first use
+    std::vector<int32_t> palette_remap(tilemap->palette_count, TILE_DESC_EMPTY);
+    int32_t palette_count = 0;
+
+    std::vector<int32_t> row(tilemap->x_tiles);
     for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
+        bool row_has_tiles = false;
         for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
-            Tile *tile = tilemap->get_tile(x_tile, y_tile);
-            if(tile == NULL) {
+            const uint16_t desc_idx = get_tile_desc_idx(tilemap, x_tile, y_tile);
+            if(desc_idx == TILE_DESC_EMPTY) {
+                row[x_tile] = TILE_DESC_EMPTY;
                 continue;
             }
 
+            if(palette_remap[desc_idx] == TILE_DESC_EMPTY) {
+                palette_remap[desc_idx] = ++palette_count;
+
+                char token[64];
+                sprintf_s(token, array_count(token), "palette[%d]", palette_count);
+                add_tile_desc(&es_data, token, tilemap->palette[desc_idx]);
+            }
+
+            row[x_tile] = palette_remap[desc_idx];
+            row_has_tiles = true;
+        }
+
+        if(row_has_tiles) {
             char token[64];
-            sprintf_s(token, array_count(token), "[%d,%d]", x_tile, y_tile);
-
-            std::string tile_strings[] = {
-                 std::to_string(tile->tile_desc.tile_flags),               // tile_flag
-                 tile_drop_cstr[tile->tile_desc.tile_drop],                // tile_drop
-                 std::to_string(tile->tile_desc.drops_left),               // drops_left
-                 std::to_string((int32_t)tile->tile_desc.is_animated),     // is_animated
-                 tile->tile_desc.is_animated ? tile_anim_cstr[tile->tile_desc.tile_anim] : tile_sprite_cstr[tile->tile_desc.tile_sprite], // tile_anim or tile_sprite
-                 tile_sprite_cstr[tile->tile_desc.tile_sprite_after_drop], // tile_sprite_after_drop
-                 (!(tile->tile_desc.tile_flags & TILE_FLAG_BREAKABLE) || tile->tile_desc.tile_break_anim < 0 || tile->tile_desc.tile_break_anim >= TILE_BREAK_ANIM__COUNT) ? "0" : tile_break_anim_cstr[tile->tile_desc.tile_break_anim], // tile_break_anim
-            };
-
-            es_data.add_string(token, tile_strings, array_count(tile_strings));
+            sprintf_s(token, array_count(token), "tiles[%d]", y_tile);
+            es_data.add_int32(token, row.data(), tilemap->x_tiles);
         }
     }
+    es_data.add_int32("palette_count", &palette_count, 1);
 
     return es_data;
 }
@@ -84,34 +329,48 @@ ENTITY_DESERIALIZE_PROC(Tilemap) {
     // Always spawn with tile-aligned position...
     Tilemap *tilemap = spawn_tilemap(level, tile_info_at(position).tile, x_tiles, y_tiles);
 
-    // Load tiles
-    for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
-        for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
+    int32_t palette_count;
+    if(es_data->try_get_int32("palette_count", &palette_count, 1)) {
+        // Palette and a row of palette indices for each row with tiles
+        std::vector<uint16_t> palette_remap(palette_count + 1, TILE_DESC_EMPTY);
+        for(int32_t idx = 1; idx <= palette_count; ++idx) {
             char buffer[64];
-            sprintf_s(buffer, array_count(buffer), "[%d,%d]", x_tile, y_tile);
-            
+            sprintf_s(buffer, array_count(buffer), "palette[%d]", idx);
+
             std::vector<std::string> values;
             if(es_data->try_get_all(buffer, &values)) {
-                TileDesc desc;
-
-                desc.tile_flags  = std::stoi(values[0]);
-                desc.tile_drop   = tile_drop_from_cstr(values[1].c_str());
-                desc.drops_left  = std::stoi(values[2]);
-                desc.is_animated = (bool)std::stoi(values[3]);
-                if(desc.is_animated) {
-                    desc.tile_anim = tile_anim_from_cstr(values[4].c_str());
-                } else {
-                    desc.tile_sprite = tile_sprite_from_cstr(values[4].c_str());
-                }
-                desc.tile_sprite_after_drop = tile_sprite_from_cstr(values[5].c_str());
+                palette_remap[idx] = intern_tile_desc(tilemap, parse_tile_desc(values));
+            }
+        }
 
-                if(values.size() > 6) {
-                    desc.tile_break_anim = tile_break_anim_from_cstr(values[6].c_str());
-                } else {
-                    desc.tile_break_anim = TILE_BREAK_ANIM_BRICK;
-                }
+        for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
+            char buffer[64];
+            sprintf_s(buffer, array_count(buffer), "tiles[%d]", y_tile);
 
-                tilemap->set_tile(x_tile, y_tile, desc);
+            std::vector<std::string> values;
+            if(!es_data->try_get_all(buffer, &values)) {
+                continue;
+            }
+
+            const int32_t x_count = min_value((int32_t)values.size(), tilemap->x_tiles);
+            for(int32_t x_tile = 0; x_tile < x_count; ++x_tile) {
+                const int32_t idx = std::stoi(values[x_tile]);
+                if(idx > 0 && idx <= palette_count && palette_remap[idx] != TILE_DESC_EMPTY) {
+                    set_tile_desc_idx(get_or_create_tile_slot(tilemap, x_tile, y_tile), palette_remap[idx]);
+                }
+            }
+        }
+    } else {
+        // Older levels have a token for each tile
+        for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
+            for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
+                char buffer[64];
+                sprintf_s(buffer, array_count(buffer), "[%d,%d]", x_tile, y_tile);
+
+                std::vector<std::string> values;
+                if(es_data->try_get_all(buffer, &values)) {
+                    tilemap->set_tile(x_tile, y_tile, parse_tile_desc(values));
+                }
             }
         }
     }
@@ -124,6 +383,7 @@ ENTITY_DELETE_PROC(delete_tilemap);
 
 Tilemap *spawn_tilemap(Level *level, vec2i tile, int32_t x_tiles, int32_t y_tiles) {
     assert(x_tiles > 0 && y_tiles > 0);
+    assert(x_tiles <= INT16_MAX && y_tiles <= INT16_MAX);
 
     auto tilemap = create_entity_m(level, Tilemap);
     tilemap->update_proc = update_tilemap;
@@ -133,49 +393,91 @@ Tilemap *spawn_tilemap(Level *level, vec2i tile, int32_t x_tiles, int32_t y_tile
     auto ti = tile_info(tile);
     tilemap->position = ti.position;
 
-    tilemap->tiles = malloc_and_zero_array(Tile, x_tiles * y_tiles);
     tilemap->x_tiles = x_tiles;
     tilemap->y_tiles = y_tiles;
 
-    // Initialize tiles
-    for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
-        for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
-            Tile *tile = &tilemap->tiles[y_tile * tilemap->x_tiles + x_tile];
-            zero_struct(tile);
-            tile->is_not_empty = false;
-            tile->tilemap = tilemap;
-            tile->tile_x = x_tile;
-            tile->tile_y = y_tile;
-        }
+    // Chunks get allocated by set_tile
+    tilemap->x_chunks = (x_tiles + TILE_CHUNK_WIDTH - 1) / TILE_CHUNK_WIDTH;
+    tilemap->y_chunks = (y_tiles + TILE_CHUNK_HEIGHT - 1) / TILE_CHUNK_HEIGHT;
+    tilemap->chunks = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, TileChunk *, tilemap->x_chunks * tilemap->y_chunks);
+    tilemap->chunk_count = 0;
+    tilemap->retired_chunks = NULL;
+
+    level->tile_index->dirty = true;
+
+    tilemap->palette_capacity = 16;
+    tilemap->palette_count = TILE_DESC_EMPTY + 1;
+    tilemap->palette = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, TileDesc, tilemap->palette_capacity);
+
+    for(int32_t anim = 0; anim < TILE_ANIM__COUNT; ++anim) {
+        tilemap->anim_players[anim] = init_anim_player(&anim_sets[anim]);
     }
+    tilemap->hit_anim_count = 0;
 
     return tilemap;
 }
 
+void clone_tilemap_tiles(Tilemap *tilemap) {
+    const int32_t chunk_slots = tilemap->x_chunks * tilemap->y_chunks;
+
+    TileChunk **source_chunks = tilemap->chunks;
+    tilemap->chunks = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, TileChunk *, chunk_slots);
+    for(int32_t idx = 0; idx < chunk_slots; ++idx) {
+        if(source_chunks[idx] == NULL) {
+            continue;
+        }
+
+        TileChunk *chunk = tagged_malloc_and_zero_struct(MEMORY_TAG_TILEMAP, TileChunk);
+        memcpy(chunk, source_chunks[idx], sizeof(TileChunk));
+        for(int32_t y_tile = 0; y_tile < TILE_CHUNK_HEIGHT; ++y_tile) {
+            for(int32_t x_tile = 0; x_tile < TILE_CHUNK_WIDTH; ++x_tile) {
+                chunk->tiles[y_tile][x_tile].tilemap = tilemap;
+            }
+        }
+        tilemap->chunks[idx] = chunk;
+    }
+
+    if(tilemap->retired_chunks != NULL) {
+        uint16_t **source_retired_chunks = tilemap->retired_chunks;
+        tilemap->retired_chunks = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, uint16_t *, chunk_slots);
+        for(int32_t idx = 0; idx < chunk_slots; ++idx) {
+            if(source_retired_chunks[idx] != NULL) {
+                tilemap->retired_chunks[idx] = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, uint16_t, TILE_CHUNK_HEIGHT * TILE_CHUNK_WIDTH);
+                memcpy(tilemap->retired_chunks[idx], source_retired_chunks[idx], sizeof(uint16_t) * TILE_CHUNK_HEIGHT * TILE_CHUNK_WIDTH);
+            }
+        }
+    }
+
+    TileDesc *source_palette = tilemap->palette;
+    tilemap->palette = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, TileDesc, tilemap->palette_capacity);
+    memcpy(tilemap->palette, source_palette, sizeof(TileDesc) * tilemap->palette_count);
+}
+
 static
 void maybe_drop_the_drop_after_hit_anim(Tile *tile) {
+    TileDesc desc = tile->get_desc();
 
 #define _CHANGE_SPRITE_AFTER_DROP\
-    if(tile->tile_desc.tile_flags & TILE_FLAG_CHANGES_SPRITE_AFTER_DROP) {\
-        tile->tile_desc.tile_flags &= ~TILE_FLAG_CHANGES_SPRITE_AFTER_DROP;\
-        set_tile_sprite(tile, tile->tile_desc.tile_sprite_after_drop);\
+    if(desc.tile_flags & TILE_FLAG_CHANGES_SPRITE_AFTER_DROP) {\
+        desc.tile_flags &= ~TILE_FLAG_CHANGES_SPRITE_AFTER_DROP;\
+        set_tile_sprite(&desc, desc.tile_sprite_after_drop);\
     }
 
-    switch(tile->tile_desc.tile_drop) {
+    switch(desc.tile_drop) {
         default:
         case TILE_DROP_NONE: {
             // nothing
         } break;
 
         case TILE_DROP_POWERUP: {
-            if(tile->tilemap->level->entities.first_of_type[entity_type_id(Player)]->as<Player>()->mode == PLAYER_IS_SMALL) {
+            if(first_entity_of_type(tile->tilemap->level, Player)->mode == PLAYER_IS_SMALL) {
                 spawn_mushroom(tile->tilemap->level, tile);
             } else {
                 spawn_fire_plant(tile->tilemap->level, tile);
             }
 
-            tile->tile_desc.tile_drop = TILE_DROP_NONE;
-            tile->tile_desc.tile_flags = tile->tile_desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
+            desc.tile_drop = TILE_DROP_NONE;
+            desc.tile_flags = desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
 
             _CHANGE_SPRITE_AFTER_DROP;
         } break;
@@ -183,102 +485,127 @@ void maybe_drop_the_drop_after_hit_anim(Tile *tile) {
         case TILE_DROP_STAR: {
             spawn_star(tile->tilemap->level, tile);
 
-            tile->tile_desc.tile_drop = TILE_DROP_NONE;
-            tile->tile_desc.tile_flags = tile->tile_desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
+            desc.tile_drop = TILE_DROP_NONE;
+            desc.tile_flags = desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
 
             _CHANGE_SPRITE_AFTER_DROP;
         } break;
 
         case TILE_DROP_COINS: {
-            if(tile->tile_desc.drops_left > 0) {
-                tile->tile_desc.drops_left -= 1;
+            if(desc.drops_left > 0) {
+                desc.drops_left -= 1;
             }
             
-            if(tile->tile_desc.drops_left <= 0) {
-                tile->tile_desc.tile_drop = TILE_DROP_NONE;
-                tile->tile_desc.tile_flags = tile->tile_desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
+            if(desc.drops_left <= 0) {
+                desc.tile_drop = TILE_DROP_NONE;
+                desc.tile_flags = desc.tile_flags & ~TILE_FLAG_DO_ANIM_ON_HIT;
 
                 _CHANGE_SPRITE_AFTER_DROP;
             }
         } break;
     }
+
+    set_tile_desc(tile, desc);
 }
 
 ENTITY_UPDATE_PROC(update_tilemap) {
     auto tilemap = self_base->as<Tilemap>();
 
-    for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
-        for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
-            auto tile = tilemap->get_tile(x_tile, y_tile);
-            if(tile == NULL) {
+    for(int32_t idx = 0; idx < tilemap->hit_anim_count;) {
+        TileHitAnim *hit_anim = &tilemap->hit_anims[idx];
+        if(hit_anim->state == TileHitAnim::HIT_ANIM_UP) {
+            hit_anim->counter += delta_time;
+            if(hit_anim->counter >= hit_anim_time) {
+                hit_anim->counter = hit_anim_time;
+                hit_anim->state = TileHitAnim::HIT_ANIM_DOWN;
+            }
+        } else if(hit_anim->state == TileHitAnim::HIT_ANIM_DOWN) {
+            hit_anim->counter -= delta_time;
+            if(hit_anim->counter <= 0.0f) {
+                Tile *tile = find_tile_slot(tilemap, hit_anim->tile_idx % tilemap->x_tiles, hit_anim->tile_idx / tilemap->x_tiles);
+                remove_hit_anim(tilemap, idx);
+
+                // Drop stuff that drops after the hit animation finishes
+                maybe_drop_the_drop_after_hit_anim(tile);
                 continue;
             }
+        }
+        hit_anim->perc = hit_anim->counter / hit_anim_time;
+        ++idx;
+    }
 
-            if(tile->hit_anim == Tile::HIT_ANIM_UP) {
-                tile->hit_anim_counter += delta_time;
-                if(tile->hit_anim_counter >= hit_anim_time) {
-                    tile->hit_anim_counter = hit_anim_time;
-                    tile->hit_anim = Tile::HIT_ANIM_DOWN;
-                }
-            } else if(tile->hit_anim == Tile::HIT_ANIM_DOWN) {
-                tile->hit_anim_counter -= delta_time;
-                if(tile->hit_anim_counter <= 0.0f) {
-                    tile->hit_anim_counter = 0.0f;
-                    tile->hit_anim = Tile::HIT_ANIM_NO;
-
-                    // Drop stuff that drops after the hit animation finishes
-                    maybe_drop_the_drop_after_hit_anim(tile);
-                }
-            }
-            tile->hit_anim_perc = tile->hit_anim_counter / hit_anim_time;
+    for(int32_t anim = 0; anim < TILE_ANIM__COUNT; ++anim) {
+        update_anim(&tilemap->anim_players[anim], delta_time);
+    }
+}
 
-            if(tile->tile_desc.is_animated) {
-                update_anim(&tile->anim_player, delta_time);
-            }
-        }
+static
+void render_tile(Tilemap *tilemap, Tile *tile, vec2i tilemap_tile, int32_t y_offset, int32_t z_pos) {
+    const TileDesc &desc = tile->get_desc();
+
+    // if is invisible -> do not render
+    if(desc.tile_flags & TILE_FLAG_IS_INVISIBLE || desc.tile_flags & TILE_FLAG_NO_RENDER) {
+        return;
+    }
+
+    Sprite *sprite = NULL;
+    if(desc.is_animated) {
+        sprite = &get_current_frame(&tilemap->anim_players[desc.tile_anim])->sprite;
+    } else {
+        sprite = &sprites[desc.tile_sprite];
     }
+
+    auto ti = tile_info(vec2i{ tile->tile_x, tile->tile_y } + tilemap_tile);
+    render::r_sprite(ti.position + vec2i { 0, y_offset }, z_pos, { sprite->width, sprite->height }, *sprite, color::white);
 }
 
 ENTITY_RENDER_PROC(render_tilemap) {
     auto tilemap = self_base->as<Tilemap>();
     auto tilemap_ti = tilemap->get_position_ti();
 
+    // Row by row like a dense array would be, only visiting allocated chunks and set tiles
     for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
-        for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
-            auto tile = tilemap->get_tile(x_tile, y_tile);
-            if(tile == NULL) {
-                continue;
-            }
-
-            // if is invisible -> do not render
-            if(tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE || tile->tile_desc.tile_flags & TILE_FLAG_NO_RENDER) {
+        for(int32_t chunk_x = 0; chunk_x < tilemap->x_chunks; ++chunk_x) {
+            TileChunk *chunk = tilemap->get_chunk(chunk_x, y_tile / TILE_CHUNK_HEIGHT);
+            if(chunk == NULL) {
                 continue;
             }
 
-            // Calculate offset for hit anim
-            int32_t y_offset = 0;
-            if(tile->hit_anim != Tile::HIT_ANIM_NO) {
-                y_offset = (int32_t)roundf(tile->hit_anim_perc * hit_anim_distance);
-            }
+            uint64_t bits = chunk->layers[TILE_LAYER_NOT_EMPTY][y_tile % TILE_CHUNK_HEIGHT];
+            while(bits != 0) {
+                Tile *tile = &chunk->tiles[y_tile % TILE_CHUNK_HEIGHT][lowest_set_bit(bits)];
+                bits &= bits - 1;
 
-            Sprite *sprite = NULL;
-            if(tile->tile_desc.is_animated) {
-                sprite = &get_current_frame(&tile->anim_player)->sprite;
-            } else {
-                sprite = &sprites[tile->tile_desc.tile_sprite];
+                if(!tile->in_hit_anim) {
+                    render_tile(tilemap, tile, tilemap_ti.tile, 0, Z_TILEMAP_POS);
+                }
             }
-
-            const int32_t z_pos = tile->hit_anim != Tile::HIT_ANIM_NO ? Z_NEAR_POS : Z_TILEMAP_POS;
-
-            auto ti = tile_info(vec2i{ tile->tile_x, tile->tile_y } + tilemap_ti.tile);
-            render::r_sprite(ti.position + vec2i { 0, y_offset }, z_pos, { sprite->width, sprite->height }, *sprite, color::white);
         }
     }
+
+    // Bumped tiles go in front, offset by the hit anim
+    for(int32_t idx = 0; idx < tilemap->hit_anim_count; ++idx) {
+        const TileHitAnim *hit_anim = &tilemap->hit_anims[idx];
+        const int32_t y_offset = (int32_t)roundf(hit_anim->perc * hit_anim_distance);
+        render_tile(tilemap, find_tile_slot(tilemap, hit_anim->tile_idx % tilemap->x_tiles, hit_anim->tile_idx / tilemap->x_tiles), tilemap_ti.tile, y_offset, Z_NEAR_POS);
+    }
 }
 
 ENTITY_DELETE_PROC(delete_tilemap) {
     auto tilemap = self_base->as<Tilemap>();
-    free(tilemap->tiles);
+    for(int32_t idx = 0; idx < tilemap->x_chunks * tilemap->y_chunks; ++idx) {
+        tagged_free(tilemap->chunks[idx]); // NULL is fine
+    }
+    tagged_free(tilemap->chunks);
+    if(tilemap->retired_chunks != NULL) {
+        for(int32_t idx = 0; idx < tilemap->x_chunks * tilemap->y_chunks; ++idx) {
+            tagged_free(tilemap->retired_chunks[idx]);
+        }
+        tagged_free(tilemap->retired_chunks);
+    }
+    tagged_free(tilemap->palette);
+
+    tilemap->level->tile_index->dirty = true;
 }
 
 Tile *Tilemap::get_tile(int32_t x, int32_t y) {
@@ -286,8 +613,8 @@ Tile *Tilemap::get_tile(int32_t x, int32_t y) {
         return NULL;
     }
 
-    Tile *tile = &this->tiles[y * this->x_tiles + x];
-    return tile->is_not_empty ? tile : NULL;
+    Tile *tile = find_tile_slot(this, x, y);
+    return tile != NULL && tile->is_not_empty() ? tile : NULL;
 }
 
 Tile *Tilemap::set_tile(int32_t x, int32_t y, TileDesc tile_desc) {
@@ -295,43 +622,41 @@ Tile *Tilemap::set_tile(int32_t x, int32_t y, TileDesc tile_desc) {
         return NULL;
     }
 
-    Tile *tile = &this->tiles[y * this->x_tiles + x];
-    tile->is_not_empty = true;
-    tile->tile_desc = tile_desc;
-    if(tile->tile_desc.is_animated) {
-        set_tile_anim(tile, tile_desc.tile_anim);
-    }
+    Tile *tile = get_or_create_tile_slot(this, x, y);
+    set_tile_desc(tile, tile_desc);
     return tile;
 }
 
 void tile_hit(Tile *tile, Player *player) {
     assert(tile != NULL && player != NULL);
 
-    if(!tile->is_not_empty) {
+    if(!tile->is_not_empty()) {
         return;
     }
 
     // Can be hit only if finished.
-    if(tile->tile_desc.tile_flags & TILE_FLAG_DO_ANIM_ON_HIT && tile->hit_anim != Tile::HIT_ANIM_NO) {
+    if(tile->get_desc().tile_flags & TILE_FLAG_DO_ANIM_ON_HIT && tile->in_hit_anim) {
         return;
     }
 
-    if(tile->tile_desc.tile_flags & TILE_FLAG_BECOMES_VISIBLE_AFTER_HIT) {
-        tile->tile_desc.tile_flags &= ~TILE_FLAG_IS_INVISIBLE;
-        tile->tile_desc.tile_flags &= ~TILE_FLAG_BECOMES_VISIBLE_AFTER_HIT;
+    if(tile->get_desc().tile_flags & TILE_FLAG_BECOMES_VISIBLE_AFTER_HIT) {
+        TileDesc desc = tile->get_desc();
+        desc.tile_flags &= ~TILE_FLAG_IS_INVISIBLE;
+        desc.tile_flags &= ~TILE_FLAG_BECOMES_VISIBLE_AFTER_HIT;
+        set_tile_desc(tile, desc);
     }
 
-    if(tile->tile_desc.tile_flags & TILE_FLAG_DO_ANIM_ON_HIT) {
-        tile->hit_anim = Tile::HIT_ANIM_UP;
-        tile->hit_anim_counter  = 0.0f;
+    if(tile->get_desc().tile_flags & TILE_FLAG_DO_ANIM_ON_HIT) {
+        const ETileDrop tile_drop = tile->get_desc().tile_drop;
+        const bool hit_anim_started = start_hit_anim(tile);
 
-        if(tile->tile_desc.tile_drop == TILE_DROP_NONE && player->mode == PLAYER_IS_SMALL) {
+        if(tile_drop == TILE_DROP_NONE && player->mode == PLAYER_IS_SMALL) {
             audio_player::a_play_sound(global_data::get_sound(SOUND_TILE_HIT));
-        } else if(tile->tile_desc.tile_drop != TILE_DROP_NONE && tile->tile_desc.tile_drop != TILE_DROP_COINS) {
+        } else if(tile_drop != TILE_DROP_NONE && tile_drop != TILE_DROP_COINS) {
             audio_player::a_play_sound(global_data::get_sound(SOUND_TILE_DROP));
         }
 
-        switch(tile->tile_desc.tile_drop) {
+        switch(tile_drop) {
             case TILE_DROP_COINS: {
                 spawn_coin_drop_anim(tile->tilemap->level, tile->get_ti());
                 add_coins(tile->tilemap->level, 1);
@@ -363,10 +688,15 @@ void tile_hit(Tile *tile, Player *player) {
                 } break;
             }
         }
+
+        // Too many tiles bumped at once, skip the animation
+        if(!hit_anim_started) {
+            maybe_drop_the_drop_after_hit_anim(tile);
+        }
     }
 
-    if(tile->tile_desc.tile_flags & TILE_FLAG_BREAKABLE && player->mode != PLAYER_IS_SMALL) {
-        const ETileBreakAnim break_anim = tile->tile_desc.tile_break_anim == TILE_BREAK_ANIM__INVALID ? TILE_BREAK_ANIM_BRICK : tile->tile_desc.tile_break_anim;
+    if(tile->get_desc().tile_flags & TILE_FLAG_BREAKABLE && player->mode != PLAYER_IS_SMALL) {
+        const ETileBreakAnim break_anim = tile->get_desc().tile_break_anim == TILE_BREAK_ANIM__INVALID ? TILE_BREAK_ANIM_BRICK : tile->get_desc().tile_break_anim;
         spawn_tile_break_anim(tile->tilemap->level, tile->get_ti(), break_anim);
         clear_tile(tile);
         audio_player::a_play_sound(global_data::get_sound(SOUND_DESTROY_BLOCK));
@@ -389,49 +719,72 @@ void render_tilemap_mesh(Tilemap *tilemap, int32_t z_pos, vec4 color) {
     }
 }
 
-bool is_colliding_with_any_tile(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset, FindTileCollisionOpts opts) {
-    position += offset;
-
-    // Tiles to check
-    const auto ti_min = tile_info_at(position + collider->offset);
-    const auto ti_max = tile_info_at(position + collider->offset + collider->size);
-
-    auto origin_tile = tilemap->get_position_ti().tile;
+// Keeps only the desc indices of the chunk, its hit anims are cut short
+static
+void retire_tile_chunk(Tilemap *tilemap, int32_t chunk_x, int32_t chunk_y) {
+    const int32_t chunk_idx = chunk_y * tilemap->x_chunks + chunk_x;
+    TileChunk *chunk = tilemap->chunks[chunk_idx];
+
+    for(int32_t idx = tilemap->hit_anim_count - 1; idx >= 0; --idx) {
+        const int32_t tile_idx = tilemap->hit_anims[idx].tile_idx;
+        if((tile_idx % tilemap->x_tiles) / TILE_CHUNK_WIDTH == chunk_x && (tile_idx / tilemap->x_tiles) / TILE_CHUNK_HEIGHT == chunk_y) {
+            remove_hit_anim(tilemap, idx);
+        }
+    }
 
-    vec2i tile_min = ti_min.tile - origin_tile;
-    vec2i tile_max = ti_max.tile - origin_tile;
+    if(tilemap->retired_chunks == NULL) {
+        tilemap->retired_chunks = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, uint16_t *, tilemap->x_chunks * tilemap->y_chunks);
+    }
 
-    if(tile_max.x < 0 || tile_max.y < 0 || tile_min.x >= tilemap->x_tiles || tile_min.y >= tilemap->y_tiles) {
-        return false;
+    uint16_t *retired = tagged_malloc_and_zero_array(MEMORY_TAG_TILEMAP, uint16_t, TILE_CHUNK_HEIGHT * TILE_CHUNK_WIDTH);
+    for(int32_t y_tile = 0; y_tile < TILE_CHUNK_HEIGHT; ++y_tile) {
+        for(int32_t x_tile = 0; x_tile < TILE_CHUNK_WIDTH; ++x_tile) {
+            retired[y_tile * TILE_CHUNK_WIDTH + x_tile] = chunk->tiles[y_tile][x_tile].desc_idx;
+        }
     }
+    tilemap->retired_chunks[chunk_idx] = retired;
 
-    clamp_min(&tile_min.x, 0);
-    clamp_min(&tile_min.y, 0);
-    clamp_max(&tile_max.x, tilemap->x_tiles - 1);
-    clamp_max(&tile_max.y, tilemap->y_tiles - 1);
+    tagged_free(chunk);
+    tilemap->chunks[chunk_idx] = NULL;
+    tilemap->chunk_count -= 1;
+}
 
-    for(int32_t y = tile_min.y; y <= tile_max.y; ++y) {
-        for(int32_t x = tile_min.x; x <= tile_max.x; ++x) {
-            auto tile = tilemap->get_tile(x, y);
-            if(tile == NULL) {
+void stream_tile_chunks(Tilemap *tilemap, int32_t load_min_x, int32_t load_max_x, int32_t keep_min_x, int32_t keep_max_x) {
+    const int32_t chunk_pixel_width = TILE_CHUNK_WIDTH * TILE_SIZE;
+    for(int32_t chunk_x = 0; chunk_x < tilemap->x_chunks; ++chunk_x) {
+        const int32_t left  = tilemap->position.x + chunk_x * chunk_pixel_width;
+        const int32_t right = left + chunk_pixel_width;
+
+        if(right > load_min_x && left < load_max_x) {
+            if(tilemap->retired_chunks == NULL) {
                 continue;
             }
-
-            if(opts.tile_flags_required != 0) {
-                if((tile->tile_desc.tile_flags & opts.tile_flags_required) != opts.tile_flags_required) {
-                    continue;
+            for(int32_t chunk_y = 0; chunk_y < tilemap->y_chunks; ++chunk_y) {
+                if(tilemap->retired_chunks[chunk_y * tilemap->x_chunks + chunk_x] != NULL) {
+                    create_tile_chunk(tilemap, chunk_x, chunk_y);
                 }
             }
-
-            if(opts.tile_flags_forbidden != 0) {
-                if((tile->tile_desc.tile_flags & opts.tile_flags_forbidden) != 0) {
-                    continue;
+        } else if(right <= keep_min_x || left >= keep_max_x) {
+            for(int32_t chunk_y = 0; chunk_y < tilemap->y_chunks; ++chunk_y) {
+                if(tilemap->get_chunk(chunk_x, chunk_y) != NULL) {
+                    retire_tile_chunk(tilemap, chunk_x, chunk_y);
                 }
             }
+        }
+    }
+}
 
-            const auto ti = tile_info({ x, y });
+bool has_tile_chunks_outside(Tilemap *tilemap, int32_t keep_min_x, int32_t keep_max_x) {
+    const int32_t chunk_pixel_width = TILE_CHUNK_WIDTH * TILE_SIZE;
+    for(int32_t chunk_x = 0; chunk_x < tilemap->x_chunks; ++chunk_x) {
+        const int32_t left  = tilemap->position.x + chunk_x * chunk_pixel_width;
+        const int32_t right = left + chunk_pixel_width;
+        if(right > keep_min_x && left < keep_max_x) {
+            continue;
+        }
 
-            if(aabb(position + collider->offset, collider->size, ti.position + tilemap->position, TILE_SIZE_2)) {
+        for(int32_t chunk_y = 0; chunk_y < tilemap->y_chunks; ++chunk_y) {
+            if(tilemap->get_chunk(chunk_x, chunk_y) != NULL) {
                 return true;
             }
         }
@@ -439,9 +792,28 @@ bool is_colliding_with_any_tile(vec2i position, Collider *collider, Tilemap *til
     return false;
 }
 
-// @todo
-std::vector<Tile *> find_collisions(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset, FindTileCollisionOpts opts) {
-    position += offset;
+// Tiles of a chunk row that pass the layer filter
+static inline
+uint64_t get_candidate_bits(TileChunk *chunk, int32_t chunk_row, FindTileCollisionOpts opts) {
+    uint64_t bits = chunk->layers[TILE_LAYER_NOT_EMPTY][chunk_row];
+
+#define _FILTER_LAYER(flag, layer)\
+    if(opts.tile_flags_required & flag) { bits &= chunk->layers[layer][chunk_row]; }\
+    if(opts.tile_flags_forbidden & flag) { bits &= ~chunk->layers[layer][chunk_row]; }
+
+    _FILTER_LAYER(TILE_FLAG_BLOCKS_MOVEMENT, TILE_LAYER_BLOCKS_MOVEMENT);
+    _FILTER_LAYER(TILE_FLAG_IS_INVISIBLE,    TILE_LAYER_IS_INVISIBLE);
+    _FILTER_LAYER(TILE_FLAG_BREAKABLE,       TILE_LAYER_BREAKABLE);
+#undef _FILTER_LAYER
+
+    return bits;
+}
+
+// Scans the collision bit planes word by word, only the surviving tiles are looked at.
+// Stops at the first hit if collisions is NULL.
+static
+bool find_tile_collisions(vec2i position, Collider *collider, Tilemap *tilemap, FindTileCollisionOpts opts, std::vector<Tile *> *collisions) {
+    count_collision_query();
 
     // Tiles to check
     const auto ti_min = tile_info_at(position + collider->offset);
@@ -453,7 +825,7 @@ std::vector<Tile *> find_collisions(vec2i position, Collider *collider, Tilemap
     vec2i tile_max = ti_max.tile - origin_tile;
 
     if(tile_max.x < 0 || tile_max.y < 0 || tile_min.x >= tilemap->x_tiles || tile_min.y >= tilemap->y_tiles) {
-        return { };
+        return false;
     }
 
     clamp_min(&tile_min.x, 0);
@@ -461,180 +833,191 @@ std::vector<Tile *> find_collisions(vec2i position, Collider *collider, Tilemap
     clamp_max(&tile_max.x, tilemap->x_tiles - 1);
     clamp_max(&tile_max.y, tilemap->y_tiles - 1);
 
-    auto collisions = std::vector<Tile *>();
+    // Flags without a layer have to be checked on the tile itself
+    const uint32_t untracked_required  = opts.tile_flags_required & ~tile_layer_flags;
+    const uint32_t untracked_forbidden = opts.tile_flags_forbidden & ~tile_layer_flags;
+
+    const int32_t word_min = tile_min.x / TILE_CHUNK_WIDTH;
+    const int32_t word_max = tile_max.x / TILE_CHUNK_WIDTH;
+    const uint64_t mask_min = ~0ull << (tile_min.x % TILE_CHUNK_WIDTH);
+    const uint64_t mask_max = ~0ull >> (TILE_CHUNK_WIDTH - 1 - (tile_max.x % TILE_CHUNK_WIDTH));
+
+    bool found_any = false;
     for(int32_t y = tile_min.y; y <= tile_max.y; ++y) {
-        for(int32_t x = tile_min.x; x <= tile_max.x; ++x) {
-            Tile *tile = tilemap->get_tile(x, y);
-            if(tile == NULL) {
+        for(int32_t word = word_min; word <= word_max; ++word) {
+            // A word is a chunk row
+            TileChunk *chunk = tilemap->get_chunk(word, y / TILE_CHUNK_HEIGHT);
+            if(chunk == NULL) {
                 continue;
             }
 
-            if(opts.tile_flags_required != 0) {
-                if((tile->tile_desc.tile_flags & opts.tile_flags_required) != opts.tile_flags_required) {
-                    continue;
-                }
+            uint64_t bits = get_candidate_bits(chunk, y % TILE_CHUNK_HEIGHT, opts);
+            if(word == word_min) {
+                bits &= mask_min;
+            }
+            if(word == word_max) {
+                bits &= mask_max;
             }
 
-            if(opts.tile_flags_forbidden != 0) {
-                if((tile->tile_desc.tile_flags & opts.tile_flags_forbidden) != 0) {
+            while(bits != 0) {
+                const int32_t x_in_chunk = lowest_set_bit(bits);
+                const int32_t x = word * TILE_CHUNK_WIDTH + x_in_chunk;
+                bits &= bits - 1;
+
+                Tile *tile = &chunk->tiles[y % TILE_CHUNK_HEIGHT][x_in_chunk];
+                if(untracked_required != 0 && (tile->get_desc().tile_flags & untracked_required) != untracked_required) {
+                    continue;
+                }
+                if(untracked_forbidden != 0 && (tile->get_desc().tile_flags & untracked_forbidden) != 0) {
                     continue;
                 }
-            }
 
-            const auto ti = tile_info({ x, y });
+                const auto ti = tile_info({ x, y });
 
-            if(aabb(position + collider->offset, collider->size, ti.position + tilemap->position, TILE_SIZE_2)) {
-                collisions.push_back(tile);
+                if(aabb(position + collider->offset, collider->size, ti.position + tilemap->position, TILE_SIZE_2)) {
+                    if(collisions == NULL) {
+                        return true;
+                    }
+                    collisions->push_back(tile);
+                    found_any = true;
+                }
             }
         }
     }
-    return collisions;
+    return found_any;
 }
 
-namespace {
-    constexpr float32_t tile_break_anim_gravity = 280.0f;
-    constexpr float32_t tile_break_anim_time    = 3.0f;
-
-    AnimSet tile_break_anim_sets[TILE_BREAK_ANIM__COUNT];
+bool is_colliding_with_any_tile(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset, FindTileCollisionOpts opts) {
+    return find_tile_collisions(position + offset, collider, tilemap, opts, NULL);
 }
 
-ENTITY_UPDATE_PROC(update_tile_break_anim);
-ENTITY_RENDER_PROC(render_tile_break_anim);
-
-TileBreakAnim *spawn_tile_break_anim(Level *level, TileInfo ti, ETileBreakAnim tile_break_anim) {
-    auto anim = create_entity_m(level, TileBreakAnim);
-    anim->update_proc = update_tile_break_anim;
-    anim->render_proc = render_tile_break_anim;
-    anim->position = ti.position;
-
-    anim->timer = 0.0f;
-    anim->anim_player = init_anim_player(&tile_break_anim_sets[(int32_t)tile_break_anim]);
-
-    anim->speed_top  = { 40.0f, 140.0f };
-    anim->speed_bot  = { 35.0f, 110.0f };
-    anim->offset_top = { 0.0f,  0.0f };
-    anim->offset_bot = { 0.0f,  0.0f };
-
-    return anim;
+std::vector<Tile *> find_collisions(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset, FindTileCollisionOpts opts) {
+    auto collisions = std::vector<Tile *>();
+    find_tile_collisions(position + offset, collider, tilemap, opts, &collisions);
+    return collisions;
 }
 
-ENTITY_UPDATE_PROC(update_tile_break_anim) {
-    auto anim = self_base->as<TileBreakAnim>();
+void init_tilemap_common_data(void) {
+    // Copy sprites
+#define TILE_SPRITE(e_sprite, sprite_idx) sprites[e_sprite] = global_data::get_sprite(sprite_idx);
+    TILE_SPRITES;
+#undef TILE_SPRITE
+    
+    AnimSet *set = &anim_sets[TILE_ANIM_QUESTION];
+    init_anim_set(set);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_1), 1.33f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_2), 0.33f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_3), 0.33f);
+}
 
-    anim->timer += delta_time;
-    update_anim(&anim->anim_player, delta_time);
+Sprite get_tile_sprite(ETileSprite e_sprite) {
+    return sprites[e_sprite];
+}
+static inline
+int32_t tile_to_index_cell(int32_t tile) {
+    return tile >= 0 ? tile / TILE_INDEX_CELL_TILES : -((-tile - 1) / TILE_INDEX_CELL_TILES) - 1;
+}
 
-    anim->speed_top.y -= tile_break_anim_gravity * delta_time;
-    anim->speed_bot.y -= tile_break_anim_gravity * delta_time;
-    anim->offset_top  += anim->speed_top * delta_time;
-    anim->offset_bot  += anim->speed_bot * delta_time;
+static
+void rebuild_tile_index(Level *level) {
+    TileIndex *index = level->tile_index;
+    index->tilemaps.clear();
+    index->cells.clear();
+    index->origin_cell = { };
+    index->x_cells = 0;
+    index->y_cells = 0;
+    index->dirty = false;
+
+    for_entity_type(level, Tilemap, tilemap) {
+        index->tilemaps.push_back(tilemap);
+    }
 
-    if(anim->timer >= tile_break_anim_time) {
-        delete_entity(anim);
+    if(index->tilemaps.empty() || index->tilemaps.size() > TILE_INDEX_MAX_TILEMAPS) {
         return;
     }
-}
-
-ENTITY_RENDER_PROC(render_tile_break_anim) {
-    auto anim = self_base->as<TileBreakAnim>();
-    auto frame = get_current_frame(&anim->anim_player);
-
-    auto _draw_particle = [&] (vec2i offset) {
-        const vec2i position = anim->position + offset;
-        render::r_sprite(position, 0, frame->size(), frame->sprite, color::white);
-    };
-
-    const vec2i offset_bot_l = vec2i::make(anim->offset_bot) * vec2i { -1, 1 } + vec2i { -frame->size().x, 0 };
-    const vec2i offset_top_l = vec2i::make(anim->offset_top) * vec2i { -1, 1 } + vec2i { -frame->size().x, frame->size().y };
-    const vec2i offset_bot_r = vec2i::make(anim->offset_bot) + vec2i { frame->size().x, 0 };
-    const vec2i offset_top_r = vec2i::make(anim->offset_top) + vec2i { frame->size().x, frame->size().y };
-    
-    render::r_set_flip_x_quads(2);
-    _draw_particle(offset_bot_l);
-    _draw_particle(offset_top_l);
 
-    _draw_particle(offset_bot_r);
-    _draw_particle(offset_top_r);
-}
+    // Cell range of every tilemap
+    std::vector<std::pair<vec2i, vec2i>> cell_ranges;
+    vec2i cell_min = { INT32_MAX, INT32_MAX };
+    vec2i cell_max = { INT32_MIN, INT32_MIN };
+    for(Tilemap *tilemap : index->tilemaps) {
+        const vec2i origin_tile = tilemap->get_position_ti().tile;
+        const vec2i first = { tile_to_index_cell(origin_tile.x), tile_to_index_cell(origin_tile.y) };
+        const vec2i last  = { tile_to_index_cell(origin_tile.x + tilemap->x_tiles - 1), tile_to_index_cell(origin_tile.y + tilemap->y_tiles - 1) };
+        cell_ranges.push_back({ first, last });
+
+        cell_min.x = min_value(cell_min.x, first.x);
+        cell_min.y = min_value(cell_min.y, first.y);
+        cell_max.x = max_value(cell_max.x, last.x);
+        cell_max.y = max_value(cell_max.y, last.y);
+    }
 
-ENTITY_UPDATE_PROC(update_coin_drop_anim);
-ENTITY_RENDER_PROC(render_coin_drop_anim);
+    index->origin_cell = cell_min;
+    index->x_cells = cell_max.x - cell_min.x + 1;
+    index->y_cells = cell_max.y - cell_min.y + 1;
+    index->cells.assign(index->x_cells * index->y_cells, 0);
 
-namespace {
-    constexpr float32_t coin_drop_anim_time = 0.75f;
-    constexpr int32_t   coin_drop_anim_dist = 64;
-    AnimSet anim_set_coin_drop;
+    for(int32_t idx = 0; idx < (int32_t)cell_ranges.size(); ++idx) {
+        const uint64_t bit = 1ull << idx;
+        for(int32_t y = cell_ranges[idx].first.y; y <= cell_ranges[idx].second.y; ++y) {
+            for(int32_t x = cell_ranges[idx].first.x; x <= cell_ranges[idx].second.x; ++x) {
+                index->cells[(y - cell_min.y) * index->x_cells + (x - cell_min.x)] |= bit;
+            }
+        }
+    }
 }
 
-CoinDropAnim *spawn_coin_drop_anim(Level *level, TileInfo ti) {
-    auto coin_anim = create_entity_m(level, CoinDropAnim);
-    coin_anim->update_proc = update_coin_drop_anim;
-    coin_anim->render_proc = render_coin_drop_anim;
-    coin_anim->position = ti.position + vec2i{ 0, 5 };
-
-    coin_anim->anim_player = init_anim_player(&anim_set_coin_drop);
-    return coin_anim;
-}
+TilemapIterator query_tile_index(Level *level, vec2i position, Collider *collider, vec2i offset) {
+    TileIndex *index = level->tile_index;
+    if(index->dirty) {
+        rebuild_tile_index(level);
+    }
 
-ENTITY_UPDATE_PROC(update_coin_drop_anim) {
-    auto coin_anim = self_base->as<CoinDropAnim>();
+    TilemapIterator iter = { };
+    iter.tilemaps = index->tilemaps.data();
+    if(index->tilemaps.size() > TILE_INDEX_MAX_TILEMAPS) {
+        iter.count = (int32_t)index->tilemaps.size();
+        return iter;
+    }
 
-    coin_anim->timer += delta_time;
-    coin_anim->timer_perc = coin_anim->timer / coin_drop_anim_time;
+    if(index->cells.empty()) {
+        return iter;
+    }
 
-    update_anim(&coin_anim->anim_player, delta_time);
+    // Same tile range as find_collisions
+    position += offset;
+    const vec2i tile_min = tile_info_at(position + collider->offset).tile;
+    const vec2i tile_max = tile_info_at(position + collider->offset + collider->size).tile;
 
-    if(coin_anim->timer >= coin_drop_anim_time) {
-        delete_entity(coin_anim);
-        return;
+    vec2i cell_min = vec2i{ tile_to_index_cell(tile_min.x), tile_to_index_cell(tile_min.y) } - index->origin_cell;
+    vec2i cell_max = vec2i{ tile_to_index_cell(tile_max.x), tile_to_index_cell(tile_max.y) } - index->origin_cell;
+    if(cell_max.x < 0 || cell_max.y < 0 || cell_min.x >= index->x_cells || cell_min.y >= index->y_cells) {
+        return iter;
     }
-}
 
-ENTITY_RENDER_PROC(render_coin_drop_anim) {
-    auto coin_anim = self_base->as<CoinDropAnim>();
-    auto frame = get_current_frame(&coin_anim->anim_player);
+    clamp_min(&cell_min.x, 0);
+    clamp_min(&cell_min.y, 0);
+    clamp_max(&cell_max.x, index->x_cells - 1);
+    clamp_max(&cell_max.y, index->y_cells - 1);
 
-    const vec2i position_offset = { 0, (int32_t)roundf(sinf(square(coin_anim->timer_perc) * M_PI) * coin_drop_anim_dist) };
-    render::r_sprite(coin_anim->position + position_offset, Z_TILEMAP_POS + 5, frame->size(), frame->sprite, color::white);
+    for(int32_t y = cell_min.y; y <= cell_max.y; ++y) {
+        for(int32_t x = cell_min.x; x <= cell_max.x; ++x) {
+            iter.bits |= index->cells[y * index->x_cells + x];
+        }
+    }
+    return iter;
 }
 
-void init_tilemap_common_data(void) {
-    // Copy sprites
-#define TILE_SPRITE(e_sprite, sprite_idx) sprites[e_sprite] = global_data::get_sprite(sprite_idx);
-    TILE_SPRITES;
-#undef TILE_SPRITE
-    
-    AnimSet *set = &anim_sets[TILE_ANIM_QUESTION];
-    init_anim_set(set);
-    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_1), 1.33f);
-    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_2), 0.33f);
-    next_anim_frame(set, global_data::get_sprite(SPRITE_BLOCK_QUESTION_3), 0.33f);
-
-    /* Initialize tile break anim sets */ {
-        AnimSet *set = NULL;
-
-        set = &tile_break_anim_sets[TILE_BREAK_ANIM_BRICK];
-        init_anim_set(set);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_1), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_2), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_3), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_4), 0.2f);
+Tilemap *TilemapIterator::next(void) {
+    if(this->count > 0) {
+        return this->idx < this->count ? this->tilemaps[this->idx++] : NULL;
+    }
 
-        set = &tile_break_anim_sets[TILE_BREAK_ANIM_BRICK_UG];
-        init_anim_set(set);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_1), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_2), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_3), 0.2f);
-        next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_4), 0.2f);
+    if(this->bits == 0) {
+        return NULL;
     }
 
-    init_anim_set(&anim_set_coin_drop);
-    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_1), 0.1f);
-    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_2), 0.1f);
-    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_3), 0.1f);
-    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_4), 0.1f);
+    const int32_t idx = lowest_set_bit(this->bits);
+    this->bits &= this->bits - 1;
+    return this->tilemaps[idx];
 }
-
-Sprite get_tile_sprite(ETileSprite e_sprite) {
-    return sprites[e_sprite];
-}
\ No newline at end of file
@@ -140,39 +140,87 @@ struct TileDesc {
     ETileBreakAnim tile_break_anim; // if TILE_FLAG_BREAKABLE is set
 };
 
+#define TILE_DESC_EMPTY 0 // Palette index of tiles that aren't set
+
 struct Tilemap;
 struct Tile {
-    bool is_not_empty;
     Tilemap *tilemap;
-    int32_t  tile_x; // Relative to the tilemap
-    int32_t  tile_y; // Relative to the tilemap
-    
-    TileDesc   tile_desc;
-    AnimPlayer anim_player;
-
-    // Hit animation
-    float32_t hit_anim_counter;
-    float32_t hit_anim_perc;
-    enum { 
-        HIT_ANIM_NO, 
-        HIT_ANIM_UP, 
-        HIT_ANIM_DOWN 
-    } hit_anim;
+    int16_t  tile_x; // Relative to the tilemap
+    int16_t  tile_y; // Relative to the tilemap
+    uint16_t desc_idx; // Into the tilemap's palette, the TileDesc is shared with every tile that looks and behaves the same
+    bool     in_hit_anim; // Has an entry in the tilemap's hit_anims
+
+    inline bool is_not_empty(void) {
+        return this->desc_idx != TILE_DESC_EMPTY;
+    }
 
+    inline const TileDesc &get_desc(void); // Invalidated when the palette grows, don't hold on to it
     TileInfo get_ti(void);
 };
 
+// Tiles bumped by the player, only a few at a time so the state isn't kept per tile
+#define MAX_TILE_HIT_ANIMS 16
+struct TileHitAnim {
+    int32_t   tile_idx; // y * x_tiles + x, entries are sorted by it
+    float32_t counter;
+    float32_t perc;
+    enum {
+        HIT_ANIM_UP,
+        HIT_ANIM_DOWN
+    } state;
+};
+
 void clear_tile(Tile *tile);
 void tile_hit(Tile *tile, struct Player *player);
 
 ENTITY_SERIALIZE_PROC(Tilemap);
 ENTITY_DESERIALIZE_PROC(Tilemap);
 
+// Collision bit planes, one bit per tile, a 64-bit word per chunk row.
+// Mirror of the flags that collision queries filter on, so those don't have to touch the Tile data.
+enum ETileCollisionLayer : int32_t {
+    TILE_LAYER_NOT_EMPTY,
+    TILE_LAYER_BLOCKS_MOVEMENT,
+    TILE_LAYER_IS_INVISIBLE,
+    TILE_LAYER_BREAKABLE,
+    TILE_LAYER__COUNT
+};
+
+constexpr uint32_t tile_layer_flags = TILE_FLAG_BLOCKS_MOVEMENT | TILE_FLAG_IS_INVISIBLE | TILE_FLAG_BREAKABLE;
+
+// Tiles are allocated in chunks when the first tile in the chunk gets set, empty parts of the tilemap cost only a NULL.
+// In streamed levels chunks far from the camera are retired to their palette indices and allocated again when it gets back.
+#define TILE_CHUNK_WIDTH  64 // One word of a collision layer row
+#define TILE_CHUNK_HEIGHT 16
+static_assert(TILE_CHUNK_WIDTH == 64, "Chunk rows are the words of the collision layers.");
+
+struct TileChunk {
+    uint64_t layers[TILE_LAYER__COUNT][TILE_CHUNK_HEIGHT];
+    Tile     tiles[TILE_CHUNK_HEIGHT][TILE_CHUNK_WIDTH];
+};
+
 struct Tilemap : Entity {
-    Tile *tiles;
+    TileChunk **chunks; // [y_chunks][x_chunks], NULL where no tile was ever set
+    int32_t x_chunks;
+    int32_t y_chunks;
+    int32_t chunk_count; // Allocated ones
+    uint16_t **retired_chunks; // [y_chunks][x_chunks], desc indices of the chunks freed by streaming, NULL until one is
     int32_t x_tiles;
     int32_t y_tiles;
 
+    // Distinct tile descs, tiles are changed by interning a modified copy, so entries are never mutated
+    TileDesc *palette; // [TILE_DESC_EMPTY] is the desc of empty tiles
+    int32_t   palette_count;
+    int32_t   palette_capacity;
+
+    AnimPlayer  anim_players[TILE_ANIM__COUNT]; // Shared by animated tiles, they all start with the level
+    TileHitAnim hit_anims[MAX_TILE_HIT_ANIMS];
+    int32_t     hit_anim_count;
+
+    inline TileChunk *get_chunk(int32_t chunk_x, int32_t chunk_y) {
+        return this->chunks[chunk_y * this->x_chunks + chunk_x];
+    }
+
     TileInfo get_position_ti(void) {
         return tile_info_at(this->position);
     }
@@ -185,8 +233,15 @@ struct Tilemap : Entity {
     }
 };
 
+inline const TileDesc &Tile::get_desc(void) {
+    return this->tilemap->palette[this->desc_idx];
+}
+
 Tilemap *spawn_tilemap(Level *level, vec2i tile, int32_t x_tiles, int32_t y_tiles);
+void clone_tilemap_tiles(Tilemap *tilemap); // After copying the entity from another level, so the copy owns its tiles
 void render_tilemap_mesh(Tilemap *tilemap, int32_t z_pos, vec4 color);
+void stream_tile_chunks(Tilemap *tilemap, int32_t load_min_x, int32_t load_max_x, int32_t keep_min_x, int32_t keep_max_x); // Chunk columns overlapping the load range are restored, the ones outside of the keep range retired
+bool has_tile_chunks_outside(Tilemap *tilemap, int32_t keep_min_x, int32_t keep_max_x); // Any chunk that stream_tile_chunks would retire
 
 struct FindTileCollisionOpts {
     uint32_t tile_flags_required;
@@ -196,23 +251,19 @@ struct FindTileCollisionOpts {
 bool is_colliding_with_any_tile(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset = { }, FindTileCollisionOpts opts = { });
 std::vector<Tile *> find_collisions(vec2i position, Collider *collider, Tilemap *tilemap, vec2i offset = { }, FindTileCollisionOpts opts = { });
 
-struct TileBreakAnim : Entity {
-    float32_t  timer;
-    AnimPlayer anim_player;
-    vec2 speed_top;
-    vec2 speed_bot;
-    vec2 offset_top;
-    vec2 offset_bot;
-};
-
-TileBreakAnim *spawn_tile_break_anim(Level *level, TileInfo ti, ETileBreakAnim tile_break_anim);
+// Tilemaps out of the level's TileIndex, in slab order
+struct TilemapIterator {
+    Tilemap **tilemaps;
+    uint64_t  bits;  // Tilemaps left, by index
+    int32_t   idx;   // Walks all of them if the index has too many tilemaps for the cell masks
+    int32_t   count;
 
-struct CoinDropAnim : Entity {
-    float32_t  timer;
-    float32_t  timer_perc;
-    AnimPlayer anim_player;
+    Tilemap *next(void); // NULL at the end
 };
 
-CoinDropAnim *spawn_coin_drop_anim(Level *level, TileInfo ti);
+// Tilemaps that can have tiles in the range find_collisions would check for the same arguments
+TilemapIterator query_tile_index(Level *level, vec2i position, Collider *collider, vec2i offset = { });
+
+#define for_tilemap_overlapping(level, position, collider, offset, var_name) for(TilemapIterator _iter_##var_name = query_tile_index(level, position, collider, offset); Tilemap *var_name = _iter_##var_name.next(); )
 
 #endif /* _TILEMAP_H */
\ No newline at end of file
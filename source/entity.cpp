@@ -1,21 +1,55 @@
 #include "entity.h"
 #include "level.h"
 #include "all_entities.h"
+#include "parallel_update.h"
+#include "profiler.h"
+#include "entity_costs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOVE_BATCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static Entity *alloc_entity_slot(Level *level, EntitySlab *slab, size_t size_of_entity) {
+    if(slab->stride == 0) {
+        slab->stride = (size_of_entity + 15) & ~(size_t)15;
+    }
+    assert(size_of_entity <= slab->stride);
+
+    // Reuse a deleted one
+    if(slab->first_free != NULL) {
+        Entity *entity = slab->first_free;
+        slab->first_free = entity->next;
+        slab->free_count -= 1;
+        return entity;
+    }
 
-Entity *create_entity(struct Level *level, size_t size_of_entity, int32_t entity_type_id) {
-    Entity *created = NULL;
+    EntitySlabBlock *block = slab->last_block;
+    if(block == NULL || block->used == block->capacity) {
+        const int32_t max_capacity = max_value(1, (int32_t)((ENTITY_SLAB_MAX_BLOCK_SIZE - sizeof(EntitySlabBlock)) / slab->stride));
+        const int32_t capacity = block == NULL ? min_value(ENTITY_SLAB_MIN_BLOCK_CAPACITY, max_capacity) : min_value(block->capacity * 2, max_capacity);
 
-    Entity *first_unused_of_type = level->entities_unused.first_of_type[entity_type_id];
-    if(first_unused_of_type != NULL) {
-        created = first_unused_of_type;
-        entity_pool_remove(&level->entities_unused, first_unused_of_type, entity_type_id);
-    } else {
-        assert((level->memory_used + size_of_entity) <= level->memory_size);
-        uint8_t *memory_ptr = level->memory + level->memory_used;
-        created = (Entity *)memory_ptr;
-        level->memory_used += size_of_entity;
+        block = (EntitySlabBlock *)alloc_level_memory(level, sizeof(EntitySlabBlock) + slab->stride * capacity);
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+
+        if(slab->last_block == NULL) {
+            slab->first_block = block;
+        } else {
+            slab->last_block->next = block;
+        }
+        slab->last_block = block;
     }
 
+    return (Entity *)(block->slots() + slab->stride * block->used++);
+}
+
+Entity *create_entity(struct Level *level, size_t size_of_entity, int32_t entity_type_id) {
+    assert(!is_recording_commands(), "Can't create entities from a parallel update, spawn with run_or_defer");
+
+    Entity *created = alloc_entity_slot(level, &level->slabs[entity_type_id], size_of_entity);
+
     assert(created != NULL);
     zero_memory(created, size_of_entity);
     entity_pool_push(&level->entities, created, entity_type_id);
@@ -26,10 +60,23 @@ Entity *create_entity(struct Level *level, size_t size_of_entity, int32_t entity
     created->size_of_entity = size_of_entity;
     created->unique_id = level->next_entity_id++;
 
+    level->memory_in_use += size_of_entity;
+    level->memory_high_water = max_value(level->memory_high_water, level->memory_in_use);
+
     return created;
 }
 
+void make_asleep(Entity *entity) {
+    set_entity_flag(entity, E_FLAG_SLEEPS_UNTIL_AWAKEN);
+    entity->is_asleep = true;
+    entity->level->wake_up_sweep->dirty = true;
+}
+
 void delete_entity(Entity *entity) {
+    if(defer_delete_entity(entity)) {
+        return;
+    }
+
     bool in_deletion_list = false;
     for(Entity *e : *entity->level->to_be_deleted) {
         if(entity == e) {
@@ -51,93 +98,70 @@ void delete_entity_imm(Entity *entity) {
 
     auto level = entity->level;
     entity_pool_remove(&level->entities, entity, entity->entity_type_id);
-    entity_pool_push(&level->entities_unused, entity, entity->entity_type_id);
     entity->in_use = false;
+    level->memory_in_use -= entity->size_of_entity;
+
+    EntitySlab *slab = &level->slabs[entity->entity_type_id];
+    entity->next = slab->first_free;
+    slab->first_free = entity;
+    slab->free_count += 1;
 }
 
 void entity_pool_push(EntityPool *pool, Entity *entity, int32_t entity_type_id) {
-    assert(entity->next == NULL && entity->next_of_type == NULL);
-
     pool->count += 1;
     pool->count_of_type[entity_type_id] += 1;
 
-    if(pool->first == NULL) {
-        entity->next = NULL;
+    entity->next = NULL;
+    entity->prev = pool->last;
+    if(pool->last == NULL) {
         pool->first = entity;
-        pool->last  = entity;
     } else {
         pool->last->next = entity;
-        pool->last = entity;
-        entity->next = NULL;
-    }
-
-    Entity **first_of_type = &pool->first_of_type[entity_type_id];
-    Entity **last_of_type  = &pool->last_of_type [entity_type_id];
-    if(*first_of_type == NULL) {
-        entity->next_of_type = NULL;
-        (*first_of_type) = entity;
-        (*last_of_type)  = entity;
-    } else {
-        (*last_of_type)->next_of_type = entity;
-        (*last_of_type) = entity;
-        entity->next_of_type = NULL;
     }
+    pool->last = entity;
 }
 
 void entity_pool_remove(EntityPool *pool, Entity *entity, int32_t entity_type_id) {
-    assert(entity == pool->last || (entity != pool->last && entity->next != NULL));
-    assert(entity == pool->last_of_type[entity_type_id] || (entity != pool->last_of_type[entity_type_id] && entity->next_of_type != NULL));
+    assert(pool->count > 0 && pool->count_of_type[entity_type_id] > 0);
 
     pool->count -= 1;
     pool->count_of_type[entity_type_id] -= 1;
 
-    Entity *prev = NULL; // Find previous entity in pool
-    for(Entity *e_iter = pool->first; e_iter != entity && e_iter != NULL; e_iter = e_iter->next) {
-        if(e_iter->next == entity) {
-            prev = e_iter;
-            prev->next = entity->next;
-            break;
-        }
+    if(entity->prev != NULL) {
+        entity->prev->next = entity->next;
+    } else {
+        pool->first = entity->next;
     }
 
-    if(pool->first == entity && pool->last == entity) {
-        pool->first = NULL;
-        pool->last  = NULL;
-    } else if(pool->first == entity) {
-        pool->first = entity->next;
-    } else if(pool->last == entity) {
-        pool->last = prev;
+    if(entity->next != NULL) {
+        entity->next->prev = entity->prev;
+    } else {
+        pool->last = entity->prev;
     }
 
     entity->next = NULL;
+    entity->prev = NULL;
+}
 
-    Entity **first_of_type = &pool->first_of_type[entity_type_id];
-    Entity **last_of_type  = &pool->last_of_type [entity_type_id];
-
-    Entity *prev_of_type = NULL;
-    for(Entity *e_iter = *first_of_type; e_iter != entity && e_iter != NULL; e_iter = e_iter->next_of_type) {
-        if(e_iter->next_of_type == entity) {
-            prev_of_type = e_iter;
-            prev_of_type->next_of_type = entity->next_of_type;
-            break;
+Entity *next_entity_of_type(Entity *entity) {
+    EntitySlab *slab = &entity->level->slabs[entity->entity_type_id];
+
+    // Find the block and slot of the entity, then continue from there
+    for(EntitySlabBlock *block = slab->first_block; block != NULL; block = block->next) {
+        uint8_t *slots = block->slots();
+        if((uint8_t *)entity >= slots && (uint8_t *)entity < slots + slab->stride * block->used) {
+            EntitySlabIterator iter = iterate_slabs(slab, 1);
+            iter.block = block;
+            iter.slot  = (int32_t)(((uint8_t *)entity - slots) / slab->stride) + 1;
+            return iter.next();
         }
     }
-
-    if(*first_of_type == entity && *last_of_type == entity) {
-        *first_of_type = NULL;
-        *last_of_type  = NULL;
-    } else if(*first_of_type == entity) {
-        *first_of_type = entity->next_of_type;
-    } else if(*last_of_type == entity) {
-        *last_of_type = prev_of_type;
-    }
-
-    entity->next_of_type = NULL;
+    return NULL;
 }
 
 Entity *get_entity_by_unique_id(struct Level *level, uint32_t unique_id) {
     Entity *found = NULL;
-    for_every_entity(level, e) {
+    for_every_entity_by_type(level, e) {
         if(is_entity_used(e) || e->unique_id != unique_id) {
             continue;
         }
@@ -178,13 +202,13 @@ bool is_colliding(Level *level, vec2i position, Collider *collider, FindCollisio
     };
 
     if(opts.entity_type_id == -1) {
-        for_every_entity(level, check_e) {
+        for_every_entity_by_type(level, check_e) {
             if(do_checks(check_e) == true) {
                 return true;
             }
         }
     } else {
-        for(Entity *check_e = level->entities.first_of_type[opts.entity_type_id]; check_e != NULL; check_e = check_e->next_of_type) {
+        for_entity_type_id(level, opts.entity_type_id, check_e) {
             if(do_checks(check_e) == true) {
                 return true;
             }
@@ -194,6 +218,8 @@ bool is_colliding(Level *level, vec2i position, Collider *collider, FindCollisio
 }
 
 std::vector<Entity *> find_collisions(Level *level, vec2i position, Collider *collider, FindCollisionsOpts opts, vec2i offset) {
+    count_collision_query();
+
     auto do_checks = [&] (Entity *check_e) -> bool {
         if(check_e->deleted || !check_e->in_use || check_e->has_collider == NULL || check_e->unique_id == opts.id_to_ignore || (check_e->entity_flags & opts.entity_flags) != opts.entity_flags) {
             return false;
@@ -203,13 +229,13 @@ std::vector<Entity *> find_collisions(Level *level, vec2i position, Collider *co
 
     auto found = std::vector<Entity *>();
     if(opts.entity_type_id == -1) {
-        for_every_entity(level, check_e) {
+        for_every_entity_by_type(level, check_e) {
             if(do_checks(check_e) == true) {
                 found.push_back(check_e);
             }
         }
     } else {
-        for(Entity *check_e = level->entities.first_of_type[opts.entity_type_id]; check_e != NULL; check_e = check_e->next_of_type) {
+        for_entity_type_id(level, opts.entity_type_id, check_e) {
             if(do_checks(check_e) == true) {
                 found.push_back(check_e);
             }
@@ -253,7 +279,7 @@ neighbouring_tile_doesnt_block(Tile *tile, vec2i offset) {
     Tile *other = tile->tilemap->get_tile(tile->tile_x + offset.x, tile->tile_y + offset.y);
     if(other == NULL) return true;
 
-    if(other->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE) return true;
+    if(other->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE) return true;
 
     return false;
 }
@@ -278,14 +304,14 @@ void _move(int32_t distance, Entity *e, float32_t delta_time, EAxis axis) {
         opts.entity_flags = E_FLAG_IS_GAMEPLAY_ENTITY;
 
         if(!(e->entity_flags & E_FLAG_DOES_NOT_COLLIDE_WITH_TILES)) {
-            for_entity_type(level, Tilemap, tilemap) {
+            for_tilemap_overlapping(level, e->position, e->has_collider, vec * unit, tilemap) {
                 if(tilemap->deleted) continue;
 
                 auto tiles = find_collisions(e->position, e->has_collider, tilemap, vec * unit);
                 for(auto tile : tiles) {
 
                     // Invisible tiles do not stop movement
-                    if(tile->tile_desc.tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE)) {
+                    if(tile->get_desc().tile_flags & TILE_FLAG_BLOCKS_MOVEMENT && !(tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE)) {
                         if(axis == Y_AXIS && unit == +1) {
                             const int32_t diff_r = (tile->get_ti().position.x + TILE_SIZE) - (e->position.x + e->has_collider->offset.x);
                             const int32_t diff_l = (e->position.x + e->has_collider->offset.x + e->has_collider->size.x) - tile->get_ti().position.x;
@@ -383,17 +409,36 @@ void _move(int32_t distance, Entity *e, float32_t delta_time, EAxis axis) {
     }
 }
 
+// Drops the batched result if the speed changed since integrate_moves_of_type, for example in the hit callback of an entity updated before this one
+static
+void drop_stale_integration(MoveData *move_data) {
+    if(move_data->is_integrated && (move_data->speed.x != move_data->integrated_speed.x || move_data->speed.y != move_data->integrated_speed.y)) {
+        move_data->is_integrated = false;
+        move_data->reminder      = move_data->reminder_before_integration;
+    }
+}
+
 void do_move(Entity *entity, MoveData *move_data, float32_t delta_time) {
     assert(entity != NULL && move_data != NULL && entity->has_move_data == move_data);
 
-    float32_t to_move_x = move_data->speed.x * delta_time + move_data->reminder.x;
-    float32_t to_move_y = move_data->speed.y * delta_time + move_data->reminder.y;
+    drop_stale_integration(move_data);
 
-    move_data->reminder.x = to_move_x - (float32_t)((int32_t)to_move_x);
-    move_data->reminder.y = to_move_y - (float32_t)((int32_t)to_move_y);
+    int32_t distance_x;
+    int32_t distance_y;
+    if(move_data->is_integrated) {
+        move_data->is_integrated = false;
+        distance_x = move_data->distance.x;
+        distance_y = move_data->distance.y;
+    } else {
+        float32_t to_move_x = move_data->speed.x * delta_time + move_data->reminder.x;
+        float32_t to_move_y = move_data->speed.y * delta_time + move_data->reminder.y;
 
-    int32_t distance_x = (int32_t)to_move_x;
-    int32_t distance_y = (int32_t)to_move_y;
+        move_data->reminder.x = to_move_x - (float32_t)((int32_t)to_move_x);
+        move_data->reminder.y = to_move_y - (float32_t)((int32_t)to_move_y);
+
+        distance_x = (int32_t)to_move_x;
+        distance_y = (int32_t)to_move_y;
+    }
 
     if(entity->has_collider == NULL) {
         entity->position.x += distance_x;
@@ -406,7 +451,7 @@ void do_move(Entity *entity, MoveData *move_data, float32_t delta_time) {
         // Call hit callback before moving, for tiles and entities
 
         if(!(entity->entity_flags & E_FLAG_DOES_NOT_COLLIDE_WITH_TILES)) {
-            for_entity_type(entity->level, Tilemap, tilemap) {
+            for_tilemap_overlapping(entity->level, entity->position, entity->has_collider, { }, tilemap) {
                 if(tilemap->deleted) continue;
 
                 auto tiles = find_collisions(entity->position, entity->has_collider, tilemap);
@@ -450,7 +495,7 @@ void do_move(Entity *entity, MoveData *move_data, float32_t delta_time) {
         move_data->is_grounded_prev = move_data->is_grounded;
         move_data->is_grounded = false;
         if(move_data->is_grounded == false) {
-            for_entity_type(entity->level, Tilemap, tilemap) {
+            for_tilemap_overlapping(entity->level, entity->position, entity->has_collider, (vec2i{ 0, -1 }), tilemap) {
                 if(is_colliding_with_any_tile(entity->position, entity->has_collider, tilemap, { 0, -1 }, { 0, TILE_FLAG_IS_INVISIBLE })) {
                     move_data->is_grounded = true;
                     break;
@@ -466,4 +511,145 @@ void do_move(Entity *entity, MoveData *move_data, float32_t delta_time) {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+bool prepare_move(Entity *entity, MoveData *move_data, float64_t delta_time) {
+    assert(entity != NULL && move_data != NULL && move_data->prepare_proc != NULL);
+
+    // When the batch is dropped prepare_proc runs a second time, its one shot state like a pending direction change was consumed already so it only sets the speed again
+    drop_stale_integration(move_data);
+    if(move_data->is_integrated) {
+        return true;
+    }
+
+    float32_t gravity = 0.0f;
+    if(!move_data->prepare_proc(entity, &gravity)) {
+        return false;
+    }
+    move_data->speed.y -= gravity * delta_time;
+    return true;
+}
+
+// Walkers are gathered into arrays of this many, so the batch lives on the stack
+#define MOVE_BATCH_SIZE 64
+
+struct MoveBatch {
+    alignas(16) float32_t gravity   [MOVE_BATCH_SIZE];
+    alignas(16) float32_t speed_x   [MOVE_BATCH_SIZE];
+    alignas(16) float32_t speed_y   [MOVE_BATCH_SIZE];
+    alignas(16) float32_t reminder_x[MOVE_BATCH_SIZE];
+    alignas(16) float32_t reminder_y[MOVE_BATCH_SIZE];
+    alignas(16) int32_t   distance_x[MOVE_BATCH_SIZE];
+    alignas(16) int32_t   distance_y[MOVE_BATCH_SIZE];
+    MoveData *move_data[MOVE_BATCH_SIZE];
+    int32_t   count;
+};
+
+static bool is_batched_move_type(int32_t entity_type_id) {
+    switch(entity_type_id) {
+        case entity_type_id(Goomba):
+        case entity_type_id(KoopaShell):
+        case entity_type_id(Mushroom):
+        case entity_type_id(Star):
+        case entity_type_id(Fireball): {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Does the same math as prepare_move and do_move, gravity is applied in double precision like 'speed.y -= gravity * delta_time' does with float64_t delta_time
+static void integrate_move_batch(MoveBatch *batch, float64_t delta_time) {
+    const float32_t delta_time_f = (float32_t)delta_time;
+
+    int32_t idx = 0;
+#if MOVE_BATCH_SSE2
+    const __m128d dt_d = _mm_set1_pd(delta_time);
+    const __m128  dt_f = _mm_set1_ps(delta_time_f);
+    for(; idx + 4 <= batch->count; idx += 4) {
+        const __m128 gravity = _mm_load_ps(batch->gravity + idx);
+        const __m128 speed_y = _mm_load_ps(batch->speed_y + idx);
+
+        const __m128d speed_y_lo = _mm_sub_pd(_mm_cvtps_pd(speed_y), _mm_mul_pd(_mm_cvtps_pd(gravity), dt_d));
+        const __m128d speed_y_hi = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(speed_y, speed_y)), _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(gravity, gravity)), dt_d));
+        const __m128  new_speed_y = _mm_movelh_ps(_mm_cvtpd_ps(speed_y_lo), _mm_cvtpd_ps(speed_y_hi));
+        _mm_store_ps(batch->speed_y + idx, new_speed_y);
+
+        const __m128  to_move_x  = _mm_add_ps(_mm_mul_ps(_mm_load_ps(batch->speed_x + idx), dt_f), _mm_load_ps(batch->reminder_x + idx));
+        const __m128  to_move_y  = _mm_add_ps(_mm_mul_ps(new_speed_y, dt_f), _mm_load_ps(batch->reminder_y + idx));
+        const __m128i distance_x = _mm_cvttps_epi32(to_move_x);
+        const __m128i distance_y = _mm_cvttps_epi32(to_move_y);
+        _mm_store_ps(batch->reminder_x + idx, _mm_sub_ps(to_move_x, _mm_cvtepi32_ps(distance_x)));
+        _mm_store_ps(batch->reminder_y + idx, _mm_sub_ps(to_move_y, _mm_cvtepi32_ps(distance_y)));
+        _mm_store_si128((__m128i *)(batch->distance_x + idx), distance_x);
+        _mm_store_si128((__m128i *)(batch->distance_y + idx), distance_y);
+    }
+#endif
+
+    for(; idx < batch->count; ++idx) {
+        batch->speed_y[idx] -= batch->gravity[idx] * delta_time;
+
+        const float32_t to_move_x = batch->speed_x[idx] * delta_time_f + batch->reminder_x[idx];
+        const float32_t to_move_y = batch->speed_y[idx] * delta_time_f + batch->reminder_y[idx];
+        batch->distance_x[idx] = (int32_t)to_move_x;
+        batch->distance_y[idx] = (int32_t)to_move_y;
+        batch->reminder_x[idx] = to_move_x - (float32_t)batch->distance_x[idx];
+        batch->reminder_y[idx] = to_move_y - (float32_t)batch->distance_y[idx];
+    }
+}
+
+void integrate_moves_of_type(Level *level, int32_t entity_type_id, float64_t delta_time) {
+    if(!is_batched_move_type(entity_type_id) || level->entities.count_of_type[entity_type_id] == 0) {
+        return;
+    }
+    PROFILE_FUNCTION();
+
+    MoveBatch batch;
+    auto iter = iterate_slabs(&level->slabs[entity_type_id], 1);
+    bool reached_end = false;
+    while(!reached_end) {
+
+        // Gather walkers that will be updated
+        batch.count = 0;
+        while(batch.count < MOVE_BATCH_SIZE) {
+            Entity *entity = iter.next();
+            if(entity == NULL) {
+                reached_end = true;
+                break;
+            }
+
+            if(!is_entity_used(entity)) continue;
+
+            MoveData *move_data = entity->has_move_data;
+            if(move_data == NULL) continue;
+
+            move_data->is_integrated = false; // Also clears one left by an update proc that returned before moving
+            if(move_data->prepare_proc == NULL || !can_update_entity(entity)) continue;
+
+            const int32_t idx = batch.count;
+            if(!move_data->prepare_proc(entity, &batch.gravity[idx])) continue;
+
+            batch.move_data [idx] = move_data;
+            batch.speed_x   [idx] = move_data->speed.x;
+            batch.speed_y   [idx] = move_data->speed.y;
+            batch.reminder_x[idx] = move_data->reminder.x;
+            batch.reminder_y[idx] = move_data->reminder.y;
+            batch.count += 1;
+
+            move_data->reminder_before_integration = move_data->reminder;
+        }
+
+        integrate_move_batch(&batch, delta_time);
+
+        for(int32_t idx = 0; idx < batch.count; ++idx) {
+            MoveData *move_data = batch.move_data[idx];
+            move_data->speed.y          = batch.speed_y[idx];
+            move_data->reminder.x       = batch.reminder_x[idx];
+            move_data->reminder.y       = batch.reminder_y[idx];
+            move_data->distance.x       = batch.distance_x[idx];
+            move_data->distance.y       = batch.distance_y[idx];
+            move_data->integrated_speed = move_data->speed;
+            move_data->is_integrated    = true;
+        }
+    }
+}
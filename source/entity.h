@@ -59,8 +59,8 @@ enum : uint16_t {
 };
 
 struct Entity {
-    struct Entity *next;
-    struct Entity *next_of_type;
+    struct Entity *next; // Next entity in use, or next free slot in the slab if not in use
+    struct Entity *prev;
     struct Level  *level;
 
     bool     deleted; // Will be deleted at the end of update_level procedure
@@ -91,11 +91,7 @@ void delete_entity(Entity *entity);     // Sets entity->deleted to true, the ent
 void delete_entity_imm(Entity *entity); // Deletes the entity immediately
 #define set_entity_flag(entity_ptr, flag) { (entity_ptr)->entity_flags |= (flag); }
 
-inline 
-void make_asleep(Entity *entity) {
-    set_entity_flag(entity, E_FLAG_SLEEPS_UNTIL_AWAKEN);
-    entity->is_asleep = true;
-}
+void make_asleep(Entity *entity); // Entity should be at its final position, sleepers don't move
 
 inline
 bool is_entity_used(Entity *entity) {
@@ -103,22 +99,88 @@ bool is_entity_used(Entity *entity) {
     return valid;
 }
 
+inline
+bool can_update_entity(Entity *entity) { // Whether update_level calls the update proc
+    if(entity->update_proc == NULL || !is_entity_used(entity)) return false;
+    if(entity->entity_flags & E_FLAG_SLEEPS_UNTIL_AWAKEN && entity->is_asleep) return false;
+    return true;
+}
+
 Entity *get_entity_by_unique_id(struct Level *level, uint32_t unique_id);
 Entity *get_entity_by_unique_id(struct Level *level, uint32_t unique_id, int32_t entity_type_id);
 #define get_entity_by_unique_id_m(level_ptr, unique_id, Type) (Type *)get_entity_by_unique_id(level_ptr, unique_id, entity_type_id(Type))
 
+// Every entity in use in the order of creation
 struct EntityPool {
     uint32_t       count;
     struct Entity *first;
     struct Entity *last;
     uint32_t       count_of_type[entity_type_count()];
-    struct Entity *first_of_type[entity_type_count()];
-    struct Entity *last_of_type [entity_type_count()];
 };
 
 void entity_pool_push  (EntityPool *pool, Entity *entity, int32_t entity_type_id);
 void entity_pool_remove(EntityPool *pool, Entity *entity, int32_t entity_type_id);
 
+// Entities of one type are stored in blocks of fixed stride slots, so iterating a type is a linear scan
+#define ENTITY_SLAB_MIN_BLOCK_CAPACITY 4
+#define ENTITY_SLAB_MAX_BLOCK_SIZE     KB(16) // Block capacity doubles until the block would exceed this
+
+struct alignas(16) EntitySlabBlock {
+    EntitySlabBlock *next;
+    int32_t          capacity;
+    int32_t          used; // Slots handed out, in use or free
+
+    inline uint8_t *slots(void) { return (uint8_t *)(this + 1); }
+};
+
+struct EntitySlab {
+    size_t           stride;
+    int32_t          free_count;
+    Entity          *first_free; // Deleted entities, linked by Entity::next
+    EntitySlabBlock *first_block;
+    EntitySlabBlock *last_block;
+};
+
+// Walks slots of one or more consecutive slabs
+struct EntitySlabIterator {
+    EntitySlab      *slab;
+    EntitySlab      *slab_end;
+    EntitySlabBlock *block;
+    int32_t          slot;
+
+    inline Entity *next(void) { // Next entity in use, NULL at the end
+        for(;;) {
+            while(block != NULL) {
+                while(slot < block->used) {
+                    Entity *entity = (Entity *)(block->slots() + slab->stride * slot++);
+                    if(entity->in_use) {
+                        return entity;
+                    }
+                }
+                block = block->next;
+                slot  = 0;
+            }
+
+            if(++slab >= slab_end) {
+                slab = slab_end - 1; // Keep returning NULL
+                return NULL;
+            }
+            block = slab->first_block;
+        }
+    }
+};
+
+inline EntitySlabIterator iterate_slabs(EntitySlab *first, int32_t count) {
+    EntitySlabIterator iter;
+    iter.slab     = first;
+    iter.slab_end = first + count;
+    iter.block    = first->first_block;
+    iter.slot     = 0;
+    return iter;
+}
+
+Entity *next_entity_of_type(Entity *entity); // Next in slab order, NULL if it's the last one
+
 struct Collider {
     vec2i size;
     vec2i offset;
@@ -172,15 +234,26 @@ struct CollisionInfo {
 #define HIT_CALLBACK_PROC(name) HitCallbackResult name(Entity *self_base, CollisionInfo collision)
 typedef HIT_CALLBACK_PROC(hit_callback_proc);
 
+// Applies walker's state that has to change before moving and sets the speed, returns false if it doesn't move this frame
+#define MOVE_PREPARE_PROC(name) bool name(Entity *self_base, float32_t *gravity)
+typedef MOVE_PREPARE_PROC(move_prepare_proc);
+
 struct MoveData {
     bool is_grounded;
     bool is_grounded_prev;
+    bool is_integrated; // Speed and reminder were already advanced this frame by integrate_moves_of_type, only distance is left to move
     vec2 reminder;
     vec2 speed;
+    vec2i distance;
+    vec2 integrated_speed;            // Speed the batch left, if it's different when the entity moves the move is done again from the start
+    vec2 reminder_before_integration;
     hit_callback_proc *hit_callback;
+    move_prepare_proc *prepare_proc; // Set for simple walkers, they get integrated in batch before their update procs run
 };
 
 void zero_move_speed(MoveData *move_data);
+bool prepare_move(Entity *entity, MoveData *move_data, float64_t delta_time); // Calls prepare_proc and applies gravity, unless the move was integrated in batch already and the speed hasn't changed since
 void do_move(Entity *entity, MoveData *move_data, float32_t delta_time); // Calls back to entity with hit_callback proc
+void integrate_moves_of_type(struct Level *level, int32_t entity_type_id, float64_t delta_time); // Integrates all awake walkers of the type at once
 
 #endif /* _ENTITY_H */
\ No newline at end of file
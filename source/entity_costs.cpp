@@ -0,0 +1,148 @@
+#include "entity_costs.h"
+#include "level.h"
+#include "renderer.h"
+
+#include <SDL.h>
+#include <atomic>
+#include <algorithm>
+
+namespace {
+    struct EntityTypeCosts {
+        EntityCostSample samples[ENTITY_COST_FRAMES];
+        int32_t count;
+    };
+
+    EntityTypeCosts type_costs[entity_type_count()];
+    int32_t frame_idx = 0;       // Sample slot of the current frame
+    int32_t next_frame_idx = 0;  // Slot of the frame after it
+    int32_t frames_recorded = 0; // Up to ENTITY_COST_FRAMES, slots 0 to frames_recorded - 1 are filled
+
+    std::atomic<uint32_t> collision_queries = 0;
+}
+
+void reset_entity_costs(void) {
+    zero_array(type_costs);
+    frame_idx = 0;
+    frames_recorded = 0;
+    next_frame_idx = 0;
+}
+
+void begin_entity_cost_frame(Level *level) {
+    // The first frame goes into slot 0, so the summary only reads filled slots until the window is full
+    frame_idx = next_frame_idx;
+    next_frame_idx = (next_frame_idx + 1) % ENTITY_COST_FRAMES;
+    frames_recorded = min_value(frames_recorded + 1, ENTITY_COST_FRAMES);
+
+    for(int32_t type_id = 0; type_id < entity_type_count(); ++type_id) {
+        type_costs[type_id].samples[frame_idx] = { };
+        type_costs[type_id].count = (int32_t)level->entities.count_of_type[type_id];
+    }
+}
+
+EntityCostMark mark_entity_cost(Level *level) {
+    EntityCostMark mark;
+    mark.time = SDL_GetPerformanceCounter();
+    mark.quads = render::r_get_quads_pushed();
+    mark.collision_queries = collision_queries.load(std::memory_order_relaxed);
+    mark.updated = level->active_entity_count;
+    return mark;
+}
+
+void add_entity_update_cost(Level *level, int32_t entity_type_id, EntityCostMark since) {
+    EntityCostMark now = mark_entity_cost(level);
+    EntityCostSample *sample = &type_costs[entity_type_id].samples[frame_idx];
+    sample->update_time += (float64_t)(now.time - since.time) / (float64_t)SDL_GetPerformanceFrequency();
+    sample->updated += now.updated - since.updated;
+    sample->quads += (int32_t)(now.quads - since.quads);
+    sample->collision_queries += (int32_t)(now.collision_queries - since.collision_queries);
+}
+
+void add_entity_render_cost(Level *level, int32_t entity_type_id, EntityCostMark since) {
+    EntityCostMark now = mark_entity_cost(level);
+    EntityCostSample *sample = &type_costs[entity_type_id].samples[frame_idx];
+    sample->render_time += (float64_t)(now.time - since.time) / (float64_t)SDL_GetPerformanceFrequency();
+    sample->quads += (int32_t)(now.quads - since.quads);
+    sample->collision_queries += (int32_t)(now.collision_queries - since.collision_queries);
+}
+
+void count_collision_query(void) {
+    collision_queries.fetch_add(1, std::memory_order_relaxed);
+}
+
+static
+float64_t get_sort_value(const EntityTypeCostSummary *summary, EEntityCostSort sort) {
+    switch(sort) {
+        default:
+        case EEntityCostSort::COUNT:             return (float64_t)summary->count;
+        case EEntityCostSort::UPDATE_TIME:       return summary->avg.update_time;
+        case EEntityCostSort::RENDER_TIME:       return summary->avg.render_time;
+        case EEntityCostSort::QUADS:             return (float64_t)summary->avg.quads;
+        case EEntityCostSort::COLLISION_QUERIES: return (float64_t)summary->avg.collision_queries;
+    }
+}
+
+std::vector<EntityTypeCostSummary> summarize_entity_costs(EEntityCostSort sort) {
+    std::vector<EntityTypeCostSummary> summaries;
+    if(frames_recorded == 0) {
+        return summaries;
+    }
+
+    for(int32_t type_id = 0; type_id < entity_type_count(); ++type_id) {
+        EntityTypeCosts *costs = &type_costs[type_id];
+
+        EntityTypeCostSummary summary = { };
+        summary.entity_type_id = type_id;
+        summary.count = costs->count;
+
+        // Sums go into avg until divided
+        for(int32_t idx = 0; idx < frames_recorded; ++idx) {
+            EntityCostSample *sample = &costs->samples[idx];
+            summary.avg.update_time       += sample->update_time;
+            summary.avg.render_time       += sample->render_time;
+            summary.avg.updated           += sample->updated;
+            summary.avg.quads             += sample->quads;
+            summary.avg.collision_queries += sample->collision_queries;
+            summary.max.update_time       = max_value(summary.max.update_time, sample->update_time);
+            summary.max.render_time       = max_value(summary.max.render_time, sample->render_time);
+            summary.max.updated           = max_value(summary.max.updated, sample->updated);
+            summary.max.quads             = max_value(summary.max.quads, sample->quads);
+            summary.max.collision_queries = max_value(summary.max.collision_queries, sample->collision_queries);
+        }
+
+        if(summary.count == 0 && summary.max.updated == 0 && summary.max.quads == 0 && summary.max.collision_queries == 0) {
+            continue;
+        }
+
+        summary.avg.update_time       /= (float64_t)frames_recorded;
+        summary.avg.render_time       /= (float64_t)frames_recorded;
+        summary.avg.updated           /= frames_recorded;
+        summary.avg.quads             /= frames_recorded;
+        summary.avg.collision_queries /= frames_recorded;
+        summaries.push_back(summary);
+    }
+
+    std::stable_sort(summaries.begin(), summaries.end(), [sort] (const EntityTypeCostSummary &a, const EntityTypeCostSummary &b) {
+        return get_sort_value(&a, sort) > get_sort_value(&b, sort);
+    });
+    return summaries;
+}
+
+std::string format_entity_costs(EEntityCostSort sort, int32_t max_rows) {
+    std::vector<EntityTypeCostSummary> summaries = summarize_entity_costs(sort);
+
+    char buffer[256];
+    sprintf_s(buffer, array_count(buffer), "%-16s %5s %7s %15s %15s %11s %11s\n", "type", "count", "updated", "update ms", "render ms", "quads", "queries");
+    std::string table = buffer;
+
+    for(int32_t idx = 0; idx < (int32_t)summaries.size() && idx < max_rows; ++idx) {
+        EntityTypeCostSummary *summary = &summaries[idx];
+        sprintf_s(buffer, array_count(buffer), "%-16s %5d %7d %7.3f/%7.3f %7.3f/%7.3f %5d/%5d %5d/%5d\n",
+                  entity_type_string[summary->entity_type_id], summary->count, summary->avg.updated,
+                  summary->avg.update_time * 1000.0, summary->max.update_time * 1000.0,
+                  summary->avg.render_time * 1000.0, summary->max.render_time * 1000.0,
+                  summary->avg.quads, summary->max.quads,
+                  summary->avg.collision_queries, summary->max.collision_queries);
+        table += buffer;
+    }
+    return table;
+}
@@ -0,0 +1,64 @@
+#ifndef _ENTITY_COSTS_H
+#define _ENTITY_COSTS_H
+
+#include "common.h"
+#include "entity.h"
+
+// What every entity type costs in update_level and render_level over the last frames, to find the type that makes a level slow.
+// Times are wall time of the type's loop, parallel updates included. One level is accounted for at a time.
+
+#define ENTITY_COST_FRAMES 120 // Window of the averages and maxima
+
+struct EntityCostSample {
+    float64_t update_time;
+    float64_t render_time;
+    int32_t   updated;           // Got their update proc called
+    int32_t   quads;             // Pushed to the renderer, text quads included
+    int32_t   collision_queries; // Entity and tile collision searches
+};
+
+struct EntityTypeCostSummary {
+    int32_t entity_type_id;
+    int32_t count; // In use at the last update
+    EntityCostSample avg;
+    EntityCostSample max;
+};
+
+enum class EEntityCostSort : int32_t {
+    COUNT,
+    UPDATE_TIME,
+    RENDER_TIME,
+    QUADS,
+    COLLISION_QUERIES,
+    __COUNT
+};
+
+inline const char *entity_cost_sort_string[] = {
+    "count",
+    "update time",
+    "render time",
+    "quads",
+    "collision queries"
+};
+
+static_assert(array_count(entity_cost_sort_string) == (int32_t)EEntityCostSort::__COUNT);
+
+// Counters at some point, the cost of a type is the difference to the end of its loop
+struct EntityCostMark {
+    uint64_t time;
+    uint64_t quads;
+    uint32_t collision_queries;
+    int32_t  updated;
+};
+
+void reset_entity_costs(void);
+void begin_entity_cost_frame(struct Level *level); // Start of update_level
+EntityCostMark mark_entity_cost(struct Level *level);
+void add_entity_update_cost(struct Level *level, int32_t entity_type_id, EntityCostMark since);
+void add_entity_render_cost(struct Level *level, int32_t entity_type_id, EntityCostMark since);
+void count_collision_query(void); // Can be called from the job threads
+
+std::vector<EntityTypeCostSummary> summarize_entity_costs(EEntityCostSort sort); // Types that cost anything, the biggest first
+std::string format_entity_costs(EEntityCostSort sort, int32_t max_rows = INT32_MAX); // Summary as a table with a header line
+
+#endif /* _ENTITY_COSTS_H */
@@ -0,0 +1,166 @@
+#include "frame_timings.h"
+#include "renderer.h"
+#include "data.h"
+#include "profiler.h"
+
+#include <SDL.h>
+#include <algorithm>
+
+namespace {
+    float32_t stage_times[FRAME_STAGE__COUNT][FRAME_TIMING_FRAMES]; // Seconds
+    uint64_t  stage_begin[FRAME_STAGE__COUNT];
+    float64_t stage_time [FRAME_STAGE__COUNT]; // Current frame
+    int32_t   next_idx    = 0;
+    int32_t   frame_count = 0; // Up to FRAME_TIMING_FRAMES
+    uint64_t  frames_total = 0;
+
+    uint64_t  frame_flush_ticks = 0; // Renderer's counter at the beginning of the frame
+
+    float64_t  hitch_threshold = 1.0 / 30.0; // Two frames at the target rate
+    int32_t    hitch_count = 0;
+    FrameHitch last_hitch;
+}
+
+void set_frame_hitch_threshold(float64_t seconds) {
+    hitch_threshold = seconds;
+}
+
+float64_t get_frame_hitch_threshold(void) {
+    return hitch_threshold;
+}
+
+static inline
+float64_t seconds_since(uint64_t ticks) {
+    return (float64_t)(SDL_GetPerformanceCounter() - ticks) / (float64_t)SDL_GetPerformanceFrequency();
+}
+
+void begin_frame_timings(void) {
+    zero_array(stage_time);
+    frame_flush_ticks = render::r_get_flush_ticks();
+    begin_frame_stage(FRAME_STAGE_TOTAL);
+}
+
+void begin_frame_stage(EFrameStage stage) {
+    stage_begin[stage] = SDL_GetPerformanceCounter();
+}
+
+void end_frame_stage(EFrameStage stage) {
+    stage_time[stage] += seconds_since(stage_begin[stage]);
+}
+
+static
+void record_hitch(float64_t total_time) {
+    hitch_count += 1;
+    zero_struct(&last_hitch);
+    last_hitch.frame = frames_total;
+    last_hitch.total_time = total_time;
+
+    // Longest zones of the frame, these are what was running when it went long
+    const ProfilerFrame *frame = get_profiler_last_frame();
+    for(auto &zone : frame->zones) {
+        const float64_t time = profiler_ticks_to_ms(zone.end - zone.begin) / 1000.0;
+        int32_t slot = last_hitch.zone_count;
+        if(slot == FRAME_HITCH_MAX_ZONES) {
+            if(time <= last_hitch.zone_times[slot - 1]) {
+                continue;
+            }
+            slot -= 1; // Replaces the shortest
+        }
+
+        while(slot > 0 && last_hitch.zone_times[slot - 1] < time) {
+            last_hitch.zone_names[slot] = last_hitch.zone_names[slot - 1];
+            last_hitch.zone_times[slot] = last_hitch.zone_times[slot - 1];
+            slot -= 1;
+        }
+        last_hitch.zone_names[slot] = zone.name;
+        last_hitch.zone_times[slot] = time;
+        last_hitch.zone_count = min_value(last_hitch.zone_count + 1, FRAME_HITCH_MAX_ZONES);
+    }
+}
+
+void end_frame_timings(void) {
+    end_frame_stage(FRAME_STAGE_TOTAL);
+
+    // Flushes happen while rendering, split them out of it
+    const float64_t flush_time = (float64_t)(render::r_get_flush_ticks() - frame_flush_ticks) / (float64_t)SDL_GetPerformanceFrequency();
+    stage_time[FRAME_STAGE_GPU_SUBMIT] = flush_time;
+    stage_time[FRAME_STAGE_RENDER_RECORD] = max_value(stage_time[FRAME_STAGE_RENDER_RECORD] - flush_time, 0.0);
+
+    for(int32_t stage = 0; stage < FRAME_STAGE__COUNT; ++stage) {
+        stage_times[stage][next_idx] = (float32_t)stage_time[stage];
+    }
+    next_idx = (next_idx + 1) % FRAME_TIMING_FRAMES;
+    frame_count = min_value(frame_count + 1, FRAME_TIMING_FRAMES);
+    frames_total += 1;
+
+    if(stage_time[FRAME_STAGE_TOTAL] > hitch_threshold) {
+        record_hitch(stage_time[FRAME_STAGE_TOTAL]);
+    }
+}
+
+int32_t get_frame_timing_count(void) {
+    return frame_count;
+}
+
+float64_t get_frame_stage_time(EFrameStage stage, int32_t frames_ago) {
+    if(frames_ago < 0 || frames_ago >= frame_count) {
+        return 0.0;
+    }
+    return stage_times[stage][(next_idx - 1 - frames_ago + FRAME_TIMING_FRAMES) % FRAME_TIMING_FRAMES];
+}
+
+FrameStageStats get_frame_stage_stats(EFrameStage stage) {
+    FrameStageStats stats = { };
+    if(frame_count == 0) {
+        return stats;
+    }
+
+    static float32_t sorted[FRAME_TIMING_FRAMES];
+    memcpy(sorted, stage_times[stage], frame_count * sizeof(float32_t)); // Order doesn't matter, the ring is filled from the start
+    std::sort(sorted, sorted + frame_count);
+
+    auto percentile = [&] (float64_t perc) -> float64_t {
+        return sorted[min_value((int32_t)(perc * (float64_t)frame_count), frame_count - 1)];
+    };
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = sorted[frame_count - 1];
+    return stats;
+}
+
+int32_t get_frame_hitch_count(void) {
+    return hitch_count;
+}
+
+const FrameHitch *get_last_frame_hitch(void) {
+    return hitch_count > 0 ? &last_hitch : NULL;
+}
+
+bool export_frame_timings_csv(const char *filepath) {
+    std::string csv = "frame";
+    for(int32_t stage = 0; stage < FRAME_STAGE__COUNT; ++stage) {
+        csv += ",";
+        csv += frame_stage_string[stage];
+        csv += " ms";
+    }
+    csv += ",hitch\n";
+
+    char buffer[64];
+    for(int32_t frames_ago = frame_count - 1; frames_ago >= 0; --frames_ago) {
+        sprintf_s(buffer, array_count(buffer), "%llu", (unsigned long long)(frames_total - 1 - frames_ago));
+        csv += buffer;
+        for(int32_t stage = 0; stage < FRAME_STAGE__COUNT; ++stage) {
+            sprintf_s(buffer, array_count(buffer), ",%.4f", get_frame_stage_time((EFrameStage)stage, frames_ago) * 1000.0);
+            csv += buffer;
+        }
+        csv += get_frame_stage_time(FRAME_STAGE_TOTAL, frames_ago) > hitch_threshold ? ",1\n" : ",0\n";
+    }
+
+    if(!save_file(filepath, (char *)csv.c_str(), csv.size())) {
+        printf("Failed to write frame timings to \"%s\".\n", filepath);
+        return false;
+    }
+    printf("Frame timings of %d frames written to \"%s\".\n", frame_count, filepath);
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef _FRAME_TIMINGS_H
+#define _FRAME_TIMINGS_H
+
+#include "common.h"
+
+// Stage times of the last frames in a ring buffer, with percentiles and hitches for the debug panel.
+// Stages are timed by the main loop, the GPU submit part of rendering comes from the time the renderer spent flushing.
+
+#define FRAME_TIMING_FRAMES   4096
+#define FRAME_HITCH_MAX_ZONES 6 // Longest profiler zones kept with a hitch
+
+enum EFrameStage : int32_t {
+    FRAME_STAGE_SIMULATION,
+    FRAME_STAGE_RENDER_RECORD, // Rendering minus the flushes
+    FRAME_STAGE_GPU_SUBMIT,    // Flushes
+    FRAME_STAGE_SWAP,
+    FRAME_STAGE_TOTAL,
+    FRAME_STAGE__COUNT
+};
+
+inline const char *frame_stage_string[] = {
+    "simulation",
+    "render record",
+    "gpu submit",
+    "swap",
+    "total"
+};
+
+static_assert(array_count(frame_stage_string) == FRAME_STAGE__COUNT);
+
+struct FrameStageStats {
+    float64_t p50;
+    float64_t p95;
+    float64_t p99;
+    float64_t max;
+};
+
+struct FrameHitch {
+    uint64_t  frame;
+    float64_t total_time;
+    int32_t   zone_count;
+    const char *zone_names[FRAME_HITCH_MAX_ZONES]; // Longest first, empty without the profiler
+    float64_t   zone_times[FRAME_HITCH_MAX_ZONES];
+};
+
+void set_frame_hitch_threshold(float64_t seconds);
+float64_t get_frame_hitch_threshold(void);
+
+void begin_frame_timings(void);
+void begin_frame_stage(EFrameStage stage);
+void end_frame_stage(EFrameStage stage);
+void end_frame_timings(void); // After profiler_end_frame, hitches take the zones from its last frame
+
+int32_t get_frame_timing_count(void);
+float64_t get_frame_stage_time(EFrameStage stage, int32_t frames_ago); // 0 is the last frame
+FrameStageStats get_frame_stage_stats(EFrameStage stage);
+int32_t get_frame_hitch_count(void); // Since start
+const FrameHitch *get_last_frame_hitch(void); // NULL if there wasn't one
+
+bool export_frame_timings_csv(const char *filepath); // Oldest frame first
+
+#endif /* _FRAME_TIMINGS_H */
@@ -6,67 +6,156 @@
 #include "data.h"
 #include "level_transition.h"
 #include "main_menu.h"
+#include "level_loader.h"
+#include "level_stream.h"
+#include "level_effects.h"
+#include "parallel_update.h"
+#include "profiler.h"
+#include "frame_timings.h"
+#include "memory_tags.h"
+#include "input_session.h"
 
 static
-void reload_all_levels(Game *game) {
-    reset_session(game);
+std::string get_level_file_name(int32_t world_idx, int32_t level_idx) {
+    char level_name[64];
+    sprintf_s(level_name, array_count(level_name), "%d_%d.level", world_idx + 1, level_idx + 1);
+    return level_name;
+}
+
+static
+std::string get_level_path(int32_t world_idx, int32_t level_idx) {
+    return global_data::get_data_path() + "//levels//" + get_level_file_name(world_idx, level_idx);
+}
+
+static
+std::string get_custom_level_path(void) {
+    return global_data::get_data_path() + "//levels//custom.level";
+}
+
+static
+bool custom_level_file_exists(void) {
+    FILE *file = NULL;
+    if(fopen_s(&file, get_custom_level_path().c_str(), "rb") != 0) {
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+static
+void step_level_idx(int32_t *world_idx, int32_t *level_idx, int32_t delta) {
+    *level_idx += delta;
+    if(*level_idx >= LEVEL_NUM) {
+        *level_idx = 0;
+        *world_idx += 1;
+        if(*world_idx >= WORLD_NUM) {
+            *world_idx = 0;
+        }
+    } else if(*level_idx < 0) {
+        *level_idx = LEVEL_NUM - 1;
+        *world_idx -= 1;
+        if(*world_idx < 0) {
+            *world_idx = WORLD_NUM - 1;
+        }
+    }
+}
+
+// Without going through the main menu only the current and the next level can be reached, and the starting level from the menu
+static
+void evict_unreachable_levels(Game *game) {
+    int32_t next_world_idx = game->world_idx;
+    int32_t next_level_idx = game->level_idx;
+    step_level_idx(&next_world_idx, &next_level_idx, +1);
 
     for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
         for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
-            char level_name[64];
-            sprintf_s(level_name, array_count(level_name), "%d_%d.level", world_idx + 1, level_idx + 1);
-            std::string level_path = global_data::get_data_path() + "//levels//" + level_name;
-
-            Level **level = &game->levels[world_idx][level_idx];
-            LevelSaveData *save_data = &game->level_save_datas[world_idx][level_idx];
-            
-            recreate_empty_level(level);
-            load_level(*level, level_path.c_str(), save_data);
+            const bool is_current = world_idx == game->world_idx       && level_idx == game->level_idx;
+            const bool is_next    = world_idx == next_world_idx        && level_idx == next_level_idx;
+            const bool is_start   = world_idx == game->start_world_idx && level_idx == game->start_level_idx;
+
+            if(!is_current && game->levels[world_idx][level_idx] != NULL) {
+                delete_level(game->levels[world_idx][level_idx]);
+                game->levels[world_idx][level_idx] = NULL;
+            }
+
+            if(!is_current && !is_next && !is_start) {
+                evict_level(game->level_loader, get_level_path(world_idx, level_idx));
+            }
         }
     }
 
-    recreate_empty_level(&game->custom_level);
-    load_level(game->custom_level, (global_data::get_data_path() + "//levels//custom.level").c_str(), &game->custom_level_save_data);
+    prefetch_level(game->level_loader, get_level_path(next_world_idx, next_level_idx));
+    prefetch_level(game->level_loader, get_level_path(game->start_world_idx, game->start_level_idx));
 }
 
+// Drops every loaded level, they get loaded from the files again when needed
 static
-void reset_all_levels(Game *game) {
+void reload_all_levels(Game *game) {
     reset_session(game);
 
     for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
         for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
-            recreate_empty_level(&game->levels[world_idx][level_idx]);
-            load_level_from_save_data(game->levels[world_idx][level_idx], &game->level_save_datas[world_idx][level_idx]);
+            evict_level(game->level_loader, get_level_path(world_idx, level_idx));
         }
     }
+    evict_level(game->level_loader, get_custom_level_path());
 
-    recreate_empty_level(&game->custom_level);
-    load_level_from_save_data(game->custom_level, &game->custom_level_save_data);
+    game->custom_level_file_exists = custom_level_file_exists();
+    prefetch_level(game->level_loader, get_custom_level_path());
+    evict_unreachable_levels(game);
 }
 
-Game *create_game(void) {
-    auto game = malloc_and_zero_struct(Game);
+// Restarts the level by cloning the pristine one, memory of the previous current level is reused
+static
+void set_level(Game *game, int32_t world_idx, int32_t level_idx) {
+    assert(world_idx >= 0 && world_idx < WORLD_NUM && level_idx >= 0 && level_idx < LEVEL_NUM, "Invalid level.");
 
-    game->should_quit_game = false;
+    Level *level = game->levels[game->world_idx][game->level_idx];
+    game->levels[game->world_idx][game->level_idx] = NULL;
 
-    /* Create levels */ {
-        game->custom_level = create_empty_level();
+    game->world_idx = world_idx;
+    game->level_idx = level_idx;
 
-        for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
-            for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
-                game->levels[world_idx][level_idx] = create_empty_level();
-            }
-        }
+    recreate_level_from_clone(&level, get_loaded_level(game->level_loader, get_level_path(world_idx, level_idx)));
+    game->levels[world_idx][level_idx] = level;
 
-        reload_all_levels(game);
+    evict_unreachable_levels(game);
+}
 
-        game->world_idx = 0;
-        game->level_idx = 0;
+static
+void restart_custom_level(Game *game) {
+    recreate_level_from_clone(&game->custom_level, get_loaded_level(game->level_loader, get_custom_level_path()));
+}
+
+// The file decides, a custom level that finished loading also has to have something in it
+bool is_custom_level_available(const Game *game) {
+    if(!game->custom_level_file_exists) {
+        return false;
     }
 
+    const Level *custom_level = try_get_loaded_level(game->level_loader, get_custom_level_path());
+    return custom_level == NULL || custom_level->entities.count > 0;
+}
+
+Game *create_game(void) {
+    auto game = malloc_and_zero_struct(Game);
+
+    game->should_quit_game = false;
+
     game->start_world_idx = 0;
     game->start_level_idx = 0;
 
+    /* Start loading levels */ {
+        game->level_loader = create_level_loader();
+        game->world_idx = 0;
+        game->level_idx = 0;
+
+        prefetch_level(game->level_loader, get_level_path(game->start_world_idx, game->start_level_idx));
+
+        game->custom_level_file_exists = custom_level_file_exists();
+        prefetch_level(game->level_loader, get_custom_level_path());
+    }
+
     game->game_mode = EGameMode::MAIN_MENU;
     game->next_game_mode = game->game_mode;
     prepare_main_menu();
@@ -145,31 +234,14 @@ Game *create_game(void) {
     return game;
 }
 
-static
-void set_level(Game *game, int32_t world_idx, int32_t level_idx) {
-    assert(world_idx >= 0 && world_idx < WORLD_NUM && level_idx >= 0 && level_idx < LEVEL_NUM, "Invalid level.");
-    game->world_idx = world_idx;
-    game->level_idx = level_idx;
-}
-
 static 
 Level *advance_level(Game *game, int32_t delta) {
     assert(delta == -1 || delta == 1);
 
-    game->level_idx += delta;
-    if(game->level_idx >= LEVEL_NUM) {
-        game->level_idx = 0;
-        game->world_idx += 1;
-        if(game->world_idx >= WORLD_NUM) {
-            game->world_idx = 0;
-        }
-    } else if(game->level_idx < 0) {
-        game->level_idx = LEVEL_NUM - 1;
-        game->world_idx -= 1;
-        if(game->world_idx < 0) {
-            game->world_idx = WORLD_NUM - 1;
-        }
-    }
+    int32_t world_idx = game->world_idx;
+    int32_t level_idx = game->level_idx;
+    step_level_idx(&world_idx, &level_idx, delta);
+    set_level(game, world_idx, level_idx);
 
     return game->levels[game->world_idx][game->level_idx];
 }
@@ -219,18 +291,22 @@ void delete_game(Game *game) {
     // Delete levels
     delete_level(game->custom_level);
     for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
-        for(int32_t level_idx = 0; level_idx < WORLD_NUM; ++level_idx) {
-            Level *level = game->levels[world_idx][level_idx];
-            delete_level(level);
+        for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
+            delete_level(game->levels[world_idx][level_idx]);
         }
     }
+    delete_level_loader(game->level_loader);
 
+    delete game->input_recording;
     delete_font(game->gp_info_font);
     free(game);
 }
 
 static void _update_debug_game_stuff(Game *game, Input *input, bool *do_update_game);
+static void _update_profiler_keys(Game *game, Input *input);
 static void _render_debug_panel(Game *game, Level *level, RenderStats game_render_stats);
+static void _render_debug_flame_view(Game *game);
+static void _render_debug_frame_graph(Game *game);
 static void _update_debug_render_view(Game *game, Input *input);
 
 static void go_back_to_main_menu(Game *game) {
@@ -241,6 +317,8 @@ static void go_back_to_main_menu(Game *game) {
 }
 
 void update_game(Game *game, Input *input, float64_t delta_time) {
+    PROFILE_FUNCTION();
+
     game->delta_time = delta_time;
     game->elapsed_time += game->delta_time;
     game->elapsed_frames += 1;
@@ -248,6 +326,8 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
     game->game_mode = game->next_game_mode;
     game->next_game_mode = game->game_mode;
 
+    _update_profiler_keys(game, input);
+
 #if defined(_DEBUG_MODE)
     bool do_update_game = true;
     _update_debug_game_stuff(game, input, &do_update_game);
@@ -277,6 +357,10 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
 
             _update_debug_render_view(game, input);
 
+            if(game->input_recording != NULL) {
+                record_input_session_frame(game->input_recording, s_input, game->delta_time);
+            }
+
             auto level = get_current_level(game);
             update_level(level, s_input, game, game->delta_time);
 
@@ -292,11 +376,15 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
                     go_back_to_main_menu(game);
                     break;
                 } else {
+                    // The finished level's memory is reused for the next one
                     Player *player = get_player(level);
+                    const bool has_player = player != NULL;
+                    const EPlayerMode player_mode = has_player ? player->mode : PLAYER_IS_SMALL;
+
                     Level  *next   = advance_level(game, 1);
                     Player *player_in_next_level = get_player(next);
-                    if(player_in_next_level != NULL && player != NULL) {
-                        set_player_mode(player_in_next_level, player->mode);
+                    if(player_in_next_level != NULL && has_player) {
+                        set_player_mode(player_in_next_level, player_mode);
                     }
 
                     setup_level_transition(game->world_idx + 1, game->level_idx + 1);
@@ -321,7 +409,6 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
             switch(option) {
                 case EMenuOption::START_1_PLAYER: {
                     reset_session(game);
-                    reset_all_levels(game);
 
                     game->use_custom_level = false;
                     set_level(game, game->start_world_idx, game->start_level_idx);
@@ -330,10 +417,12 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
                 } break;
 
                 case EMenuOption::START_CUSTOM_LEVEL: {
-                    if(game->custom_level == NULL || game->custom_level->entities.count == 0) break;
+                    if(!is_custom_level_available(game)) break;
+
+                    restart_custom_level(game); // Waits for it if it's still loading
+                    if(game->custom_level->entities.count == 0) break;
 
                     reset_session(game);
-                    reset_all_levels(game);
 
                     game->use_custom_level= true;
                     setup_level_transition(0, 0);
@@ -381,6 +470,7 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
                     if(game->start_world_idx >= WORLD_NUM) {
                         game->start_world_idx = 0;
                     }
+                    evict_unreachable_levels(game);
                 } break;
 
                 case EMenuOption::CHANGE_STARTING_LEVEL: {
@@ -388,6 +478,7 @@ void update_game(Game *game, Input *input, float64_t delta_time) {
                     if(game->start_level_idx >= LEVEL_NUM) {
                         game->start_level_idx = 0;
                     }
+                    evict_unreachable_levels(game);
                 } break;
 
                 case EMenuOption::RELOAD_LEVELS: {
@@ -403,6 +494,22 @@ void reset_session(Game *game) {
     game->points = 0;
 }
 
+void reset_session_for_level(Game *game, const std::string &level_file_name) {
+    reset_session(game);
+    game->use_custom_level = level_file_name == "custom.level";
+    game->world_idx = 0;
+    game->level_idx = 0;
+
+    for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
+        for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
+            if(get_level_file_name(world_idx, level_idx) == level_file_name) {
+                game->world_idx = world_idx;
+                game->level_idx = level_idx;
+            }
+        }
+    }
+}
+
 #include "data.h"
 
 void render_gameplay_info(Game *game) {
@@ -483,6 +590,8 @@ void render_gameplay_info(Game *game) {
 }
 
 void render_game(Game *game) {
+    PROFILE_FUNCTION();
+
     auto level = get_current_level(game);
     
     render::r_reset_stats();
@@ -493,7 +602,7 @@ void render_game(Game *game) {
     game->debug_framebuffer->bind();
     gl_clear({ 0.0f, 0.0f, 0.0f, 0.0f }, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    auto view = game->use_debug_render_view ? &game->debug_render_view : &level->render_view;
+    auto view = (game->use_debug_render_view || level == NULL) ? &game->debug_render_view : &level->render_view;
 
     // Don't render frame when changing game modes
     if(game->game_mode == game->next_game_mode) {
@@ -505,9 +614,11 @@ void render_game(Game *game) {
                 setup.viewport = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
                 setup.framebuffer = game->framebuffer;
 
+                render::r_gpu_timer_begin("level");
                 render::r_begin(setup);
                 render_level(level);
                 render::r_end();
+                render::r_gpu_timer_end();
 
 #if defined(_DEBUG_MODE)
                 // Render debug stuff
@@ -518,9 +629,11 @@ void render_game(Game *game) {
                     dsetup.viewport = { 0, 0, game->debug_framebuffer->width, game->debug_framebuffer->height };
                     dsetup.framebuffer = game->debug_framebuffer;
 
+                    render::r_gpu_timer_begin("level debug");
                     render::r_begin(dsetup);
                     render_level_debug_stuff(level);
                     render::r_end();
+                    render::r_gpu_timer_end();
                 }
 #endif /* defined(_DEBUG_MODE) */
             } break;
@@ -532,13 +645,17 @@ void render_game(Game *game) {
                 setup.viewport = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
                 setup.framebuffer = game->framebuffer;
 
+                render::r_gpu_timer_begin("transition");
                 render::r_begin(setup);
                 render_level_transition(GAME_WIDTH, GAME_HEIGHT);
                 render::r_end();
+                render::r_gpu_timer_end();
             } break;
 
             case EGameMode::MAIN_MENU: {
+                render::r_gpu_timer_begin("main menu");
                 render_main_menu(game->framebuffer, game);
+                render::r_gpu_timer_end();
             } break;
         }
     }
@@ -551,9 +668,11 @@ void render_game(Game *game) {
         gp_info_setup.view_m = mat4x4::identity();
         gp_info_setup.viewport = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
         gp_info_setup.framebuffer = game->framebuffer;
+        render::r_gpu_timer_begin("gameplay info");
         render::r_begin(gp_info_setup);
         render_gameplay_info(game);
         render::r_end();
+        render::r_gpu_timer_end();
     }
 
     auto game_render_stats = render::r_reset_stats();
@@ -563,10 +682,12 @@ void render_game(Game *game) {
     bsetup.view_m = mat4x4::identity();
     bsetup.framebuffer = NULL;
     bsetup.viewport = { 0, 0, game->window_w, game->window_h };
+    render::r_gpu_timer_begin("window blit");
     render::r_begin(bsetup);
     render::r_texture(game->draw_rect.xy, 6, game->draw_rect.wh, game->framebuffer->color);
     _render_debug_panel(game, level, game_render_stats);
     render::r_end();
+    render::r_gpu_timer_end();
     render::r_reset_stats();
 }
 
@@ -618,6 +739,11 @@ static void _render_debug_panel(Game *game, Level *level, RenderStats game_rende
         text_l("elapsed frames: %d", game->elapsed_frames);
         text_l("1 / delta time: %d", (int32_t)round(1.0 / game->delta_time));
         text_l("game mode: %s", game_mode_cstr[(int32_t)game->game_mode]);
+        if(game->input_recording != NULL) {
+            text_l("recording input: %d frames of %s (Home saves)", (int32_t)game->input_recording->frames.size(), game->input_recording->level_name.c_str());
+        } else {
+            text_l("input recording: off (Home)");
+        }
         text_l(" ---");
         text_l("game size:   %d %d", GAME_WIDTH, GAME_HEIGHT);
         text_l("render size: %d %d", game->draw_rect.w, game->draw_rect.h);
@@ -629,47 +755,152 @@ static void _render_debug_panel(Game *game, Level *level, RenderStats game_rende
         text_l("lines drawn: %d", game_render_stats.lines);
         text_l("text quads:  %d", game_render_stats.text_quads);
         text_l(" ---");
+        /* Frame timings */ {
+            text_l("frame times of %d frames, p50/p95/p99/max ms (F10 csv)", get_frame_timing_count());
+            for(int32_t stage = 0; stage < FRAME_STAGE__COUNT; ++stage) {
+                FrameStageStats stats = get_frame_stage_stats((EFrameStage)stage);
+                text_l("  %-14s %6.2f %6.2f %6.2f %6.2f", frame_stage_string[stage], stats.p50 * 1000.0, stats.p95 * 1000.0, stats.p99 * 1000.0, stats.max * 1000.0);
+            }
+
+            text_l("hitches over %.1fms: %d", get_frame_hitch_threshold() * 1000.0, get_frame_hitch_count());
+            const FrameHitch *hitch = get_last_frame_hitch();
+            if(hitch != NULL) {
+                text_l("  last at frame %llu, %.2fms", (unsigned long long)hitch->frame, hitch->total_time * 1000.0);
+                for(int32_t idx = 0; idx < hitch->zone_count; ++idx) {
+                    text_l("    %-24s %.2fms", hitch->zone_names[idx], hitch->zone_times[idx] * 1000.0);
+                }
+            }
+        }
+        /* GPU timers */ {
+            if(render::r_gpu_timers_available()) {
+                int32_t timing_count;
+                const GpuTiming *timings = render::r_get_gpu_timings(&timing_count);
+                text_l("render passes, cpu/gpu ms (%d frames behind)", GPU_TIMER_FRAMES_BEHIND);
+                for(int32_t idx = 0; idx < timing_count; ++idx) {
+                    text_l("  %-14s %6.2f %6.2f", timings[idx].label, timings[idx].cpu_time * 1000.0, timings[idx].gpu_time * 1000.0);
+                }
+            } else {
+                text_l("gpu timers not available");
+            }
+        }
+        text_l(" ---");
+        text_l("parallel update: %s, %d workers", BOOL_STRING(is_parallel_update_enabled()), get_parallel_update_worker_count());
+        text_l(" ---");
+#if defined(ENABLE_PROFILER)
+        /* Profiler */ {
+            const ProfilerFrame *frame = get_profiler_last_frame();
+            text_l("profiler: %d zones, %d dropped, %d threads", (int32_t)frame->zones.size(), frame->dropped, frame->thread_count);
+            text_l("F7 flame view, F8 capture%s", is_profiler_capturing() ? " (capturing)" : "");
+        }
+        text_l(" ---");
+#endif
         text_l("music is playing: %s", BOOL_STRING(audio_player::a_is_music_playing()));
         text_l("music is paused:  %s", BOOL_STRING(audio_player::a_is_music_paused()));
+        /* Audio queue */ {
+            AudioQueueStats stats = audio_player::a_get_queue_stats();
+            text_l("audio requests: %d, %d deduplicated, %d voices stolen, %d dropped", stats.requests, stats.deduplicated, stats.stolen, stats.dropped);
+            text_l("music tracks decoded: %d, %d underruns", stats.resident_music, stats.music_underruns);
+        }
         text_l(" ---");
-        // text_l("level memory ptr: %p", level->memory);
-        text_l("is paused: %s", BOOL_STRING(level->pause_state));
-        auto __level_state_str = [] (Level *level) -> std::string {
-            switch(level->level_state) {
-                default: return "!Unknown!";
-                case ELevelState::PLAYING: return "Playing";
-                case ELevelState::FINISHING_LEVEL: return "Finishing";
-                case ELevelState::FINISHED: return "Finished";
+        /* Resident levels */ {
+            LevelLoaderStats loader_stats = get_level_loader_stats(game->level_loader);
+            size_t instantiated_reserved = 0;
+            size_t instantiated_used     = 0;
+            auto add_instantiated = [&] (Level *instantiated) {
+                if(instantiated != NULL) {
+                    instantiated_reserved += instantiated->memory_size;
+                    instantiated_used     += instantiated->memory_used;
+                }
+            };
+            for(int32_t world_idx = 0; world_idx < WORLD_NUM; ++world_idx) {
+                for(int32_t level_idx = 0; level_idx < LEVEL_NUM; ++level_idx) {
+                    add_instantiated(game->levels[world_idx][level_idx]);
+                }
             }
-        };
-        text_l("level state: %s", __level_state_str(level).c_str());
-        text_l("level time:  %.4f", level->elapsed_time);
-        for(int32_t idx = 0; idx < level->no_paused_entities_count; ++idx) {
-            if(idx >= 4) {
-                text_l("... (%d more)", level->no_paused_entities_count - idx);
-                break;
+            add_instantiated(game->custom_level);
+
+            text_l("pristine levels: %d loaded, %d pending", loader_stats.levels_loaded, loader_stats.levels_pending);
+            text_l("last level load: %.2fms", loader_stats.last_load_time * 1000.0);
+            text_l("startup: %.2fms", game->startup_time * 1000.0);
+            text_l("level memory reserved: %.1fKB", (float64_t)(loader_stats.memory_reserved + instantiated_reserved) / (float64_t)KB(1));
+            text_l("level memory used:     %.1fKB", (float64_t)(loader_stats.memory_used + instantiated_used) / (float64_t)KB(1));
+
+            LevelMemoryPoolStats pool_stats = get_level_memory_pool_stats();
+            text_l("level memory chunks:   %d, %d pooled", pool_stats.chunks_allocated, pool_stats.chunks_pooled);
+        }
+        text_l(" ---");
+        /* Memory tags */ {
+            text_l("heap memory by tag (F12 resets peaks)");
+            std::string table = format_memory_tags();
+            for(size_t line_begin = 0, line_end; (line_end = table.find('\n', line_begin)) != std::string::npos; line_begin = line_end + 1) {
+                text_l("%s", table.substr(line_begin, line_end - line_begin).c_str());
             }
-            text_l("unpaused entity: %p", level->no_paused_entities[idx]);
         }
-        text_l("best region: %p", get_entity_by_unique_id_m(level, level->current_region_unique_id, CameraRegion));
         text_l(" ---");
-        text_l("entity types: %d", entity_type_count());
-        text_l("memory size:  %db", level->memory_size);
-        text_l("memory used:  %db, %.1f%%", level->memory_used, ((float64_t)level->memory_used / (float64_t)level->memory_size) * 100.0);
-        text_l("  used entities: %d", level->entities.count);
-        text_l("unused entities: %d", level->entities_unused.count);
-        if(level->entities.first_of_type[entity_type_id(Player)]) {
+        if(level != NULL) {
+            // text_l("level memory ptr: %p", level->memory);
+            text_l("is paused: %s", BOOL_STRING(level->pause_state));
+            auto __level_state_str = [] (Level *level) -> std::string {
+                switch(level->level_state) {
+                    default: return "!Unknown!";
+                    case ELevelState::PLAYING: return "Playing";
+                    case ELevelState::FINISHING_LEVEL: return "Finishing";
+                    case ELevelState::FINISHED: return "Finished";
+                }
+            };
+            text_l("level state: %s", __level_state_str(level).c_str());
+            text_l("level time:  %.4f", level->elapsed_time);
+            for(int32_t idx = 0; idx < level->no_paused_entities_count; ++idx) {
+                if(idx >= 4) {
+                    text_l("... (%d more)", level->no_paused_entities_count - idx);
+                    break;
+                }
+                text_l("unpaused entity: %p", level->no_paused_entities[idx]);
+            }
+            text_l("best region: %p, %d of %d tested last frame", get_current_camera_region(level), level->camera_region_index->tested_last_frame, (int32_t)level->camera_region_index->regions.size());
+            text_l("sleepers: %d, %d tested last frame", (int32_t)level->wake_up_sweep->sleepers.size() - level->wake_up_sweep->woken_count, level->wake_up_sweep->tested_last_frame);
+            text_l("entities: %d active, %d dormant", level->active_entity_count, level->dormant_entity_count);
+            /* Entity type costs */ {
+                text_l("entity types over %d frames, avg/max, by %s (F9)", ENTITY_COST_FRAMES, entity_cost_sort_string[(int32_t)game->entity_cost_sort]);
+                std::string table = format_entity_costs(game->entity_cost_sort, 12);
+                for(size_t line_begin = 0, line_end; (line_end = table.find('\n', line_begin)) != std::string::npos; line_begin = line_end + 1) {
+                    text_l("%s", table.substr(line_begin, line_end - line_begin).c_str());
+                }
+            }
+            /* Effects */ {
+                LevelEffects *effects = level->effects;
+                text_l("effects: update %.3fms, render %.3fms, %d dropped", effects->update_time * 1000.0, effects->render_time * 1000.0, effects->dropped);
+#define EFFECT_POOL(Type, name) text_l("  %-16s %d/%d", #name, effects->name.count, Type::capacity);
+                EFFECT_POOLS
+#undef EFFECT_POOL
+            }
+            if(level->stream != NULL) {
+                text_l("sections: %d/%d resident, %d entities stored", level->stream->resident_count, (int32_t)level->stream->sections.size(), level->stream->stored_entity_count);
+            }
             text_l(" ---");
-            auto player = level->entities.first_of_type[entity_type_id(Player)]->as<Player>();
-            text_l("Player     %p", player);
-            text_l("position:  %d %d", player->position.x, player->position.y);
-            text_l("state:     %s", player_state_string[player->state]);
-            text_l("mode:      %s", player_mode_string[player->mode]);
-            text_l("invincible %s", BOOL_STRING(player->in_invicible_state));
-            text_l("grounded:  %s, prev: %s", BOOL_STRING(player->has_move_data->is_grounded), BOOL_STRING(player->has_move_data->is_grounded_prev));
-            text_l("speed:     %+06.1f %+06.1f", player->move_data.speed.x, player->move_data.speed.y);
-            text_l("jump_t:    %+.3f", player->jump_t);
-            text_l("has_star:  %s", BOOL_STRING(player->has_star_powerup));
+            text_l("entity types: %d", entity_type_count());
+            text_l("memory size:  %db, %d chunks", level->memory_size, level->memory_chunk_count);
+            text_l("memory used:  %db, %.1f%%", level->memory_used, ((float64_t)level->memory_used / (float64_t)level->memory_size) * 100.0);
+            text_l("memory in use: %db, high water: %db", level->memory_in_use, level->memory_high_water);
+            text_l("  used entities: %d", level->entities.count);
+            int32_t unused_entities = 0;
+            for(int32_t type_id = 0; type_id < entity_type_count(); ++type_id) {
+                unused_entities += level->slabs[type_id].free_count;
+            }
+            text_l("unused entities: %d", unused_entities);
+            if(get_player(level) != NULL) {
+                text_l(" ---");
+                auto player = get_player(level);
+                text_l("Player     %p", player);
+                text_l("position:  %d %d", player->position.x, player->position.y);
+                text_l("state:     %s", player_state_string[player->state]);
+                text_l("mode:      %s", player_mode_string[player->mode]);
+                text_l("invincible %s", BOOL_STRING(player->in_invicible_state));
+                text_l("grounded:  %s, prev: %s", BOOL_STRING(player->has_move_data->is_grounded), BOOL_STRING(player->has_move_data->is_grounded_prev));
+                text_l("speed:     %+06.1f %+06.1f", player->move_data.speed.x, player->move_data.speed.y);
+                text_l("jump_t:    %+.3f", player->jump_t);
+                text_l("has_star:  %s", BOOL_STRING(player->has_star_powerup));
+            }
         }
         text_l(" ---");
 
@@ -685,7 +916,103 @@ static void _render_debug_panel(Game *game, Level *level, RenderStats game_rende
         }
         render::r_scissor_end();
     }
+
+    if(game->debug_panel_perc != 0.0f) {
+        _render_debug_frame_graph(game);
+    }
 #endif /* defined(_DEBUG_MODE) */
+
+    if(game->show_profiler_flame) {
+        _render_debug_flame_view(game);
+    }
+}
+
+// Total time of the last frames in the top right corner, the line is the hitch threshold
+static void _render_debug_frame_graph(Game *game) {
+#if defined(_DEBUG_MODE)
+    const int32_t frames = min_value(get_frame_timing_count(), 240);
+    const int32_t bar_width = 2;
+    const int32_t height = 80;
+    const float64_t max_time = get_frame_hitch_threshold() * 2.0;
+
+    const vec2i origin = { game->window_w - 240 * bar_width, game->window_h - height };
+    render::r_quad(origin, 2, { 240 * bar_width, height }, { 0.0f, 0.0f, 0.0f, 0.5f });
+
+    for(int32_t frames_ago = 0; frames_ago < frames; ++frames_ago) {
+        const float64_t time = get_frame_stage_time(FRAME_STAGE_TOTAL, frames_ago);
+        const int32_t bar_height = max_value((int32_t)(min_value(time / max_time, 1.0) * (float64_t)height), 1);
+        const vec4 color = time > get_frame_hitch_threshold() ? color::red : color::green;
+        render::r_quad({ game->window_w - (frames_ago + 1) * bar_width, origin.y }, 1, { bar_width, bar_height }, color);
+    }
+
+    const int32_t threshold_y = origin.y + height / 2;
+    render::r_line({ origin.x, threshold_y }, { game->window_w, threshold_y }, 0, color::yellow);
+#endif /* defined(_DEBUG_MODE) */
+}
+
+// Zones of the last frame along the bottom of the window, one band per thread with the outermost zones at the bottom
+static void _render_debug_flame_view(Game *game) {
+#if defined(ENABLE_PROFILER)
+    const ProfilerFrame *frame = get_profiler_last_frame();
+    if(frame->zones.empty()) {
+        return;
+    }
+
+    Font *font = render::def_font();
+    const int32_t row_height = font->height;
+
+    // At least a frame at the target rate, so the bars don't jump around when the frame time changes a bit
+    const float64_t span_ms = max_value(profiler_ticks_to_ms(frame->end - frame->begin), 1000.0 / 60.0);
+    const float64_t pixels_per_ms = (float64_t)game->window_w / span_ms;
+
+    std::vector<int32_t> thread_rows(frame->thread_count, 0);
+    for(auto &zone : frame->zones) {
+        thread_rows[zone.thread_idx] = max_value(thread_rows[zone.thread_idx], zone.depth + 1);
+    }
+
+    std::vector<int32_t> thread_first_row(frame->thread_count, 0);
+    int32_t row_count = 0;
+    for(int32_t thread_idx = 0; thread_idx < frame->thread_count; ++thread_idx) {
+        thread_first_row[thread_idx] = row_count;
+        row_count += thread_rows[thread_idx];
+    }
+
+    render::r_quad({ 0, 0 }, 2, { game->window_w, row_count * row_height }, { 0.0f, 0.0f, 0.0f, 0.5f });
+    for(auto &zone : frame->zones) {
+        const float64_t begin_ms = zone.begin > frame->begin ? profiler_ticks_to_ms(zone.begin - frame->begin) : 0.0;
+        const float64_t end_ms   = zone.end   > frame->begin ? profiler_ticks_to_ms(zone.end   - frame->begin) : 0.0;
+
+        const int32_t x     = (int32_t)(begin_ms * pixels_per_ms);
+        const int32_t width = max_value((int32_t)((end_ms - begin_ms) * pixels_per_ms), 1);
+        const int32_t y     = (thread_first_row[zone.thread_idx] + zone.depth) * row_height;
+
+        // Same zone, same color every frame
+        const uint32_t hash = (uint32_t)((uintptr_t)zone.name * 2654435761u);
+        const vec4 color = { 0.3f + (float32_t)((hash >> 8) & 0xff) / 512.0f, 0.3f + (float32_t)((hash >> 16) & 0xff) / 512.0f, 0.3f + (float32_t)((hash >> 24) & 0xff) / 512.0f, 0.9f };
+        render::r_quad({ x, y }, 1, { width, row_height - 1 }, color);
+
+        if(font->calc_string_width(zone.name) + 4.0f < (float32_t)width) {
+            render::r_text({ x + 2, y }, 0, zone.name, font);
+        }
+    }
+
+    char buffer[64];
+    sprintf_s(buffer, array_count(buffer), "%.2fms", profiler_ticks_to_ms(frame->end - frame->begin));
+    render::r_text({ 2, row_count * row_height }, 0, buffer, font);
+#endif /* defined(ENABLE_PROFILER) */
+}
+
+// Also in release builds with the enable_profiler option, F7 shows the flame view and F8 captures the next frames
+static void _update_profiler_keys(Game *game, Input *input) {
+#if defined(ENABLE_PROFILER)
+    if(input->keys[key_f07] & input_pressed) {
+        game->show_profiler_flame = !game->show_profiler_flame;
+    }
+
+    if(input->keys[key_f08] & input_pressed) {
+        request_profiler_capture(120, "profiler_capture.json");
+    }
+#endif /* defined(ENABLE_PROFILER) */
 }
 
 static void _update_debug_game_stuff(Game *game, Input *input, bool *do_update_game) {
@@ -712,6 +1039,11 @@ static void _update_debug_game_stuff(Game *game, Input *input, bool *do_update_g
         audio_player::a_stop_sounds();
         audio_player::a_stop_music();
         reload_all_levels(game);
+        if(game->use_custom_level) {
+            restart_custom_level(game);
+        } else {
+            set_level(game, game->world_idx, game->level_idx);
+        }
         set_starting_level_music(get_current_level(game));
     }
 
@@ -721,6 +1053,46 @@ static void _update_debug_game_stuff(Game *game, Input *input, bool *do_update_g
 
     if(input->keys[key_f05] & input_pressed) { 
         game->use_custom_level = !game->use_custom_level;
+        if(game->use_custom_level && game->custom_level == NULL) {
+            restart_custom_level(game);
+        } else if(!game->use_custom_level && get_current_level(game) == NULL) {
+            set_level(game, game->world_idx, game->level_idx);
+        }
+    }
+
+    if(input->keys[key_f06] & input_pressed) {
+        set_parallel_update_enabled(!is_parallel_update_enabled());
+    }
+
+    if(input->keys[key_f09] & input_pressed) {
+        game->entity_cost_sort = (EEntityCostSort)(((int32_t)game->entity_cost_sort + 1) % (int32_t)EEntityCostSort::__COUNT);
+    }
+
+    if(input->keys[key_f10] & input_pressed) {
+        export_frame_timings_csv("frame_timings.csv");
+    }
+
+    if(input->keys[key_f12] & input_pressed) {
+        reset_memory_tag_peaks();
+    }
+
+    if(input->keys[key_home] & input_pressed) {
+        if(game->input_recording != NULL) {
+            save_input_session("input_session.txt", game->input_recording);
+            delete game->input_recording;
+            game->input_recording = NULL;
+        } else if(game->game_mode == EGameMode::PLAYING) {
+            // From the pristine level, like the replay does
+            game->input_recording = new InputSession();
+            if(game->use_custom_level) {
+                game->input_recording->level_name = "custom.level";
+                restart_custom_level(game);
+            } else {
+                game->input_recording->level_name = get_level_file_name(game->world_idx, game->level_idx);
+                set_level(game, game->world_idx, game->level_idx);
+            }
+            set_starting_level_music(get_current_level(game));
+        }
     }
 
     if(input->keys[key_page_up]  & input_pressed) { 
@@ -8,6 +8,7 @@
 #include "level.h"
 #include "renderer.h"
 #include "save_data.h"
+#include "entity_costs.h"
 
 #define GAME_WIDTH  256
 #define GAME_HEIGHT 240
@@ -45,12 +46,12 @@ struct Game {
 #define LEVEL_NUM 4
     int32_t world_idx;
     int32_t level_idx;
-    Level *levels[WORLD_NUM][LEVEL_NUM];
-    LevelSaveData level_save_datas[WORLD_NUM][LEVEL_NUM];
+    Level *levels[WORLD_NUM][LEVEL_NUM]; // Only the current level is instantiated, cloned from the pristine level in level_loader
+    struct LevelLoader *level_loader;     // Pristine levels, loaded on demand or prefetched in the background
 
     bool   use_custom_level;
+    bool   custom_level_file_exists; // Checked when the levels are (re)loaded, the menu offers the custom level before it finished loading
     Level *custom_level;
-    LevelSaveData custom_level_save_data;
 
     vec2 mouse_in_view_space_prev;
     vec2 mouse_in_view_space;
@@ -69,8 +70,12 @@ struct Game {
     bool         use_debug_render_view;
     bool         debug_panel_open;
     float32_t    debug_panel_perc;
+    bool         show_profiler_flame;
+    EEntityCostSort entity_cost_sort;
     RenderView   debug_render_view;
     Framebuffer *debug_framebuffer;
+    struct InputSession *input_recording; // NULL when not recording
+    float64_t    startup_time;            // Seconds from the start of main until the game was created, set by main
 
     /* --- gameplay info panel --- */
     Font       *gp_info_font;
@@ -100,6 +105,8 @@ void  delete_game(Game *game);
 void  update_game(Game *game, Input *input, float64_t delta_time);
 void  render_game(Game *game);
 void  reset_session(Game *game);
+void  reset_session_for_level(Game *game, const std::string &level_file_name); // Session and level indices the finishing stage of update_level reads, for replays and benchmarks
+bool  is_custom_level_available(const Game *game); // Doesn't wait for the custom level to load
 
 inline Level *get_current_level(Game *game) { return game->use_custom_level ? game->custom_level : game->levels[game->world_idx][game->level_idx]; }
 
@@ -0,0 +1,97 @@
+#include "input_session.h"
+#include "data.h"
+
+#include <fstream>
+
+#define SIM_INPUT_BITS\
+    SIM_INPUT_BIT(player_move_r)\
+    SIM_INPUT_BIT(player_move_l)\
+    SIM_INPUT_BIT(player_run)\
+    SIM_INPUT_BIT(player_jump)\
+    SIM_INPUT_BIT(player_croutch)\
+    SIM_INPUT_BIT(player_throw)\
+    SIM_INPUT_BIT(player_try_entering_pipe_v)\
+    SIM_INPUT_BIT(player_try_entering_pipe_h)
+
+namespace {
+#define SIM_INPUT_BIT(field) SIM_INPUT_BIT_##field,
+    enum : int32_t { SIM_INPUT_BITS SIM_INPUT_BIT__COUNT };
+#undef SIM_INPUT_BIT
+
+    static_assert(SIM_INPUT_BIT__COUNT * sizeof(bool) == sizeof(SimInput), "A SimInput field is missing from SIM_INPUT_BITS.");
+}
+
+uint32_t pack_sim_input(SimInput input) {
+    uint32_t input_bits = 0;
+#define SIM_INPUT_BIT(field) if(input.field) input_bits |= 1u << SIM_INPUT_BIT_##field;
+    SIM_INPUT_BITS
+#undef SIM_INPUT_BIT
+    return input_bits;
+}
+
+SimInput unpack_sim_input(uint32_t input_bits) {
+    SimInput input = { };
+#define SIM_INPUT_BIT(field) input.field = (input_bits & (1u << SIM_INPUT_BIT_##field)) != 0;
+    SIM_INPUT_BITS
+#undef SIM_INPUT_BIT
+    return input;
+}
+
+void record_input_session_frame(InputSession *session, SimInput input, float64_t delta_time) {
+    InputSessionFrame frame;
+    frame.delta_time = delta_time;
+    frame.input_bits = pack_sim_input(input);
+    session->frames.push_back(frame);
+}
+
+bool save_input_session(const char *filepath, InputSession *session) {
+    std::string data = "level : " + session->level_name + "\n";
+
+    char buffer[64];
+    for(const InputSessionFrame &frame : session->frames) {
+        // Exact delta times, the replay has to simulate the same steps
+        sprintf_s(buffer, array_count(buffer), "%.17g %u\n", frame.delta_time, frame.input_bits);
+        data += buffer;
+    }
+
+    if(!save_file(filepath, (char *)data.c_str(), data.size())) {
+        printf("Failed to write the input session to \"%s\".\n", filepath);
+        return false;
+    }
+    printf("Input session of %d frames written to \"%s\".\n", (int32_t)session->frames.size(), filepath);
+    return true;
+}
+
+bool load_input_session(const char *filepath, InputSession *out_session) {
+    out_session->level_name.clear();
+    out_session->frames.clear();
+
+    std::ifstream in_file;
+    in_file.open(filepath);
+    if(!in_file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(in_file, line)) {
+        if(line.empty() || line[0] == '\r') {
+            continue;
+        }
+
+        const size_t idx = line.find_first_of(':');
+        if(idx != std::string::npos) {
+            const size_t value_idx = line.find_first_not_of(" \t", idx + 1);
+            out_session->level_name = value_idx != std::string::npos ? line.substr(value_idx) : "";
+            out_session->level_name.erase(out_session->level_name.find_last_not_of(" \t\r") + 1);
+            continue;
+        }
+
+        char *end = NULL;
+        InputSessionFrame frame;
+        frame.delta_time = strtod(line.c_str(), &end);
+        frame.input_bits = (uint32_t)strtoul(end, NULL, 10);
+        out_session->frames.push_back(frame);
+    }
+
+    return !out_session->level_name.empty() && !out_session->frames.empty();
+}
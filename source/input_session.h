@@ -0,0 +1,28 @@
+#ifndef _INPUT_SESSION_H
+#define _INPUT_SESSION_H
+
+#include "common.h"
+#include "entity.h"
+
+// The SimInput of every simulated frame of a play session, recorded in the game (Home in debug mode) and replayed by no_name_bench --replay.
+// Recording starts with a restart of the current level, so frame 0 is the pristine level. Bowser's rand() isn't part of it.
+// File: "level : <file in data/levels>" and then a "<delta time> <input bits>" line per frame.
+
+struct InputSessionFrame {
+    float64_t delta_time;
+    uint32_t  input_bits; // pack_sim_input
+};
+
+struct InputSession {
+    std::string level_name; // "1_1.level"
+    std::vector<InputSessionFrame> frames;
+};
+
+uint32_t pack_sim_input(SimInput input);
+SimInput unpack_sim_input(uint32_t input_bits);
+
+void record_input_session_frame(InputSession *session, SimInput input, float64_t delta_time);
+bool save_input_session(const char *filepath, InputSession *session);
+bool load_input_session(const char *filepath, InputSession *out_session); // false if the file is missing or has no frames
+
+#endif /* _INPUT_SESSION_H */
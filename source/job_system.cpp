@@ -0,0 +1,182 @@
+#include "job_system.h"
+#include "maths.h"
+#include "profiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+namespace {
+    struct Job {
+        parallel_for_proc *proc;
+        void   *user_data;
+        int32_t chunk_idx;
+        int32_t begin;
+        int32_t end;
+    };
+
+    // Owner pops from the back, thieves take from the front
+    struct JobQueue {
+        std::mutex      mutex;
+        std::deque<Job> jobs;
+    };
+
+    thread_local int32_t job_thread_idx = 0;
+}
+
+struct JobSystem {
+    std::vector<std::thread> workers;
+    JobQueue *queues;      // [0] is used by the thread calling parallel_for, [n] by worker n
+    int32_t   queue_count;
+
+    std::mutex              wake_mutex;
+    std::condition_variable wake_cv;
+    uint64_t                generation; // Bumped by every parallel_for, workers wake up when it changes
+    bool                    quit;
+
+    std::atomic<int32_t> jobs_pending;
+};
+
+static bool pop_job(JobQueue *queue, Job *out_job, bool steal) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if(queue->jobs.empty()) {
+        return false;
+    }
+
+    if(steal) {
+        *out_job = queue->jobs.front();
+        queue->jobs.pop_front();
+    } else {
+        *out_job = queue->jobs.back();
+        queue->jobs.pop_back();
+    }
+    return true;
+}
+
+// Runs jobs until every queue is empty
+static void run_jobs(JobSystem *jobs, int32_t queue_idx) {
+    for(;;) {
+        Job job;
+        bool found = pop_job(&jobs->queues[queue_idx], &job, false);
+        for(int32_t offset = 1; !found && offset < jobs->queue_count; ++offset) {
+            found = pop_job(&jobs->queues[(queue_idx + offset) % jobs->queue_count], &job, true);
+        }
+
+        if(!found) {
+            return;
+        }
+
+        /* Job */ {
+            PROFILE_ZONE("job");
+            job.proc(job.user_data, job.chunk_idx, job.begin, job.end);
+        }
+        jobs->jobs_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static void job_worker(JobSystem *jobs, int32_t worker_idx) {
+    job_thread_idx = worker_idx;
+    set_profiler_thread_name("job worker");
+
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(jobs->wake_mutex);
+    for(;;) {
+        jobs->wake_cv.wait(lock, [&] { return jobs->quit || jobs->generation != seen_generation; });
+        if(jobs->quit) {
+            break;
+        }
+        seen_generation = jobs->generation;
+
+        lock.unlock();
+        run_jobs(jobs, worker_idx);
+        lock.lock();
+    }
+}
+
+JobSystem *create_job_system(int32_t worker_count) {
+    if(worker_count < 0) {
+        worker_count = max_value(0, (int32_t)std::thread::hardware_concurrency() - 1);
+    }
+
+    JobSystem *jobs = new JobSystem();
+    jobs->queue_count = worker_count + 1;
+    jobs->queues = new JobQueue[jobs->queue_count];
+    jobs->generation = 0;
+    jobs->quit = false;
+    jobs->jobs_pending = 0;
+
+    for(int32_t idx = 1; idx <= worker_count; ++idx) {
+        jobs->workers.emplace_back(job_worker, jobs, idx);
+    }
+    return jobs;
+}
+
+void delete_job_system(JobSystem *jobs) {
+    if(jobs == NULL) {
+        return;
+    }
+
+    /* Stop workers */ {
+        std::lock_guard<std::mutex> lock(jobs->wake_mutex);
+        jobs->quit = true;
+    }
+    jobs->wake_cv.notify_all();
+    for(auto &worker : jobs->workers) {
+        worker.join();
+    }
+
+    delete[] jobs->queues;
+    delete jobs;
+}
+
+void parallel_for(JobSystem *jobs, int32_t count, int32_t chunk_size, parallel_for_proc *proc, void *user_data) {
+    assert(job_thread_idx == 0, "parallel_for can't be called from a job");
+    assert(chunk_size > 0);
+    if(count <= 0) {
+        return;
+    }
+
+    const int32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    if(chunk_count == 1 || jobs->queue_count == 1) {
+        for(int32_t chunk_idx = 0; chunk_idx < chunk_count; ++chunk_idx) {
+            proc(user_data, chunk_idx, chunk_idx * chunk_size, min_value(count, (chunk_idx + 1) * chunk_size));
+        }
+        return;
+    }
+
+    // Deal chunks out evenly, stealing sorts out the imbalance
+    jobs->jobs_pending.store(chunk_count, std::memory_order_relaxed);
+    for(int32_t chunk_idx = 0; chunk_idx < chunk_count; ++chunk_idx) {
+        Job job;
+        job.proc      = proc;
+        job.user_data = user_data;
+        job.chunk_idx = chunk_idx;
+        job.begin     = chunk_idx * chunk_size;
+        job.end       = min_value(count, job.begin + chunk_size);
+
+        JobQueue *queue = &jobs->queues[chunk_idx % jobs->queue_count];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->jobs.push_front(job); // Owner pops from the back, so lower chunks run first
+    }
+
+    /* Wake workers */ {
+        std::lock_guard<std::mutex> lock(jobs->wake_mutex);
+        jobs->generation += 1;
+    }
+    jobs->wake_cv.notify_all();
+
+    run_jobs(jobs, 0);
+    while(jobs->jobs_pending.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+int32_t get_job_worker_count(JobSystem *jobs) {
+    return jobs->queue_count - 1;
+}
+
+int32_t get_job_thread_idx(void) {
+    return job_thread_idx;
+}
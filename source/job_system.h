@@ -0,0 +1,21 @@
+#ifndef _JOB_SYSTEM_H
+#define _JOB_SYSTEM_H
+
+#include "common.h"
+
+// Worker threads with one job queue each, a thread that runs out of jobs steals from the others.
+// The thread calling parallel_for works on the jobs too, so there's always at least one thread doing the work.
+struct JobSystem;
+
+#define PARALLEL_FOR_PROC(name) void name(void *user_data, int32_t chunk_idx, int32_t begin, int32_t end)
+typedef PARALLEL_FOR_PROC(parallel_for_proc);
+
+JobSystem *create_job_system(int32_t worker_count); // worker_count < 0 picks one less than the hardware threads
+void delete_job_system(JobSystem *jobs);
+
+// Splits [0, count) into chunks of chunk_size and returns when all of them are done, not reentrant
+void    parallel_for(JobSystem *jobs, int32_t count, int32_t chunk_size, parallel_for_proc *proc, void *user_data);
+int32_t get_job_worker_count(JobSystem *jobs);
+int32_t get_job_thread_idx(void); // 0 for threads that aren't workers
+
+#endif /* _JOB_SYSTEM_H */
@@ -3,10 +3,20 @@
 #include "all_entities.h"
 #include "renderer.h"
 #include "data.h"
+#include "parallel_update.h"
+#include "level_stream.h"
+#include "level_effects.h"
+#include "profiler.h"
+#include "entity_costs.h"
+#include "memory_tags.h"
+
+#include <mutex>
+#include <algorithm>
 
 namespace {
     const int32_t   wake_up_rect_half_width  = GAME_WIDTH / 2 + TILE_SIZE * 2;
     const int32_t   wake_up_rect_half_height = GAME_HEIGHT / 2;
+    const int32_t   default_sleep_margin     = TILE_SIZE * 8;
     const int32_t   starting_level_time      = 400;
     const float32_t time_point_real_time     = 0.2f;   // How much seconds is a level time point
     const float32_t time_per_time_point      = 0.005f; // How much time it takes for one in the finishing sequence
@@ -17,6 +27,95 @@ namespace {
     const float32_t wait_time_before_finishing_world = 3.5f;
 }
 
+namespace {
+    // Chunks released by levels, shared by every level and the level loader thread
+    std::mutex        chunk_pool_mutex;
+    LevelMemoryChunk *chunk_pool_first;
+    int32_t           chunk_pool_count;
+    int32_t           chunks_allocated;
+}
+
+static LevelMemoryChunk *acquire_chunk(size_t size) {
+    size = max_value(size, LEVEL_MEMORY_CHUNK_SIZE - sizeof(LevelMemoryChunk));
+
+    LevelMemoryChunk *chunk = NULL;
+    if(size == LEVEL_MEMORY_CHUNK_SIZE - sizeof(LevelMemoryChunk)) {
+        std::lock_guard<std::mutex> lock(chunk_pool_mutex);
+        if(chunk_pool_first != NULL) {
+            chunk = chunk_pool_first;
+            chunk_pool_first = chunk->next;
+            chunk_pool_count -= 1;
+        } else {
+            chunks_allocated += 1;
+        }
+    }
+
+    if(chunk == NULL) {
+        chunk = (LevelMemoryChunk *)tagged_malloc(MEMORY_TAG_LEVEL_ARENA, sizeof(LevelMemoryChunk) + size); // Not zeroed, entities get zeroed when created
+        assert(chunk != NULL, "Couldn't allocate level memory.");
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void release_chunks(LevelMemoryChunk *first) {
+    std::lock_guard<std::mutex> lock(chunk_pool_mutex);
+
+    LevelMemoryChunk *chunk = first;
+    while(chunk != NULL) {
+        LevelMemoryChunk *next = chunk->next;
+        if(chunk->size != LEVEL_MEMORY_CHUNK_SIZE - sizeof(LevelMemoryChunk)) {
+            tagged_free(chunk);
+        } else if(chunk_pool_count >= LEVEL_MEMORY_MAX_POOLED_CHUNKS) {
+            chunks_allocated -= 1;
+            tagged_free(chunk);
+        } else {
+            chunk->next = chunk_pool_first;
+            chunk_pool_first = chunk;
+            chunk_pool_count += 1;
+        }
+        chunk = next;
+    }
+}
+
+static void append_chunk(Level *level, LevelMemoryChunk *chunk) {
+    if(level->last_chunk == NULL) {
+        level->first_chunk = chunk;
+    } else {
+        level->last_chunk->next = chunk;
+    }
+    level->last_chunk = chunk;
+    level->memory_chunk_count += 1;
+    level->memory_size += chunk->size;
+}
+
+void *alloc_level_memory(Level *level, size_t bytes) {
+    bytes = (bytes + 15) & ~(size_t)15;
+
+    LevelMemoryChunk *chunk = level->last_chunk;
+    if(chunk == NULL || chunk->used + bytes > chunk->size) {
+        chunk = acquire_chunk(bytes);
+        append_chunk(level, chunk);
+    }
+
+    void *memory = chunk->data() + chunk->used;
+    chunk->used += bytes;
+    level->memory_used += bytes;
+    return memory;
+}
+
+LevelMemoryPoolStats get_level_memory_pool_stats(void) {
+    std::lock_guard<std::mutex> lock(chunk_pool_mutex);
+
+    LevelMemoryPoolStats stats;
+    stats.chunks_allocated = chunks_allocated;
+    stats.chunks_pooled    = chunk_pool_count;
+    return stats;
+}
+
 static inline void recalculate_wake_up_rect(Level *level) {
     const vec2i wake_up_rect_half_size = { wake_up_rect_half_width, wake_up_rect_half_height };
     level->wake_up_rect_position = vec2i{ (int32_t)roundf(level->render_view.x_translate), (int32_t)roundf(level->render_view.y_translate) } - wake_up_rect_half_size;
@@ -24,17 +123,31 @@ static inline void recalculate_wake_up_rect(Level *level) {
 }
 
 Level *create_empty_level(void) {
-    Level *level = malloc_and_zero_struct(Level);
+    Level *level = tagged_malloc_and_zero_struct(MEMORY_TAG_LEVEL, Level);
 
-    // Allocate memory
-    level->memory_size = LEVEL_MEMORY_TO_ALLOC;
+    // Memory chunks are acquired when the first entity is created
+    level->first_chunk = NULL;
+    level->last_chunk  = NULL;
+    level->memory_chunk_count = 0;
+    level->memory_size = 0;
     level->memory_used = 0;
-    level->memory = (uint8_t *)malloc_and_zero(level->memory_size);
+    level->memory_in_use = 0;
+    level->memory_high_water = 0;
 
     level->next_entity_id = 1;
     zero_struct(&level->entities);
-    zero_struct(&level->entities_unused);
+    zero_array(level->slabs);
     level->to_be_deleted = new std::vector<Entity *>();
+    level->wake_up_sweep = new WakeUpSweep();
+    level->wake_up_sweep->dirty = true;
+    level->sleep_margin = default_sleep_margin;
+    level->tile_index = new TileIndex();
+    level->tile_index->dirty = true;
+    level->camera_region_index = new CameraRegionIndex();
+    level->camera_region_index->dirty = true;
+    level->effects = create_level_effects();
+    level->stream_sections = false;
+    level->stream = NULL;
 
     zero_array(level->no_paused_entities);
     level->no_paused_entities_count = 0;
@@ -82,18 +195,190 @@ void delete_level(Level *level) {
         delete level->to_be_deleted;
     }
 
+    if(level->wake_up_sweep != NULL) {
+        delete level->wake_up_sweep;
+    }
+
     while(level->entities.first != NULL) {
         delete_entity_imm(level->entities.first);
     }
 
-    free(level->memory);
-    free(level);
+    // After the entities, deleting a tilemap or a region marks these dirty
+    if(level->tile_index != NULL) {
+        delete level->tile_index;
+    }
+
+    if(level->camera_region_index != NULL) {
+        delete level->camera_region_index;
+    }
+
+    delete_level_stream(level->stream);
+    delete_level_effects(level->effects);
+
+    release_chunks(level->first_chunk);
+    tagged_free(level);
+}
+
+// Source chunk ranges sorted by address and where the same chunk of the destination level starts
+struct LevelRebase {
+    struct Range {
+        uint8_t *from_begin;
+        uint8_t *from_end;
+        uint8_t *to_begin;
+    };
+    std::vector<Range> ranges;
+};
+
+static void build_level_rebase(LevelRebase *rebase, Level *from, Level *to) {
+    rebase->ranges.clear();
+    LevelMemoryChunk *to_chunk = to->first_chunk;
+    for(LevelMemoryChunk *from_chunk = from->first_chunk; from_chunk != NULL; from_chunk = from_chunk->next, to_chunk = to_chunk->next) {
+        rebase->ranges.push_back({ from_chunk->data(), from_chunk->data() + from_chunk->used, to_chunk->data() });
+    }
+    std::sort(rebase->ranges.begin(), rebase->ranges.end(), [] (const LevelRebase::Range &a, const LevelRebase::Range &b) {
+        return a.from_begin < b.from_begin;
+    });
+}
+
+// Moves a pointer into the source level's memory to the same offset in the same chunk of the destination level, a binary search over the chunks
+template<typename Type>
+static inline Type *rebase_level_pointer(Type *ptr, const LevelRebase *rebase) {
+    if(ptr == NULL) {
+        return NULL;
+    }
+
+    uint8_t *byte_ptr = (uint8_t *)ptr;
+    auto found = std::upper_bound(rebase->ranges.begin(), rebase->ranges.end(), byte_ptr, [] (uint8_t *value, const LevelRebase::Range &range) {
+        return value < range.from_begin;
+    });
+    if(found == rebase->ranges.begin()) {
+        return ptr;
+    }
+
+    --found;
+    if(byte_ptr >= found->from_end) {
+        return ptr;
+    }
+    return (Type *)(found->to_begin + (byte_ptr - found->from_begin));
+}
+
+static void rebase_entity_pool(EntityPool *pool, const LevelRebase *rebase) {
+    pool->first = rebase_level_pointer(pool->first, rebase);
+    pool->last  = rebase_level_pointer(pool->last,  rebase);
+}
+
+static void rebase_entity_slab(EntitySlab *slab, const LevelRebase *rebase) {
+    slab->first_free  = rebase_level_pointer(slab->first_free,  rebase);
+    slab->first_block = rebase_level_pointer(slab->first_block, rebase);
+    slab->last_block  = rebase_level_pointer(slab->last_block,  rebase);
+}
+
+// Level should have no chunks
+static void copy_level_from(Level *level, Level *source) {
+    assert(level->first_chunk == NULL);
+
+    std::vector<Entity *> *to_be_deleted = level->to_be_deleted;
+    WakeUpSweep *wake_up_sweep = level->wake_up_sweep;
+    TileIndex *tile_index = level->tile_index;
+    CameraRegionIndex *camera_region_index = level->camera_region_index;
+    LevelStream *stream = level->stream;
+    LevelEffects *effects = level->effects;
+
+    *level = *source;
+    level->to_be_deleted = to_be_deleted;
+    level->to_be_deleted->clear();
+    level->wake_up_sweep = wake_up_sweep;
+    level->wake_up_sweep->dirty = true; // Points to the source's entities
+    level->tile_index = tile_index;
+    level->tile_index->dirty = true;
+    level->camera_region_index = camera_region_index;
+    level->camera_region_index->dirty = true;
+    delete_level_stream(stream);
+    level->stream = clone_level_stream(source->stream); // Sections that aren't resident are part of the level state
+    level->effects = effects;
+    copy_level_effects(level->effects, source->effects);
+
+    // Same chunk layout, so pointers keep their chunk and offset
+    level->first_chunk = NULL;
+    level->last_chunk  = NULL;
+    level->memory_chunk_count = 0;
+    level->memory_size = 0;
+    for(LevelMemoryChunk *source_chunk = source->first_chunk; source_chunk != NULL; source_chunk = source_chunk->next) {
+        LevelMemoryChunk *chunk = acquire_chunk(source_chunk->size);
+        chunk->used = source_chunk->used;
+        memcpy(chunk->data(), source_chunk->data(), source_chunk->used);
+        append_chunk(level, chunk);
+    }
+
+    LevelRebase rebase;
+    build_level_rebase(&rebase, source, level);
+
+    rebase_entity_pool(&level->entities, &rebase);
+    for(int32_t idx = 0; idx < level->no_paused_entities_count; ++idx) {
+        level->no_paused_entities[idx] = rebase_level_pointer(level->no_paused_entities[idx], &rebase);
+    }
+
+    // Slabs are already rebased, so those can be walked in the copy, free slots included
+    for(int32_t type_id = 0; type_id < entity_type_count(); ++type_id) {
+        EntitySlab *slab = &level->slabs[type_id];
+        rebase_entity_slab(slab, &rebase);
+
+        for(EntitySlabBlock *block = slab->first_block; block != NULL; block = block->next) {
+            block->next = rebase_level_pointer(block->next, &rebase);
+
+            for(int32_t slot = 0; slot < block->used; ++slot) {
+                Entity *entity = (Entity *)(block->slots() + slab->stride * slot);
+                entity->next          = rebase_level_pointer(entity->next, &rebase);
+                entity->prev          = rebase_level_pointer(entity->prev, &rebase);
+                entity->has_collider  = rebase_level_pointer(entity->has_collider, &rebase);
+                entity->has_move_data = rebase_level_pointer(entity->has_move_data, &rebase);
+                entity->level = level;
+            }
+        }
+    }
+
+    // Tile arrays live outside of the level memory
+    for_entity_type(level, Tilemap, tilemap) {
+        clone_tilemap_tiles(tilemap);
+    }
+}
+
+Level *clone_level(Level *source) {
+    PROFILE_FUNCTION();
+    assert(source != NULL);
+
+    Level *level = tagged_malloc_and_zero_struct(MEMORY_TAG_LEVEL, Level);
+    level->to_be_deleted = new std::vector<Entity *>();
+    level->wake_up_sweep = new WakeUpSweep();
+    level->tile_index = new TileIndex();
+    level->camera_region_index = new CameraRegionIndex();
+    level->effects = create_level_effects();
+
+    copy_level_from(level, source);
+    return level;
+}
+
+void recreate_level_from_clone(Level **level, Level *source) {
+    PROFILE_FUNCTION();
+
+    if(*level == NULL) {
+        *level = clone_level(source);
+        return;
+    }
+
+    // Chunks go back to the pool and get picked up again by the copy
+    while((*level)->entities.first != NULL) {
+        delete_entity_imm((*level)->entities.first);
+    }
+    release_chunks((*level)->first_chunk);
+    (*level)->first_chunk = NULL;
+    copy_level_from(*level, source);
 }
 
 void set_level_render_view(Level *level) {
     RenderView *view = &level->render_view;
 
-    auto region = get_entity_by_unique_id_m(level, level->current_region_unique_id, CameraRegion);
+    auto region = get_current_camera_region(level);
     if(region == NULL) {
         return;
     }
@@ -132,44 +417,155 @@ void set_best_camera_region(Level *level) {
         return;
     }
 
-    // Find regions the player collides with
-    std::vector<CameraRegion *> regions;
-    for_entity_type(level, CameraRegion, region_check) {
-        if(aabb(player->position + player->has_collider->offset, player->has_collider->size, region_check->position, { region_check->x_width, region_check->const_height_in_pixels })) {
-            regions.push_back(region_check);
+    // Stays in the current region until the player leaves it, otherwise keeps the last one
+    CameraRegion *best = find_camera_region(level, player->position + player->has_collider->offset, player->has_collider->size);
+    if(best != NULL) {
+        set_current_camera_region(level, best);
+    }
+}
+
+static inline bool is_sleeping(Entity *entity) {
+    return entity->entity_flags & E_FLAG_SLEEPS_UNTIL_AWAKEN && entity->is_asleep && entity->has_collider != NULL;
+}
+
+static inline SleepingEntity make_sleeping_entity(Entity *entity) {
+    SleepingEntity sleeper;
+    sleeper.x         = entity->position.x + entity->has_collider->offset.x;
+    sleeper.width     = entity->has_collider->size.x;
+    sleeper.unique_id = entity->unique_id;
+    sleeper.entity    = entity;
+    return sleeper;
+}
+
+static inline bool is_sleeper_valid(SleepingEntity *sleeper) {
+    return sleeper->entity != NULL && sleeper->entity->in_use && sleeper->entity->unique_id == sleeper->unique_id;
+}
+
+static void rebuild_wake_up_sweep(Level *level) {
+    WakeUpSweep *sweep = level->wake_up_sweep;
+    sweep->sleepers.clear();
+    sweep->awake.clear();
+    sweep->begin = 0;
+    sweep->end = 0;
+    sweep->max_width = 0;
+    sweep->woken_count = 0;
+    sweep->dirty = false;
+
+    for_every_entity_by_type(level, entity) {
+        if(!(entity->entity_flags & E_FLAG_SLEEPS_UNTIL_AWAKEN) || entity->has_collider == NULL) {
+            continue;
+        }
+
+        SleepingEntity sleeper = make_sleeping_entity(entity);
+        if(entity->is_asleep) {
+            sweep->sleepers.push_back(sleeper);
+            sweep->max_width = max_value(sweep->max_width, sleeper.width);
+        } else {
+            sweep->awake.push_back(sleeper);
         }
     }
 
-    // Determine best region
-    CameraRegion *best = NULL;
-    for(CameraRegion *region_check : regions) {
-        // @temp For now just pick first one
-        best = region_check;
-        break;
+    std::sort(sweep->sleepers.begin(), sweep->sleepers.end(), [] (const SleepingEntity &a, const SleepingEntity &b) { return a.x < b.x; });
+}
+
+// Moves the cursors with the wake up rect, amortized O(1) while the camera scrolls
+static void wake_up_entities(Level *level) {
+    PROFILE_FUNCTION();
+
+    WakeUpSweep *sweep = level->wake_up_sweep;
+    if(sweep->dirty || sweep->woken_count > (int32_t)sweep->sleepers.size() / 2 + 16) {
+        rebuild_wake_up_sweep(level);
     }
 
-    if(best != NULL) {
-        level->current_region_unique_id = best->unique_id;
-    } else {
-        // Ensure current region is valid
-        auto exists = get_entity_by_unique_id_m(level, level->current_region_unique_id, CameraRegion);
-        if(exists == NULL) {
-            level->current_region_unique_id = 0;
+    const int32_t count = (int32_t)sweep->sleepers.size();
+    SleepingEntity *sleepers = sweep->sleepers.data();
+    const int32_t left  = level->wake_up_rect_position.x - sweep->max_width;
+    const int32_t right = level->wake_up_rect_position.x + level->wake_up_rect_size.x;
+
+    while(sweep->end < count && sleepers[sweep->end].x <= right)   sweep->end += 1;
+    while(sweep->end > 0 && sleepers[sweep->end - 1].x > right)    sweep->end -= 1;
+    while(sweep->begin < count && sleepers[sweep->begin].x < left) sweep->begin += 1;
+    while(sweep->begin > 0 && sleepers[sweep->begin - 1].x >= left) sweep->begin -= 1;
+
+    sweep->tested_last_frame = 0;
+    for(int32_t idx = sweep->begin; idx < sweep->end; ++idx) {
+        SleepingEntity *sleeper = &sleepers[idx];
+        if(!is_sleeper_valid(sleeper) || !is_sleeping(sleeper->entity)) {
+            continue;
+        }
+
+        Entity *entity = sleeper->entity;
+        sweep->tested_last_frame += 1;
+        if(aabb(entity->position + entity->has_collider->offset, entity->has_collider->size, level->wake_up_rect_position, level->wake_up_rect_size)) {
+            entity->is_asleep = false;
+            sweep->awake.push_back(*sleeper);
+            sweep->woken_count += 1;
+            sleeper->entity = NULL;
+        }
+    }
+}
+
+// Entities left behind don't need to keep simulating, they get woken up again by the sweep when the camera comes back.
+// Only grounded ones, so anything falling still reaches kill regions, moving platforms and pipes don't sleep.
+static void put_far_entities_to_sleep(Level *level) {
+    PROFILE_FUNCTION();
+
+    if(level->sleep_margin <= 0) {
+        return;
+    }
+
+    WakeUpSweep *sweep = level->wake_up_sweep;
+    const vec2i sleep_rect_position = level->wake_up_rect_position - vec2i{ level->sleep_margin, level->sleep_margin };
+    const vec2i sleep_rect_size     = level->wake_up_rect_size + vec2i{ level->sleep_margin, level->sleep_margin } * 2;
+
+    for(int32_t idx = 0; idx < (int32_t)sweep->awake.size(); ) {
+        SleepingEntity *awake = &sweep->awake[idx];
+        Entity *entity = awake->entity;
+
+        bool remove = false;
+        if(!is_sleeper_valid(awake)) {
+            remove = true;
+        } else if(!entity->deleted && entity->has_move_data != NULL && entity->has_move_data->is_grounded) {
+            if(!aabb(entity->position + entity->has_collider->offset, entity->has_collider->size, sleep_rect_position, sleep_rect_size)) {
+                entity->is_asleep = true;
+
+                SleepingEntity sleeper = make_sleeping_entity(entity);
+                auto at = std::lower_bound(sweep->sleepers.begin(), sweep->sleepers.end(), sleeper, [] (const SleepingEntity &a, const SleepingEntity &b) { return a.x < b.x; });
+                const int32_t at_idx = (int32_t)(at - sweep->sleepers.begin());
+                sweep->sleepers.insert(at, sleeper);
+                sweep->max_width = max_value(sweep->max_width, sleeper.width);
+
+                // Cursors settle on the next wake up pass
+                if(at_idx < sweep->begin) sweep->begin += 1;
+                if(at_idx < sweep->end)   sweep->end   += 1;
+                remove = true;
+            }
+        }
+
+        if(remove) {
+            *awake = sweep->awake.back();
+            sweep->awake.pop_back();
+        } else {
+            idx += 1;
         }
     }
 }
 
 void update_level(Level *level, SimInput input, Game *game, float64_t delta_time) {
+    PROFILE_FUNCTION();
+
     level->coins_collected_this_frame = 0;
     level->points_aquired_this_frame  = 0;
+    level->active_entity_count  = 0;
+    level->dormant_entity_count = 0;
+    begin_entity_cost_frame(level);
 
     auto maybe_update_entity = [&] (Entity *e) {
-        if(e->update_proc != NULL && is_entity_used(e)) {
-            if(e->entity_flags & E_FLAG_SLEEPS_UNTIL_AWAKEN && e->is_asleep) {
-                return;
-            } else {
-                e->update_proc(e, input, delta_time);
-            }
+        if(can_update_entity(e)) {
+            level->active_entity_count += 1;
+            e->update_proc(e, input, delta_time);
+        } else if(e->is_asleep && is_entity_used(e)) {
+            level->dormant_entity_count += 1;
         }
     };
 
@@ -185,16 +581,24 @@ void update_level(Level *level, SimInput input, Game *game, float64_t delta_time
 
             // Function that updates all entities in the order of declaration in 'all_entities.h'
             auto update_entities_in_defined_order = [&] (void) {
-#define ENTITY_TYPE(Type)\
-                for_entity_type(level, Type, entity) {\
-                    maybe_update_entity(entity);\
-                }
+#define ENTITY_TYPE(Type) {\
+                PROFILE_ZONE(#Type);\
+                const EntityCostMark cost_mark = mark_entity_cost(level);\
+                integrate_moves_of_type(level, entity_type_id(Type), delta_time);\
+                if(!update_entities_in_parallel(level, entity_type_id(Type), input, delta_time)) {\
+                    for_entity_type(level, Type, entity) {\
+                        maybe_update_entity(entity);\
+                    }\
+                }\
+                add_entity_update_cost(level, entity_type_id(Type), cost_mark);\
+            }
                 ENTITY_TYPES;
 #undef ENTITY_TYPE
             };
 
             if(level->pause_state != PAUSED) {
                 update_entities_in_defined_order();
+                update_level_effects(level, delta_time);
 
                 // Update level time
                 if(!level->disable_level_timer && level->update_level_time) {
@@ -218,7 +622,9 @@ void update_level(Level *level, SimInput input, Game *game, float64_t delta_time
                     for(int32_t idx = 0; idx < level->no_paused_entities_count; ++idx) {
                         Entity *entity = level->no_paused_entities[idx];
                         if(entity->update_proc) {
+                            const EntityCostMark cost_mark = mark_entity_cost(level);
                             maybe_update_entity(entity);
+                            add_entity_update_cost(level, entity->entity_type_id, cost_mark);
                         }
                     }
                 }
@@ -244,17 +650,17 @@ void update_level(Level *level, SimInput input, Game *game, float64_t delta_time
         } break;
 
         case FINISHING_LEVEL: {
-#define update_entities_of_type(Type) { for_entity_type(level, Type, _entity) { maybe_update_entity(_entity); } }
+#define update_entities_of_type(Type) {\
+                const EntityCostMark cost_mark = mark_entity_cost(level);\
+                for_entity_type(level, Type, _entity) { maybe_update_entity(_entity); }\
+                add_entity_update_cost(level, entity_type_id(Type), cost_mark);\
+            }
 
             // Keep updating those entities...
             update_entities_of_type(FlagPole);
             update_entities_of_type(Coin);
-            update_entities_of_type(FloatingText);
-            update_entities_of_type(CoinDropAnim);
-            update_entities_of_type(TimedSprite);
-            update_entities_of_type(EnemyFallAnim);
-            update_entities_of_type(TileBreakAnim);
             update_entities_of_type(Tilemap);
+            update_level_effects(level, delta_time);
 
             switch(level->finishing_level_stage) {
                 case 0: /* Points for collected coins */ {
@@ -339,23 +745,37 @@ void update_level(Level *level, SimInput input, Game *game, float64_t delta_time
 
     // Wake up entities
     recalculate_wake_up_rect(level);
-    for_every_entity(level, entity) {
-        if(!(entity->entity_flags & E_FLAG_SLEEPS_UNTIL_AWAKEN && entity->is_asleep) || entity->has_collider == NULL) {
-            continue;
-        }
-
-        if(aabb(entity->position + entity->has_collider->offset, entity->has_collider->size, level->wake_up_rect_position, level->wake_up_rect_size)) {
-            entity->is_asleep = false;
-        }
-    }
+    update_level_stream(level);
+    wake_up_entities(level);
+    put_far_entities_to_sleep(level);
 }
 
 void render_level(Level *level) {
+    PROFILE_FUNCTION();
+
+    // In order of creation, entities with the same z are layered by it. The cost is added up over runs of the same type.
+    int32_t run_type_id = -1;
+    EntityCostMark run_mark = { };
     for_every_entity(level, e) {
-        if(e->render_proc != NULL && is_entity_used(e)) {
-            e->render_proc(e);
+        if(e->render_proc == NULL || !is_entity_used(e)) {
+            continue;
         }
+
+        if(e->entity_type_id != run_type_id) {
+            const EntityCostMark mark = mark_entity_cost(level);
+            if(run_type_id != -1) {
+                add_entity_render_cost(level, run_type_id, run_mark);
+            }
+            run_type_id = e->entity_type_id;
+            run_mark = mark;
+        }
+        e->render_proc(e);
     }
+    if(run_type_id != -1) {
+        add_entity_render_cost(level, run_type_id, run_mark);
+    }
+
+    render_level_effects(level);
 }
 
 void set_level_music_and_play(Level *level, ELevelMusic music) {
@@ -414,10 +834,16 @@ void unpause_level(Level *level) {
 }
 
 void add_points(Level *level, int32_t points) {
+    if(defer_add_points(level, points)) {
+        return;
+    }
     level->points_aquired_this_frame += points;
 }
 
 void add_coins(Level *level, int32_t coins) {
+    if(defer_add_coins(level, coins)) {
+        return;
+    }
     level->coins_collected_this_frame += coins;
 }
 
@@ -433,8 +859,7 @@ void add_points_with_text_above_entity(Level *level, int32_t points, Entity *ent
         entity->position.y + entity->has_collider->offset.y + entity->has_collider->size.y + 16 
     };
 
-    auto f_text = spawn_floating_text_number(level, text_position, points);
-    f_text->render_centered = true;
+    spawn_floating_text_number(level, text_position, points, true);
 }
 
 void render_level_debug_stuff(Level *level) {
@@ -532,7 +957,7 @@ void render_level_debug_stuff(Level *level) {
         for(int32_t y_tile = 0; y_tile < tilemap->y_tiles; ++y_tile) {
             for(int32_t x_tile = 0; x_tile < tilemap->x_tiles; ++x_tile) {
                 Tile *tile = tilemap->get_tile(x_tile, y_tile);
-                if(tile != NULL && (tile->tile_desc.tile_flags & TILE_FLAG_IS_INVISIBLE || tile->tile_desc.tile_flags & TILE_FLAG_NO_RENDER)) {
+                if(tile != NULL && (tile->get_desc().tile_flags & TILE_FLAG_IS_INVISIBLE || tile->get_desc().tile_flags & TILE_FLAG_NO_RENDER)) {
                     const auto ti = tile->get_ti();
                     render::r_quad_marching_ants(ti.position, -10, TILE_SIZE_2, 8, { 1.0f, 1.0f, 1.0f, 0.8f }, level->elapsed_time);
                     render::r_sprite(ti.position, -8, TILE_SIZE_2, global_data::get_sprite(SPRITE_BLOCK_QUESTION_1), { 1.0f, 1.0f, 1.0f, 0.4f });
@@ -4,11 +4,14 @@
 #include "common.h"
 #include "entity.h"
 
-#define LEVEL_MEMORY_TO_ALLOC MB(8)
+#define LEVEL_MEMORY_CHUNK_SIZE KB(64)     // Level memory grows by chunks of this size, bigger allocations get a chunk of their own
+#define LEVEL_MEMORY_MAX_POOLED_CHUNKS 256 // Released chunks kept around for reuse by other levels
 
-#define for_every_entity(level, var_name)      for(Entity *var_name = (level)->entities.first; var_name != NULL; (var_name) = (var_name)->next)
-#define for_entity_type(level, Type, var_name) for(Type *var_name = (level)->entities.first_of_type[entity_type_id(Type)]->as<Type>(); var_name != NULL; (var_name) = (var_name)->next_of_type->as<Type>())
-#define for_entity_type_id(level, type_id, var_name) for(Entity *var_name = (level)->entities.first_of_type[type_id]; var_name != NULL; (var_name) = (var_name)->next_of_type)
+#define for_every_entity(level, var_name)      for(Entity *var_name = (level)->entities.first; var_name != NULL; (var_name) = (var_name)->next) // In order of creation
+#define for_every_entity_by_type(level, var_name) for(EntitySlabIterator _iter_##var_name = iterate_slabs((level)->slabs, entity_type_count()); Entity *var_name = _iter_##var_name.next(); ) // Faster, when the order doesn't matter
+#define for_entity_type(level, Type, var_name) for(EntitySlabIterator _iter_##var_name = iterate_slabs(&(level)->slabs[entity_type_id(Type)], 1); Type *var_name = (Type *)_iter_##var_name.next(); )
+#define for_entity_type_id(level, type_id, var_name) for(EntitySlabIterator _iter_##var_name = iterate_slabs(&(level)->slabs[type_id], 1); Entity *var_name = _iter_##var_name.next(); )
+#define first_entity_of_type(level, Type) ((Type *)iterate_slabs(&(level)->slabs[entity_type_id(Type)], 1).next())
 
 #define TILE_SIZE 16
 #define TILE_SIZE_2 (vec2i{ TILE_SIZE, TILE_SIZE })
@@ -53,14 +56,80 @@ enum class ELevelMusic : int32_t {
     __NOT_SET
 };
 
+struct alignas(16) LevelMemoryChunk {
+    LevelMemoryChunk *next;
+    size_t size; // Bytes after the header
+    size_t used;
+
+    inline uint8_t *data(void) { return (uint8_t *)(this + 1); }
+};
+
+struct LevelMemoryPoolStats {
+    int32_t chunks_allocated; // Standard sized chunks, either in use by levels or pooled
+    int32_t chunks_pooled;
+};
+
+struct SleepingEntity {
+    int32_t  x;         // Left edge of the collider
+    int32_t  width;
+    uint32_t unique_id; // The slot could've been reused by another entity since
+    Entity  *entity;
+};
+
+// Sleeping entities sorted by x, the cursors follow the wake up rect so only the ones in its x range get tested
+struct WakeUpSweep {
+    std::vector<SleepingEntity> sleepers; // Woken ones get their entity set to NULL
+    std::vector<SleepingEntity> awake;    // Woken sleepers, these go back to sleep when too far from the wake up rect
+    int32_t begin;       // First sleeper that can overlap the wake up rect
+    int32_t end;         // First sleeper past the right edge of the wake up rect
+    int32_t max_width;   // Widest collider, how far left of the rect a sleeper can start and still overlap it
+    int32_t woken_count; // Entries that aren't asleep anymore, the array is rebuilt when there's too many
+    int32_t tested_last_frame;
+    bool    dirty;       // Rebuilt before the next wake up pass
+};
+
+struct Tilemap;
+
+#define TILE_INDEX_CELL_TILES   16 // Cell side in tiles
+#define TILE_INDEX_MAX_TILEMAPS 64 // Bits in a cell mask, with more tilemaps every query returns all of them
+
+// Coarse grid over the tile bounds of the level's tilemaps, each cell has a bit set for every tilemap overlapping it
+struct TileIndex {
+    std::vector<Tilemap *> tilemaps; // In slab order, bit index of the cell masks
+    std::vector<uint64_t>  cells;
+    vec2i   origin_cell;
+    int32_t x_cells;
+    int32_t y_cells;
+    bool    dirty; // Rebuilt on the next query
+};
+
+struct CameraRegion;
+
+// Camera regions sorted by left edge, the running max of the right edges bounds where the overlap search has to start
+struct CameraRegionIndex {
+    std::vector<CameraRegion *> regions; // By position.x, slab order when equal
+    std::vector<int32_t> slab_order;     // Overlapping regions resolve to the first one in slab order
+    std::vector<int32_t> max_right;      // Furthest right edge of regions[0..idx]
+    CameraRegion *current;               // Region of current_region_unique_id, kept while the player overlaps it
+    int32_t tested_last_frame;
+    bool    dirty; // Rebuilt on the next query
+};
+
+struct LevelStream;
+struct LevelEffects;
+
 struct Level {
-    uint8_t *memory;
-    size_t   memory_size;
-    size_t   memory_used;
+    LevelMemoryChunk *first_chunk;
+    LevelMemoryChunk *last_chunk;
+    int32_t memory_chunk_count;
+    size_t  memory_size;       // Sum of chunk sizes
+    size_t  memory_used;       // Handed out of the chunks, doesn't go down because unused entities are kept for reuse
+    size_t  memory_in_use;     // Used by entities in use
+    size_t  memory_high_water; // Peak of memory_in_use
 
     int32_t next_entity_id;
     EntityPool entities;
-    EntityPool entities_unused;
+    EntitySlab slabs[entity_type_count()];
     std::vector<Entity *> *to_be_deleted; // Entities that will be deleted at the end of frame, ptr because of new kw
 
 #define MAX_NO_PAUSED_ENTITIES 32
@@ -70,6 +139,7 @@ struct Level {
     
     RenderView render_view;
     uint32_t   current_region_unique_id;
+    CameraRegionIndex *camera_region_index; // ptr because of new kw
 
     // Level music
     ELevelMusic current_level_music;
@@ -95,6 +165,19 @@ struct Level {
     // Wake up rect
     vec2i wake_up_rect_position;
     vec2i wake_up_rect_size;
+    WakeUpSweep *wake_up_sweep; // ptr because of new kw
+    int32_t sleep_margin; // Grounded sleepers this far outside of the wake up rect go back to sleep, 0 keeps them awake
+
+    TileIndex *tile_index; // ptr because of new kw
+    LevelEffects *effects; // Short-lived visual effects, kept out of the entities
+
+    // Level sections
+    bool stream_sections; // Saved with the level, the game loads it in sections
+    LevelStream *stream;  // NULL unless the level was loaded in sections
+
+    // Last update
+    int32_t active_entity_count;  // Entities that got their update proc called
+    int32_t dormant_entity_count; // Skipped because asleep
     
     // Level score
     bool      disable_level_timer;
@@ -103,9 +186,17 @@ struct Level {
     int32_t   level_time;
 };
 
+void *alloc_level_memory(Level *level, size_t bytes); // Not zeroed
+LevelMemoryPoolStats get_level_memory_pool_stats(void);
+
 Level *create_empty_level(void);
 void recreate_empty_level(Level **level);
 void delete_level(Level *level);
+
+// Copies the whole level (arena, entity lists, level state) so a freshly loaded level can be kept as a pristine image and restarted from
+Level *clone_level(Level *source);
+void recreate_level_from_clone(Level **level, Level *source); // Reuses the level if it already exists
+
 void update_level(Level *level, SimInput input, struct Game *game, float64_t delta_time);
 void render_level(Level *level);
 
@@ -0,0 +1,452 @@
+#include "level_effects.h"
+#include "data.h"
+#include "all_entities.h"
+#include "profiler.h"
+#include "memory_tags.h"
+
+#include <SDL.h>
+
+namespace {
+    constexpr float32_t enemy_fall_anim_time    = 3.0f;
+    constexpr float32_t enemy_fall_anim_x_speed = 50.0f;
+    constexpr float32_t enemy_fall_anim_y_speed = 120.0f;
+    constexpr float32_t enemy_fall_anim_gravity = 400.0f;
+
+    constexpr float32_t floating_text_duration = 4.0f;
+    constexpr int32_t   floating_text_distance = 64;
+
+    constexpr float32_t tile_break_anim_gravity = 280.0f;
+    constexpr float32_t tile_break_anim_time    = 3.0f;
+
+    constexpr float32_t coin_drop_anim_time = 0.75f;
+    constexpr int32_t   coin_drop_anim_dist = 64;
+
+    AnimSet tile_break_anim_sets[TILE_BREAK_ANIM__COUNT];
+    AnimSet anim_set_coin_drop;
+}
+
+LevelEffects *create_level_effects(void) {
+    return tagged_malloc_and_zero_struct(MEMORY_TAG_LEVEL, LevelEffects);
+}
+
+void copy_level_effects(LevelEffects *effects, LevelEffects *source) {
+    memcpy(effects, source, sizeof(LevelEffects));
+}
+
+void delete_level_effects(LevelEffects *effects) {
+    tagged_free(effects); // NULL is fine
+}
+
+// Index of the new entry, -1 if the pool is full
+static
+int32_t acquire_effect_slot(LevelEffects *effects, int32_t *count, int32_t capacity) {
+    if(*count == capacity) {
+        effects->dropped += 1;
+        return -1;
+    }
+    return (*count)++;
+}
+
+// Removing moves the last entry into the slot, so the loops don't advance after a removal
+static
+void remove_timed_sprite(TimedSprites *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx] = pool->position[last];
+    pool->sprite[idx]   = pool->sprite[last];
+    pool->z_pos[idx]    = pool->z_pos[last];
+    pool->timer[idx]    = pool->timer[last];
+    pool->duration[idx] = pool->duration[last];
+}
+
+static
+void remove_timed_anim(TimedAnims *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx]     = pool->position[last];
+    pool->centered[idx]     = pool->centered[last];
+    pool->loops[idx]        = pool->loops[last];
+    pool->loops_passed[idx] = pool->loops_passed[last];
+    pool->timer[idx]        = pool->timer[last];
+    pool->life_time[idx]    = pool->life_time[last];
+    pool->anim_player[idx]  = pool->anim_player[last];
+}
+
+static
+void remove_enemy_fall_anim(EnemyFallAnims *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx] = pool->position[last];
+    pool->sprite[idx]   = pool->sprite[last];
+    pool->timer[idx]    = pool->timer[last];
+    pool->speed[idx]    = pool->speed[last];
+    pool->offset[idx]   = pool->offset[last];
+}
+
+static
+void remove_floating_text(FloatingTexts *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx] = pool->position[last];
+    pool->centered[idx] = pool->centered[last];
+    pool->timer[idx]    = pool->timer[last];
+    memcpy(pool->text[idx], pool->text[last], sizeof(pool->text[idx]));
+}
+
+static
+void remove_tile_break_anim(TileBreakAnims *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx]    = pool->position[last];
+    pool->timer[idx]       = pool->timer[last];
+    pool->speed_top[idx]   = pool->speed_top[last];
+    pool->speed_bot[idx]   = pool->speed_bot[last];
+    pool->offset_top[idx]  = pool->offset_top[last];
+    pool->offset_bot[idx]  = pool->offset_bot[last];
+    pool->anim_player[idx] = pool->anim_player[last];
+}
+
+static
+void remove_coin_drop_anim(CoinDropAnims *pool, int32_t idx) {
+    const int32_t last = --pool->count;
+    pool->position[idx]    = pool->position[last];
+    pool->timer[idx]       = pool->timer[last];
+    pool->anim_player[idx] = pool->anim_player[last];
+}
+
+void spawn_timed_sprite(Level *level, vec2i position, float32_t duration, Sprite sprite, int32_t z_pos) {
+    assert(sprite.texture != NULL);
+    assert(duration > 0.0f);
+
+    TimedSprites *pool = &level->effects->timed_sprites;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    pool->position[idx] = position;
+    pool->sprite[idx]   = sprite;
+    pool->z_pos[idx]    = z_pos;
+    pool->timer[idx]    = 0.0f;
+    pool->duration[idx] = duration;
+}
+
+static
+void spawn_timed_anim(Level *level, vec2i position, AnimSet *anim_set, bool centered, int32_t loops, float32_t life_time) {
+    assert(anim_set != NULL && anim_set->frame_count > 1);
+
+    TimedAnims *pool = &level->effects->timed_anims;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    pool->position[idx]     = position;
+    pool->centered[idx]     = centered;
+    pool->loops[idx]        = loops;
+    pool->loops_passed[idx] = 0;
+    pool->timer[idx]        = 0.0f;
+    pool->life_time[idx]    = life_time;
+    pool->anim_player[idx]  = init_anim_player(anim_set);
+}
+
+void spawn_timed_anim(Level *level, vec2i position, AnimSet *anim_set, bool centered) {
+    spawn_timed_anim(level, position, anim_set, centered, 1, 0.0f);
+}
+
+void spawn_timed_anim_loops(Level *level, vec2i position, AnimSet *anim_set, int32_t loops, bool centered) {
+    spawn_timed_anim(level, position, anim_set, centered, max_value(loops, 1), 0.0f);
+}
+
+void spawn_timed_anim_timer(Level *level, vec2i position, AnimSet *anim_set, float32_t life_time, bool centered) {
+    spawn_timed_anim(level, position, anim_set, centered, 0, life_time);
+}
+
+void spawn_enemy_fall_anim(Level *level, vec2i position, int32_t dir, Sprite sprite) {
+    EnemyFallAnims *pool = &level->effects->enemy_fall_anims;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    pool->position[idx] = position;
+    pool->sprite[idx]   = sprite;
+    pool->timer[idx]    = 0.0f;
+    pool->speed[idx]    = { enemy_fall_anim_x_speed * sign(dir), enemy_fall_anim_y_speed };
+    pool->offset[idx]   = { 0.0f, 0.0f };
+}
+
+void spawn_floating_text(Level *level, vec2i position, const char *text, bool centered) {
+    FloatingTexts *pool = &level->effects->floating_texts;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    strcpy_s(pool->text[idx], FLOATING_TEXT_MAX_LENGTH * sizeof(char), text);
+    pool->centered[idx] = centered;
+    pool->timer[idx]    = 0.0f;
+
+    // Moved down until it doesn't overlap the other texts
+    const auto font = global_data::get_small_font();
+    const int32_t max_loops = 6;
+    int32_t loops = 0;
+    do {
+        bool collides = false;
+
+        const vec2i size = { (int32_t)font->calc_string_width(pool->text[idx]), font->height };
+        for(int32_t other = 0; other < pool->count; ++other) {
+            if(other == idx) continue;
+
+            const vec2i other_size = { (int32_t)font->calc_string_width(pool->text[other]), font->height };
+            if(aabb(position, size, pool->position[other], other_size)) {
+                collides = true;
+                break;
+            }
+        }
+
+        if(collides) {
+            position.y -= font->height;
+        } else {
+            break;
+        }
+
+        loops += 1;
+    } while(loops < max_loops);
+
+    pool->position[idx] = position;
+}
+
+void spawn_floating_text_number(Level *level, vec2i position, int32_t number, bool centered) {
+    char text[FLOATING_TEXT_MAX_LENGTH];
+    sprintf_s(text, array_count(text), "%d", number);
+    spawn_floating_text(level, position, text, centered);
+}
+
+void spawn_tile_break_anim(Level *level, TileInfo ti, ETileBreakAnim tile_break_anim) {
+    TileBreakAnims *pool = &level->effects->tile_break_anims;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    pool->position[idx]    = ti.position;
+    pool->timer[idx]       = 0.0f;
+    pool->speed_top[idx]   = { 40.0f, 140.0f };
+    pool->speed_bot[idx]   = { 35.0f, 110.0f };
+    pool->offset_top[idx]  = { 0.0f,  0.0f };
+    pool->offset_bot[idx]  = { 0.0f,  0.0f };
+    pool->anim_player[idx] = init_anim_player(&tile_break_anim_sets[(int32_t)tile_break_anim]);
+}
+
+void spawn_coin_drop_anim(Level *level, TileInfo ti) {
+    CoinDropAnims *pool = &level->effects->coin_drop_anims;
+    const int32_t idx = acquire_effect_slot(level->effects, &pool->count, pool->capacity);
+    if(idx < 0) {
+        return;
+    }
+
+    pool->position[idx]    = ti.position + vec2i{ 0, 5 };
+    pool->timer[idx]       = 0.0f;
+    pool->anim_player[idx] = init_anim_player(&anim_set_coin_drop);
+}
+
+void update_level_effects(Level *level, float64_t delta_time) {
+    PROFILE_FUNCTION();
+    const uint64_t start = SDL_GetPerformanceCounter();
+    LevelEffects *effects = level->effects;
+
+    /* Timed sprites */ {
+        TimedSprites *pool = &effects->timed_sprites;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            pool->timer[idx] += delta_time;
+            if(pool->timer[idx] >= pool->duration[idx]) {
+                remove_timed_sprite(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    /* Timed anims */ {
+        TimedAnims *pool = &effects->timed_anims;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            bool done;
+            if(pool->loops[idx] > 0) {
+                const int32_t last_frame_id = pool->anim_player[idx].frame_id;
+                update_anim(&pool->anim_player[idx], delta_time);
+                if(last_frame_id > 0 && pool->anim_player[idx].frame_id == 0) { // looped
+                    pool->loops_passed[idx] += 1;
+                }
+                done = pool->loops_passed[idx] >= pool->loops[idx];
+            } else {
+                update_anim(&pool->anim_player[idx], delta_time);
+                pool->timer[idx] += delta_time;
+                done = pool->timer[idx] >= pool->life_time[idx];
+            }
+
+            if(done) {
+                remove_timed_anim(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    /* Enemy fall anims */ {
+        EnemyFallAnims *pool = &effects->enemy_fall_anims;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            pool->timer[idx]    += delta_time;
+            pool->speed[idx].y  -= enemy_fall_anim_gravity * delta_time;
+            pool->offset[idx].x += pool->speed[idx].x * delta_time;
+            pool->offset[idx].y += pool->speed[idx].y * delta_time;
+
+            if(pool->timer[idx] >= enemy_fall_anim_time) {
+                remove_enemy_fall_anim(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    /* Floating texts */ {
+        FloatingTexts *pool = &effects->floating_texts;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            if((pool->timer[idx] += delta_time) >= floating_text_duration) {
+                remove_floating_text(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    /* Tile break anims */ {
+        TileBreakAnims *pool = &effects->tile_break_anims;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            pool->timer[idx] += delta_time;
+            update_anim(&pool->anim_player[idx], delta_time);
+
+            pool->speed_top[idx].y -= tile_break_anim_gravity * delta_time;
+            pool->speed_bot[idx].y -= tile_break_anim_gravity * delta_time;
+            pool->offset_top[idx]  += pool->speed_top[idx] * delta_time;
+            pool->offset_bot[idx]  += pool->speed_bot[idx] * delta_time;
+
+            if(pool->timer[idx] >= tile_break_anim_time) {
+                remove_tile_break_anim(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    /* Coin drop anims */ {
+        CoinDropAnims *pool = &effects->coin_drop_anims;
+        for(int32_t idx = 0; idx < pool->count; ) {
+            pool->timer[idx] += delta_time;
+            update_anim(&pool->anim_player[idx], delta_time);
+
+            if(pool->timer[idx] >= coin_drop_anim_time) {
+                remove_coin_drop_anim(pool, idx);
+            } else {
+                idx += 1;
+            }
+        }
+    }
+
+    effects->update_time = (float64_t)(SDL_GetPerformanceCounter() - start) / (float64_t)SDL_GetPerformanceFrequency();
+}
+
+void render_level_effects(Level *level) {
+    PROFILE_FUNCTION();
+    const uint64_t start = SDL_GetPerformanceCounter();
+    LevelEffects *effects = level->effects;
+
+    /* Timed sprites */ {
+        TimedSprites *pool = &effects->timed_sprites;
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            render::r_sprite(pool->position[idx], pool->z_pos[idx], { pool->sprite[idx].width, pool->sprite[idx].height }, pool->sprite[idx], color::white);
+        }
+    }
+
+    /* Timed anims */ {
+        TimedAnims *pool = &effects->timed_anims;
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            auto frame = get_current_frame(&pool->anim_player[idx]);
+            const vec2i position = pool->centered[idx] ? pool->position[idx] - frame->size() / 2 : pool->position[idx];
+            render::r_sprite(position, 0, frame->size(), frame->sprite, color::white);
+        }
+    }
+
+    /* Enemy fall anims */ {
+        EnemyFallAnims *pool = &effects->enemy_fall_anims;
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            const vec2i position = pool->position[idx] + vec2i{ (int32_t)roundf(pool->offset[idx].x), (int32_t)roundf(pool->offset[idx].y) };
+
+            render::r_set_flip_y_quads(1);
+            render::r_sprite(position, 0, { pool->sprite[idx].width, pool->sprite[idx].height }, pool->sprite[idx], color::white);
+        }
+    }
+
+    /* Floating texts */ {
+        FloatingTexts *pool = &effects->floating_texts;
+        auto font = global_data::get_small_font();
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            const float32_t perc = pool->timer[idx] / floating_text_duration;
+            const vec2i position = {
+                pool->position[idx].x - (pool->centered[idx] ? (int32_t)roundf(font->calc_string_width(pool->text[idx])) / 2 : 0),
+                pool->position[idx].y + (int32_t)roundf(perc * floating_text_distance)
+            };
+            render::r_text(position, Z_FLOATING_TEXT_POS, pool->text[idx], font);
+        }
+    }
+
+    /* Tile break anims */ {
+        TileBreakAnims *pool = &effects->tile_break_anims;
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            auto frame = get_current_frame(&pool->anim_player[idx]);
+            const vec2i size = frame->size();
+
+            const vec2i offset_bot_l = vec2i::make(pool->offset_bot[idx]) * vec2i { -1, 1 } + vec2i { -size.x, 0 };
+            const vec2i offset_top_l = vec2i::make(pool->offset_top[idx]) * vec2i { -1, 1 } + vec2i { -size.x, size.y };
+            const vec2i offset_bot_r = vec2i::make(pool->offset_bot[idx]) + vec2i { size.x, 0 };
+            const vec2i offset_top_r = vec2i::make(pool->offset_top[idx]) + vec2i { size.x, size.y };
+
+            render::r_set_flip_x_quads(2);
+            render::r_sprite(pool->position[idx] + offset_bot_l, 0, size, frame->sprite, color::white);
+            render::r_sprite(pool->position[idx] + offset_top_l, 0, size, frame->sprite, color::white);
+            render::r_sprite(pool->position[idx] + offset_bot_r, 0, size, frame->sprite, color::white);
+            render::r_sprite(pool->position[idx] + offset_top_r, 0, size, frame->sprite, color::white);
+        }
+    }
+
+    /* Coin drop anims */ {
+        CoinDropAnims *pool = &effects->coin_drop_anims;
+        for(int32_t idx = 0; idx < pool->count; ++idx) {
+            auto frame = get_current_frame(&pool->anim_player[idx]);
+            const float32_t perc = pool->timer[idx] / coin_drop_anim_time;
+            const vec2i position_offset = { 0, (int32_t)roundf(sinf(square(perc) * M_PI) * coin_drop_anim_dist) };
+            render::r_sprite(pool->position[idx] + position_offset, Z_TILEMAP_POS + 5, frame->size(), frame->sprite, color::white);
+        }
+    }
+
+    effects->render_time = (float64_t)(SDL_GetPerformanceCounter() - start) / (float64_t)SDL_GetPerformanceFrequency();
+}
+
+void init_level_effects_common_data(void) {
+    AnimSet *set = NULL;
+
+    set = &tile_break_anim_sets[TILE_BREAK_ANIM_BRICK];
+    init_anim_set(set);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_1), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_2), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_3), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_BRICK_PARTICLE_4), 0.2f);
+
+    set = &tile_break_anim_sets[TILE_BREAK_ANIM_BRICK_UG];
+    init_anim_set(set);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_1), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_2), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_3), 0.2f);
+    next_anim_frame(set, global_data::get_sprite(SPRITE_UG_BRICK_PARTICLE_4), 0.2f);
+
+    init_anim_set(&anim_set_coin_drop);
+    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_1), 0.1f);
+    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_2), 0.1f);
+    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_3), 0.1f);
+    next_anim_frame(&anim_set_coin_drop, global_data::get_sprite(SPRITE_COIN_4), 0.1f);
+}
@@ -0,0 +1,118 @@
+#ifndef _LEVEL_EFFECTS_H
+#define _LEVEL_EFFECTS_H
+
+#include "common.h"
+#include "level.h"
+#include "renderer.h"
+
+// Short-lived visual effects, these don't interact with anything so they're kept out of the entities.
+// Every kind has a fixed size pool stored as arrays of fields, spawning into a full pool drops the effect.
+
+enum ETileBreakAnim : int32_t;
+
+#define MAX_TIMED_SPRITES     16
+#define MAX_TIMED_ANIMS       32
+#define MAX_ENEMY_FALL_ANIMS  16
+#define MAX_FLOATING_TEXTS    16
+#define MAX_TILE_BREAK_ANIMS  16
+#define MAX_COIN_DROP_ANIMS   16
+#define FLOATING_TEXT_MAX_LENGTH 32
+
+struct TimedSprites {
+    static const int32_t capacity = MAX_TIMED_SPRITES;
+    int32_t   count;
+    vec2i     position[MAX_TIMED_SPRITES];
+    Sprite    sprite[MAX_TIMED_SPRITES];
+    int32_t   z_pos[MAX_TIMED_SPRITES];
+    float32_t timer[MAX_TIMED_SPRITES];
+    float32_t duration[MAX_TIMED_SPRITES];
+};
+
+struct TimedAnims {
+    static const int32_t capacity = MAX_TIMED_ANIMS;
+    int32_t    count;
+    vec2i      position[MAX_TIMED_ANIMS];
+    bool       centered[MAX_TIMED_ANIMS];
+    int32_t    loops[MAX_TIMED_ANIMS];        // 0 if it has a life time instead
+    int32_t    loops_passed[MAX_TIMED_ANIMS];
+    float32_t  timer[MAX_TIMED_ANIMS];
+    float32_t  life_time[MAX_TIMED_ANIMS];
+    AnimPlayer anim_player[MAX_TIMED_ANIMS]; // The anim set needs to be valid until the effect ends
+};
+
+struct EnemyFallAnims {
+    static const int32_t capacity = MAX_ENEMY_FALL_ANIMS;
+    int32_t   count;
+    vec2i     position[MAX_ENEMY_FALL_ANIMS];
+    Sprite    sprite[MAX_ENEMY_FALL_ANIMS];
+    float32_t timer[MAX_ENEMY_FALL_ANIMS];
+    vec2      speed[MAX_ENEMY_FALL_ANIMS];
+    vec2      offset[MAX_ENEMY_FALL_ANIMS];
+};
+
+struct FloatingTexts {
+    static const int32_t capacity = MAX_FLOATING_TEXTS;
+    int32_t   count;
+    vec2i     position[MAX_FLOATING_TEXTS];
+    bool      centered[MAX_FLOATING_TEXTS];
+    float32_t timer[MAX_FLOATING_TEXTS];
+    char      text[MAX_FLOATING_TEXTS][FLOATING_TEXT_MAX_LENGTH];
+};
+
+struct TileBreakAnims {
+    static const int32_t capacity = MAX_TILE_BREAK_ANIMS;
+    int32_t    count;
+    vec2i      position[MAX_TILE_BREAK_ANIMS];
+    float32_t  timer[MAX_TILE_BREAK_ANIMS];
+    vec2       speed_top[MAX_TILE_BREAK_ANIMS];
+    vec2       speed_bot[MAX_TILE_BREAK_ANIMS];
+    vec2       offset_top[MAX_TILE_BREAK_ANIMS];
+    vec2       offset_bot[MAX_TILE_BREAK_ANIMS];
+    AnimPlayer anim_player[MAX_TILE_BREAK_ANIMS];
+};
+
+struct CoinDropAnims {
+    static const int32_t capacity = MAX_COIN_DROP_ANIMS;
+    int32_t    count;
+    vec2i      position[MAX_COIN_DROP_ANIMS];
+    float32_t  timer[MAX_COIN_DROP_ANIMS];
+    AnimPlayer anim_player[MAX_COIN_DROP_ANIMS];
+};
+
+#define EFFECT_POOLS\
+    EFFECT_POOL(TimedSprites,   timed_sprites)\
+    EFFECT_POOL(TimedAnims,     timed_anims)\
+    EFFECT_POOL(EnemyFallAnims, enemy_fall_anims)\
+    EFFECT_POOL(FloatingTexts,  floating_texts)\
+    EFFECT_POOL(TileBreakAnims, tile_break_anims)\
+    EFFECT_POOL(CoinDropAnims,  coin_drop_anims)
+
+// Plain data, a copy of the level copies it as is
+struct LevelEffects {
+#define EFFECT_POOL(Type, name) Type name;
+    EFFECT_POOLS
+#undef EFFECT_POOL
+
+    int32_t   dropped;     // Spawns into full pools
+    float64_t update_time; // Last update, in seconds
+    float64_t render_time; // Last render, in seconds
+};
+
+LevelEffects *create_level_effects(void);
+void copy_level_effects(LevelEffects *effects, LevelEffects *source);
+void delete_level_effects(LevelEffects *effects);
+
+void update_level_effects(Level *level, float64_t delta_time);
+void render_level_effects(Level *level);
+
+void spawn_timed_sprite(Level *level, vec2i position, float32_t duration, Sprite sprite, int32_t z_pos = 0);
+void spawn_timed_anim(Level *level, vec2i position, AnimSet *anim_set, bool centered = false); // Plays once
+void spawn_timed_anim_loops(Level *level, vec2i position, AnimSet *anim_set, int32_t loops, bool centered = false);
+void spawn_timed_anim_timer(Level *level, vec2i position, AnimSet *anim_set, float32_t life_time, bool centered = false);
+void spawn_enemy_fall_anim(Level *level, vec2i position, int32_t dir, Sprite sprite);
+void spawn_floating_text(Level *level, vec2i position, const char *text, bool centered = false);
+void spawn_floating_text_number(Level *level, vec2i position, int32_t number, bool centered = false);
+void spawn_tile_break_anim(Level *level, TileInfo ti, ETileBreakAnim tile_break_anim);
+void spawn_coin_drop_anim(Level *level, TileInfo ti);
+
+#endif /* _LEVEL_EFFECTS_H */
@@ -0,0 +1,223 @@
+#include "level_loader.h"
+#include "save_data.h"
+#include "profiler.h"
+
+#include <SDL.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace {
+    enum class ELoadState {
+        QUEUED,
+        LOADING,
+        LOADED
+    };
+
+    struct LoadEntry {
+        ELoadState state;
+        uint32_t   request_id; // Result of a load is thrown away if the entry was evicted or requested again in the meantime
+        Level     *level;
+    };
+}
+
+struct LevelLoader {
+    std::thread             worker;
+    mutable std::mutex      mutex;
+    std::condition_variable work_cv;   // Worker waits for requests
+    std::condition_variable loaded_cv; // get_loaded_level waits for the worker to finish
+    std::deque<std::string> queue;
+    std::unordered_map<std::string, LoadEntry> entries;
+    bool      quit;
+    uint32_t  next_request_id;
+    float64_t last_load_time;
+};
+
+static Level *load_pristine_level(const std::string &level_path, float64_t *out_load_time) {
+    const uint64_t start = SDL_GetPerformanceCounter();
+
+    Level *level = create_empty_level();
+    load_level(level, level_path.c_str(), NULL, true);
+
+    *out_load_time = (float64_t)(SDL_GetPerformanceCounter() - start) / (float64_t)SDL_GetPerformanceFrequency();
+    return level;
+}
+
+// Called with the mutex locked
+static void finish_loading(LevelLoader *loader, const std::string &level_path, uint32_t request_id, Level *level, float64_t load_time) {
+    loader->last_load_time = load_time;
+
+    auto found = loader->entries.find(level_path);
+    if(found == loader->entries.end() || found->second.request_id != request_id) {
+        delete_level(level);
+    } else {
+        found->second.state = ELoadState::LOADED;
+        found->second.level = level;
+    }
+    loader->loaded_cv.notify_all();
+}
+
+static void level_loader_worker(LevelLoader *loader) {
+    set_profiler_thread_name("level loader");
+
+    std::unique_lock<std::mutex> lock(loader->mutex);
+    for(;;) {
+        loader->work_cv.wait(lock, [loader] { return loader->quit || !loader->queue.empty(); });
+        if(loader->quit) {
+            break;
+        }
+
+        std::string level_path = loader->queue.front();
+        loader->queue.pop_front();
+        LoadEntry *entry = &loader->entries[level_path];
+        entry->state = ELoadState::LOADING;
+        const uint32_t request_id = entry->request_id;
+
+        lock.unlock();
+        float64_t load_time;
+        Level *level = load_pristine_level(level_path, &load_time);
+        lock.lock();
+
+        finish_loading(loader, level_path, request_id, level, load_time);
+    }
+}
+
+LevelLoader *create_level_loader(void) {
+    LevelLoader *loader = new LevelLoader();
+    loader->quit = false;
+    loader->next_request_id = 1;
+    loader->last_load_time = 0.0;
+    loader->worker = std::thread(level_loader_worker, loader);
+    return loader;
+}
+
+void delete_level_loader(LevelLoader *loader) {
+    if(loader == NULL) {
+        return;
+    }
+
+    /* Stop the worker */ {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->quit = true;
+        loader->queue.clear();
+    }
+    loader->work_cv.notify_all();
+    loader->worker.join();
+
+    for(auto &entry : loader->entries) {
+        if(entry.second.state == ELoadState::LOADED) {
+            delete_level(entry.second.level);
+        }
+    }
+    delete loader;
+}
+
+void prefetch_level(LevelLoader *loader, const std::string &level_path) {
+    /* Queue */ {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+
+        if(loader->entries.find(level_path) != loader->entries.end()) {
+            return;
+        }
+
+        LoadEntry entry = { };
+        entry.state = ELoadState::QUEUED;
+        entry.request_id = loader->next_request_id++;
+        loader->entries[level_path] = entry;
+        loader->queue.push_back(level_path);
+    }
+    loader->work_cv.notify_one();
+}
+
+Level *get_loaded_level(LevelLoader *loader, const std::string &level_path) {
+    std::unique_lock<std::mutex> lock(loader->mutex);
+
+    auto found = loader->entries.find(level_path);
+    if(found == loader->entries.end() || found->second.state == ELoadState::QUEUED) {
+        // Don't wait in line behind other requests, load it here
+        if(found == loader->entries.end()) {
+            LoadEntry entry = { };
+            entry.request_id = loader->next_request_id++;
+            found = loader->entries.emplace(level_path, entry).first;
+        } else {
+            for(auto it = loader->queue.begin(); it != loader->queue.end(); ++it) {
+                if(*it == level_path) {
+                    loader->queue.erase(it);
+                    break;
+                }
+            }
+        }
+        found->second.state = ELoadState::LOADING;
+        const uint32_t request_id = found->second.request_id;
+
+        lock.unlock();
+        float64_t load_time;
+        Level *level = load_pristine_level(level_path, &load_time);
+        lock.lock();
+
+        finish_loading(loader, level_path, request_id, level, load_time);
+        return level;
+    }
+
+    loader->loaded_cv.wait(lock, [&] { return loader->entries[level_path].state == ELoadState::LOADED; });
+    return loader->entries[level_path].level;
+}
+
+Level *try_get_loaded_level(const LevelLoader *loader, const std::string &level_path) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+
+    auto found = loader->entries.find(level_path);
+    if(found == loader->entries.end() || found->second.state != ELoadState::LOADED) {
+        return NULL;
+    }
+    return found->second.level;
+}
+
+void evict_level(LevelLoader *loader, const std::string &level_path) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+
+    auto found = loader->entries.find(level_path);
+    if(found == loader->entries.end()) {
+        return;
+    }
+
+    switch(found->second.state) {
+        case ELoadState::QUEUED: {
+            for(auto it = loader->queue.begin(); it != loader->queue.end(); ++it) {
+                if(*it == level_path) {
+                    loader->queue.erase(it);
+                    break;
+                }
+            }
+            loader->entries.erase(found);
+        } break;
+
+        case ELoadState::LOADING: {
+            // The level is deleted when it's done, because the request id won't match anymore
+            loader->entries.erase(found);
+        } break;
+
+        case ELoadState::LOADED: {
+            delete_level(found->second.level);
+            loader->entries.erase(found);
+        } break;
+    }
+}
+
+LevelLoaderStats get_level_loader_stats(LevelLoader *loader) {
+    std::lock_guard<std::mutex> lock(loader->mutex);
+
+    LevelLoaderStats stats = { };
+    stats.last_load_time = loader->last_load_time;
+    for(auto &entry : loader->entries) {
+        if(entry.second.state == ELoadState::LOADED) {
+            stats.levels_loaded   += 1;
+            stats.memory_reserved += entry.second.level->memory_size;
+            stats.memory_used     += entry.second.level->memory_used;
+        } else {
+            stats.levels_pending += 1;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,28 @@
+#ifndef _LEVEL_LOADER_H
+#define _LEVEL_LOADER_H
+
+#include "common.h"
+#include "level.h"
+
+// Loads pristine levels from level files on a worker thread, levels are identified by the file path.
+// The loader owns the loaded levels until they are evicted, so they should only be cloned from.
+struct LevelLoader;
+
+struct LevelLoaderStats {
+    int32_t   levels_loaded;
+    int32_t   levels_pending;  // Queued or being loaded
+    size_t    memory_reserved; // Sum of loaded levels' memory_size
+    size_t    memory_used;     // Sum of loaded levels' memory_used
+    float64_t last_load_time;  // In seconds
+};
+
+LevelLoader *create_level_loader(void);
+void delete_level_loader(LevelLoader *loader); // Waits for the level currently being loaded
+
+void   prefetch_level(LevelLoader *loader, const std::string &level_path);       // Queues the level for the worker thread, does nothing if already loaded or queued
+Level *get_loaded_level(LevelLoader *loader, const std::string &level_path);     // Blocks until the level is loaded, loads it on the calling thread if it wasn't picked up by the worker yet
+Level *try_get_loaded_level(const LevelLoader *loader, const std::string &level_path); // Returns NULL if the level is not loaded yet
+void   evict_level(LevelLoader *loader, const std::string &level_path);
+LevelLoaderStats get_level_loader_stats(LevelLoader *loader);
+
+#endif /* _LEVEL_LOADER_H */
@@ -0,0 +1,180 @@
+#include "level_stream.h"
+#include "all_entities.h"
+#include "profiler.h"
+
+namespace {
+    // Past the wake up rect, so entities are in before they could wake up and stay around after going back to sleep
+    const int32_t section_load_margin   = LEVEL_SECTION_WIDTH / 2;
+    const int32_t section_retire_margin = LEVEL_SECTION_WIDTH / 2 + LEVEL_SECTION_WIDTH; // Bigger, so sections at the edge don't go in and out every frame
+}
+
+LevelStream *create_level_stream(void) {
+    LevelStream *stream = new LevelStream();
+    stream->resident_count = 0;
+    stream->stored_entity_count = 0;
+    stream->sections_loaded = 0;
+    stream->sections_retired = 0;
+    return stream;
+}
+
+// Only the section list is copied, the entities stay shared with the source
+LevelStream *clone_level_stream(LevelStream *source) {
+    if(source == NULL) {
+        return NULL;
+    }
+    return new LevelStream(*source);
+}
+
+void delete_level_stream(LevelStream *stream) {
+    if(stream != NULL) {
+        delete stream;
+    }
+}
+
+const SectionEntities &get_section_entities(const LevelSection *section) {
+    static const SectionEntities no_entities;
+    return section->entities != NULL ? *section->entities : no_entities;
+}
+
+SectionEntities *get_writable_section_entities(LevelSection *section) {
+    if(section->entities == NULL) {
+        section->entities = std::make_shared<SectionEntities>();
+    } else if(section->entities.use_count() > 1) {
+        section->entities = std::make_shared<SectionEntities>(*section->entities);
+    }
+    return section->entities.get();
+}
+
+#define STREAM(Type) if(entity_type_id == entity_type_id(Type)) { return true; }
+bool is_streamed_entity_type(int32_t entity_type_id) { TO_STREAM return false; }
+#undef STREAM
+
+int32_t get_level_section_idx(int32_t x) {
+    return x > 0 ? x / LEVEL_SECTION_WIDTH : 0;
+}
+
+static
+LevelSection *get_or_add_section(LevelStream *stream, int32_t section_idx) {
+    if(section_idx >= (int32_t)stream->sections.size()) {
+        stream->sections.resize(section_idx + 1); // New ones aren't resident
+    }
+    return &stream->sections[section_idx];
+}
+
+void add_streamed_entity(LevelStream *stream, int32_t section_idx, EntitySaveData *es_data) {
+    LevelSection *section = get_or_add_section(stream, max_value(section_idx, 0));
+    get_writable_section_entities(section)->push_back(*es_data);
+    stream->stored_entity_count += 1;
+}
+
+static
+void load_section(Level *level, LevelSection *section) {
+    const SectionEntities &entities = get_section_entities(section);
+    for(const EntitySaveData &es_data : entities) {
+        deserialize_entity(level, &es_data);
+    }
+    level->stream->stored_entity_count -= (int32_t)entities.size();
+    section->entities = NULL; // Other clones keep theirs
+    section->resident = true;
+    level->stream->resident_count += 1;
+}
+
+// Writes back the streamed entities that are far enough, those are the ones of the retired sections and the ones that walked off into them
+static
+void retire_streamed_entities(Level *level, int32_t keep_min_section, int32_t keep_max_section) {
+    LevelStream *stream = level->stream;
+
+    std::vector<Entity *> to_retire;
+#define STREAM(Type)\
+    for_entity_type(level, Type, entity) {\
+        const int32_t section_idx = get_level_section_idx(entity->position.x);\
+        if(section_idx < keep_min_section || section_idx > keep_max_section) { to_retire.push_back(entity); }\
+    }
+    TO_STREAM
+#undef STREAM
+
+    // Not while walking the slabs, deleting puts the slot back on the free list
+    for(Entity *entity : to_retire) {
+        EntitySaveData es_data = get_serialize_proc(entity->entity_type_id)(entity);
+        es_data.add_cstring("type", entity_type_string[entity->entity_type_id]);
+
+        LevelSection *section = get_or_add_section(stream, get_level_section_idx(entity->position.x));
+        assert(!section->resident, "Retired entity's section is resident.");
+        get_writable_section_entities(section)->push_back(es_data);
+        stream->stored_entity_count += 1;
+
+        delete_entity_imm(entity);
+    }
+}
+
+// Movers that aren't streamed, shells, power ups, fireballs and woken enemies, can be left behind the kept sections while awake.
+// The chunks under them are kept, they would fall through to the kill region otherwise. Asleep they don't move until the camera is back.
+static
+void keep_tiles_under_awake_movers(Level *level, int32_t *keep_min_x, int32_t *keep_max_x) {
+    for_every_entity_by_type(level, entity) {
+        if(entity->has_move_data == NULL || entity->has_collider == NULL || entity->is_asleep || !is_entity_used(entity)) {
+            continue;
+        }
+
+        const int32_t left = entity->position.x + entity->has_collider->offset.x;
+        *keep_min_x = min_value(*keep_min_x, left - TILE_SIZE);
+        *keep_max_x = max_value(*keep_max_x, left + entity->has_collider->size.x + TILE_SIZE);
+    }
+}
+
+void update_level_stream(Level *level) {
+    LevelStream *stream = level->stream;
+    if(stream == NULL) {
+        return;
+    }
+    PROFILE_FUNCTION();
+
+    stream->sections_loaded = 0;
+    stream->sections_retired = 0;
+
+    const int32_t load_min_x = level->wake_up_rect_position.x - section_load_margin;
+    const int32_t load_max_x = level->wake_up_rect_position.x + level->wake_up_rect_size.x + section_load_margin;
+    const int32_t keep_min_x = level->wake_up_rect_position.x - section_retire_margin;
+    const int32_t keep_max_x = level->wake_up_rect_position.x + level->wake_up_rect_size.x + section_retire_margin;
+
+    const int32_t keep_min_section = get_level_section_idx(keep_min_x);
+    const int32_t keep_max_section = get_level_section_idx(keep_max_x);
+
+    for(int32_t section_idx = 0; section_idx < (int32_t)stream->sections.size(); ++section_idx) {
+        LevelSection *section = &stream->sections[section_idx];
+        if(section->resident && (section_idx < keep_min_section || section_idx > keep_max_section)) {
+            section->resident = false;
+            stream->resident_count -= 1;
+            stream->sections_retired += 1;
+        }
+    }
+
+    if(stream->sections_retired > 0) {
+        retire_streamed_entities(level, keep_min_section, keep_max_section);
+    }
+
+    const int32_t load_max_section = min_value(get_level_section_idx(load_max_x), (int32_t)stream->sections.size() - 1);
+    for(int32_t section_idx = get_level_section_idx(load_min_x); section_idx <= load_max_section; ++section_idx) {
+        LevelSection *section = &stream->sections[section_idx];
+        if(!section->resident) {
+            load_section(level, section);
+            stream->sections_loaded += 1;
+        }
+    }
+
+    // Chunks are kept with the same sections as the entities, whatever the tilemap's position. Section 0 reaches to the left of the level.
+    int32_t tiles_keep_min_x = keep_min_section > 0 ? keep_min_section * LEVEL_SECTION_WIDTH : INT32_MIN;
+    int32_t tiles_keep_max_x = (keep_max_section + 1) * LEVEL_SECTION_WIDTH;
+
+    bool retires_chunks = false;
+    for_entity_type(level, Tilemap, tilemap) {
+        retires_chunks |= has_tile_chunks_outside(tilemap, tiles_keep_min_x, tiles_keep_max_x);
+    }
+    if(retires_chunks) {
+        keep_tiles_under_awake_movers(level, &tiles_keep_min_x, &tiles_keep_max_x);
+    }
+
+    for_entity_type(level, Tilemap, tilemap) {
+        stream_tile_chunks(tilemap, load_min_x, load_max_x, tiles_keep_min_x, tiles_keep_max_x);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef _LEVEL_STREAM_H
+#define _LEVEL_STREAM_H
+
+#include "common.h"
+#include "level.h"
+#include "save_data.h"
+
+#include <memory>
+
+// Streamed levels are split into sections along x. Entities of the TO_STREAM types are kept as save data per section
+// and only instantiated when the wake up rect gets close, sections far behind are serialized back and their entities deleted.
+// Tile chunks of the tilemaps are kept with the same sections, and while awake movers are over them.
+
+#define LEVEL_SECTION_WIDTH (TILE_SIZE * TILE_CHUNK_WIDTH) // Same columns as the tile chunks
+
+typedef SaveDataVector<EntitySaveData> SectionEntities;
+
+// Clones share the entities of the sections with the level they were cloned from, until one of them writes entities back
+struct LevelSection {
+    std::shared_ptr<SectionEntities> entities; // While not resident, NULL when there are none
+    bool resident;
+};
+
+struct LevelStream {
+    std::vector<LevelSection> sections;
+    int32_t resident_count;
+    int32_t stored_entity_count; // Waiting in sections that aren't resident
+
+    // Last update
+    int32_t sections_loaded;
+    int32_t sections_retired;
+};
+
+LevelStream *create_level_stream(void);
+LevelStream *clone_level_stream(LevelStream *source); // NULL if source is NULL, the section entities are shared and not copied
+void delete_level_stream(LevelStream *stream);
+
+const SectionEntities &get_section_entities(const LevelSection *section);
+SectionEntities *get_writable_section_entities(LevelSection *section); // Copies the entities first if another stream shares them
+
+bool is_streamed_entity_type(int32_t entity_type_id);
+int32_t get_level_section_idx(int32_t x);
+void add_streamed_entity(LevelStream *stream, int32_t section_idx, EntitySaveData *es_data); // While loading
+
+void update_level_stream(Level *level); // After the wake up rect is recalculated
+
+#endif /* _LEVEL_STREAM_H */
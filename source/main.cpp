@@ -10,6 +10,9 @@
 #include "audio_player.h"
 #include "data.h"
 #include "all_entities.h"
+#include "parallel_update.h"
+#include "profiler.h"
+#include "frame_timings.h"
 
 #ifdef BUILD_EDITOR
 #include "editor.h"
@@ -26,6 +29,7 @@
     #define INIT_WINDOW_HEIGHT     720
     #define INIT_WINDOW_TITLE "no_name_editor"
     #define INIT_ENABLE_VSYNC  1
+    #define INIT_AUDIO_BUFFER_FRAMES 1024
 #else
     #define INIT_WINDOW_FULLSCREEN 0
 #ifdef _DEBUG_MODE
@@ -37,6 +41,7 @@
 #endif
     #define INIT_WINDOW_TITLE "no_name"
     #define INIT_ENABLE_VSYNC  0
+    #define INIT_AUDIO_BUFFER_FRAMES AUDIO_DEFAULT_BUFFER_FRAMES
 #endif
 
 static void toggle_fullscreen(SDL_Window *sdl_window, bool *out_is_fullscreen, bool set_to_fullscreen) {
@@ -62,6 +67,11 @@ static void toggle_fullscreen(SDL_Window *sdl_window, bool *out_is_fullscreen, b
 
 int main(int argc, char *argv[]) {
     SDL_SetMainReady();
+    set_profiler_thread_name("main");
+#ifndef BUILD_EDITOR
+    const uint64_t startup_begin_time = SDL_GetPerformanceCounter(); // Shown in the debug panel
+#endif
+
     bool sdl_success = SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO) == 0;
     if(!sdl_success) {
         printf("Failed to initialize SDL2.\n");
@@ -99,9 +109,10 @@ int main(int argc, char *argv[]) {
     }
 
     render::r_init();
-    audio_player::a_init();
+    audio_player::a_init(INIT_AUDIO_BUFFER_FRAMES);
     global_data::init();
     init_entities_data();
+    init_parallel_update(-1);
 
     int32_t window_w;
     int32_t window_h;
@@ -116,6 +127,7 @@ int main(int argc, char *argv[]) {
     init_main_menu();    
     Game *game = create_game();
     resize_game(game, window_w, window_h);
+    game->startup_time = (float64_t)(SDL_GetPerformanceCounter() - startup_begin_time) / (float64_t)SDL_GetPerformanceFrequency();
 #endif
        
     uint64_t  prev_frame_time = SDL_GetPerformanceCounter();
@@ -156,6 +168,8 @@ int main(int argc, char *argv[]) {
         }
 #endif
 
+        profiler_begin_frame();
+        begin_frame_timings();
         begin_input_frame(input);
 
         SDL_Event sdl_event;
@@ -188,11 +202,18 @@ int main(int argc, char *argv[]) {
         gl_clear({ 0.1f, 0.1f, 0.1f, 1.0f }, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 #ifdef BUILD_EDITOR
+        begin_frame_stage(FRAME_STAGE_SIMULATION);
         update_editor(editor, input, delta_time);
+        end_frame_stage(FRAME_STAGE_SIMULATION);
+
+        begin_frame_stage(FRAME_STAGE_RENDER_RECORD);
         render_editor(editor);
         render_editor_imgui();
+        end_frame_stage(FRAME_STAGE_RENDER_RECORD);
 #else
+        begin_frame_stage(FRAME_STAGE_SIMULATION);
         update_game(game, input, target_delta_time);
+        end_frame_stage(FRAME_STAGE_SIMULATION);
         
         if(fullscreen != game->request_fullscreen) {
             toggle_fullscreen(sdl_window, &fullscreen, game->request_fullscreen);
@@ -204,8 +225,11 @@ int main(int argc, char *argv[]) {
             game->request_fit_window_to_draw_rect = false;
         }
 
+        begin_frame_stage(FRAME_STAGE_RENDER_RECORD);
         render_game(game);
+        end_frame_stage(FRAME_STAGE_RENDER_RECORD);
 #endif
+        audio_player::a_flush_requests();
 
 #if defined(_DEBUG_MODE)
         if(input->keys[key_f11] & input_pressed) {
@@ -216,7 +240,15 @@ int main(int argc, char *argv[]) {
         }                
 #endif
 
-        SDL_GL_SwapWindow(sdl_window);
+        /* Swap */ {
+            PROFILE_ZONE("SDL_GL_SwapWindow");
+            begin_frame_stage(FRAME_STAGE_SWAP);
+            SDL_GL_SwapWindow(sdl_window);
+            end_frame_stage(FRAME_STAGE_SWAP);
+        }
+        render::r_gpu_timers_end_frame();
+        profiler_end_frame();
+        end_frame_timings();
 
 #ifndef BUILD_EDITOR
         if(game->should_quit_game) {
@@ -236,6 +268,7 @@ int main(int argc, char *argv[]) {
 
     delete_input(input);
 
+    free_parallel_update();
     global_data::free();
     audio_player::a_quit();
     render::r_quit();
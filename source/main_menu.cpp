@@ -45,6 +45,7 @@ namespace {
 
     // Background level
     Level *menu_level;
+    Level *menu_level_pristine; // Loaded once in init_main_menu, menu_level is cloned from it
     LevelSaveData menu_level_sd;
 
     InputBinds bind_menu_down;
@@ -56,8 +57,9 @@ namespace {
 }
 
 void init_main_menu(void) {
-    menu_level = create_empty_level();
     menu_level_sd = parse_level_save_data((global_data::get_data_path() + "\\levels\\main_menu.level").c_str());
+    menu_level_pristine = create_empty_level();
+    load_level_from_save_data(menu_level_pristine, &menu_level_sd);
 
     prepare_main_menu();
 
@@ -93,12 +95,13 @@ void init_main_menu(void) {
 void free_main_menu(void) {
     menu_level_sd.entity_save_data.clear();
     delete_level(menu_level);
+    delete_level(menu_level_pristine);
     menu_level = NULL;
+    menu_level_pristine = NULL;
 }
 
 void prepare_main_menu(void) {
-    recreate_empty_level(&menu_level);
-    load_level_from_save_data(menu_level, &menu_level_sd);
+    recreate_level_from_clone(&menu_level, menu_level_pristine);
     menu_cursor         = 0;
     menu_page_id        = 0;
     menu_setup_timer    = 0.0f;
@@ -367,8 +370,7 @@ void render_main_menu(Framebuffer *framebuffer, const struct Game *game) {
 
     int32_t last_menu_option_y_pos = 0;
 
-    // @todo Maybe check differently if custom level was loaded
-    const bool custom_level_available = game->custom_level != NULL && game->custom_level->entities.count > 0;
+    const bool custom_level_available = is_custom_level_available(game);
 
     /* Menu options */ {
         for(int32_t idx = 0; idx < array_count(menu_options[0]); ++idx) {
@@ -0,0 +1,119 @@
+#include "memory_tags.h"
+
+#include <atomic>
+
+#define MEMORY_TAG_HEADER_MAGIC 0x6d656d74
+
+namespace {
+    // In front of every tagged block, 16 bytes so the block keeps malloc's alignment
+    struct TaggedHeader {
+        uint64_t bytes;
+        int32_t  tag;
+        uint32_t magic;
+    };
+
+    static_assert(sizeof(TaggedHeader) == 16);
+
+    // Allocations come from the level loader and job threads too
+    struct TagCounters {
+        std::atomic<int64_t> current_bytes;
+        std::atomic<int64_t> peak_bytes;
+        std::atomic<int64_t> allocations;
+        std::atomic<int64_t> total_allocations;
+    };
+
+    TagCounters tag_counters[MEMORY_TAG__COUNT];
+}
+
+static
+void count_bytes(EMemoryTag tag, int64_t bytes) {
+    TagCounters *counters = &tag_counters[tag];
+    const int64_t current = counters->current_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    int64_t peak = counters->peak_bytes.load(std::memory_order_relaxed);
+    while(current > peak && !counters->peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) { }
+}
+
+void *tagged_malloc(EMemoryTag tag, size_t bytes) {
+    assert(tag >= 0 && tag < MEMORY_TAG__COUNT);
+
+    TaggedHeader *header = (TaggedHeader *)malloc(sizeof(TaggedHeader) + bytes);
+    if(header == NULL) {
+        return NULL;
+    }
+
+    header->bytes = bytes;
+    header->tag   = tag;
+    header->magic = MEMORY_TAG_HEADER_MAGIC;
+
+    count_bytes(tag, (int64_t)bytes);
+    tag_counters[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+    tag_counters[tag].total_allocations.fetch_add(1, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void *tagged_malloc_and_zero(EMemoryTag tag, size_t bytes) {
+    void *memory = tagged_malloc(tag, bytes);
+    if(memory) memset(memory, 0, bytes);
+    return memory;
+}
+
+void tagged_free(void *memory) {
+    if(memory == NULL) {
+        return;
+    }
+
+    TaggedHeader *header = (TaggedHeader *)memory - 1;
+    assert(header->magic == MEMORY_TAG_HEADER_MAGIC, "Freeing memory that wasn't allocated with tagged_malloc.");
+    header->magic = 0;
+
+    count_bytes((EMemoryTag)header->tag, -(int64_t)header->bytes);
+    tag_counters[header->tag].allocations.fetch_sub(1, std::memory_order_relaxed);
+    free(header);
+}
+
+void add_tagged_bytes(EMemoryTag tag, int64_t bytes) {
+    assert(tag >= 0 && tag < MEMORY_TAG__COUNT);
+    count_bytes(tag, bytes);
+}
+
+MemoryTagStats get_memory_tag_stats(EMemoryTag tag) {
+    assert(tag >= 0 && tag < MEMORY_TAG__COUNT);
+
+    MemoryTagStats stats;
+    stats.current_bytes     = tag_counters[tag].current_bytes.load(std::memory_order_relaxed);
+    stats.peak_bytes        = tag_counters[tag].peak_bytes.load(std::memory_order_relaxed);
+    stats.allocations       = tag_counters[tag].allocations.load(std::memory_order_relaxed);
+    stats.total_allocations = tag_counters[tag].total_allocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void reset_memory_tag_peaks(void) {
+    for(int32_t tag = 0; tag < MEMORY_TAG__COUNT; ++tag) {
+        tag_counters[tag].peak_bytes.store(tag_counters[tag].current_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+std::string format_memory_tags(void) {
+    char buffer[256];
+    sprintf_s(buffer, array_count(buffer), "%-16s %11s %11s %9s %11s\n", "tag", "current KB", "peak KB", "allocs", "total allocs");
+    std::string table = buffer;
+
+    MemoryTagStats total = { };
+    for(int32_t tag = 0; tag < MEMORY_TAG__COUNT; ++tag) {
+        MemoryTagStats stats = get_memory_tag_stats((EMemoryTag)tag);
+        sprintf_s(buffer, array_count(buffer), "%-16s %11.1f %11.1f %9lld %11lld\n", memory_tag_string[tag],
+                  (float64_t)stats.current_bytes / 1024.0, (float64_t)stats.peak_bytes / 1024.0, (long long)stats.allocations, (long long)stats.total_allocations);
+        table += buffer;
+
+        total.current_bytes     += stats.current_bytes;
+        total.peak_bytes        += stats.peak_bytes; // Sum of the peaks, those didn't have to happen at once
+        total.allocations       += stats.allocations;
+        total.total_allocations += stats.total_allocations;
+    }
+
+    sprintf_s(buffer, array_count(buffer), "%-16s %11.1f %11.1f %9lld %11lld\n", "total",
+              (float64_t)total.current_bytes / 1024.0, (float64_t)total.peak_bytes / 1024.0, (long long)total.allocations, (long long)total.total_allocations);
+    table += buffer;
+    return table;
+}
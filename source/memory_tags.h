@@ -0,0 +1,71 @@
+#ifndef _MEMORY_TAGS_H
+#define _MEMORY_TAGS_H
+
+#include "common.h"
+
+// Heap memory accounted per subsystem, current and peak bytes of every tag. Allocations go through tagged_malloc
+// which keeps the size and tag in front of the block, so tagged_free has to be used to free them.
+// Memory allocated by libraries (SDL_mixer chunks) is added with add_tagged_bytes.
+
+#define MEMORY_TAGS\
+    MEMORY_TAG(LEVEL_ARENA,    "level arena")\
+    MEMORY_TAG(LEVEL,          "level")\
+    MEMORY_TAG(TILEMAP,        "tilemap")\
+    MEMORY_TAG(SAVE_DATA,      "save data")\
+    MEMORY_TAG(RENDER_BUFFERS, "render buffers")\
+    MEMORY_TAG(FONT,           "font")\
+    MEMORY_TAG(AUDIO,          "audio")\
+    MEMORY_TAG(FILE_DATA,      "file data")
+
+enum EMemoryTag : int32_t {
+#define MEMORY_TAG(tag, name) MEMORY_TAG_##tag,
+    MEMORY_TAGS
+#undef MEMORY_TAG
+    MEMORY_TAG__COUNT
+};
+
+inline const char *memory_tag_string[] = {
+#define MEMORY_TAG(tag, name) name,
+    MEMORY_TAGS
+#undef MEMORY_TAG
+};
+
+static_assert(array_count(memory_tag_string) == MEMORY_TAG__COUNT);
+
+struct MemoryTagStats {
+    int64_t current_bytes;
+    int64_t peak_bytes;      // Since start or reset_memory_tag_peaks
+    int64_t allocations;     // Live
+    int64_t total_allocations;
+};
+
+void *tagged_malloc(EMemoryTag tag, size_t bytes);
+void *tagged_malloc_and_zero(EMemoryTag tag, size_t bytes);
+void  tagged_free(void *memory); // NULL is fine
+void  add_tagged_bytes(EMemoryTag tag, int64_t bytes); // Negative when freed
+
+MemoryTagStats get_memory_tag_stats(EMemoryTag tag);
+void reset_memory_tag_peaks(void); // Peaks start again from the current bytes
+std::string format_memory_tags(void); // Every tag as a table with a header line and a total
+
+#define tagged_malloc_struct(tag, T)            (T *)tagged_malloc(tag, sizeof(T))
+#define tagged_malloc_and_zero_struct(tag, T)   (T *)tagged_malloc_and_zero(tag, sizeof(T))
+#define tagged_malloc_and_zero_array(tag, T, n) (T *)tagged_malloc_and_zero(tag, sizeof(T) * (n))
+
+// For std containers, rebind is spelled out because of the non-type parameter
+template<typename T, EMemoryTag Tag>
+struct TaggedAllocator {
+    typedef T value_type;
+    template<typename U> struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+    TaggedAllocator(void) = default;
+    template<typename U> TaggedAllocator(const TaggedAllocator<U, Tag> &) { }
+
+    T   *allocate(size_t count)            { return (T *)tagged_malloc(Tag, sizeof(T) * count); }
+    void deallocate(T *memory, size_t)     { tagged_free(memory); }
+
+    template<typename U> bool operator==(const TaggedAllocator<U, Tag> &) const { return true; }
+    template<typename U> bool operator!=(const TaggedAllocator<U, Tag> &) const { return false; }
+};
+
+#endif /* _MEMORY_TAGS_H */
@@ -0,0 +1,244 @@
+#include "parallel_update.h"
+#include "job_system.h"
+#include "level.h"
+#include "audio_player.h"
+
+namespace {
+    enum EDeferredCommand {
+        DEFERRED_DELETE_ENTITY,
+        DEFERRED_ADD_POINTS,
+        DEFERRED_ADD_COINS,
+        DEFERRED_PLAY_SOUND,
+        DEFERRED_CALL
+    };
+
+    struct DeferredCommand {
+        EDeferredCommand type;
+        int32_t          value; // Points, coins or sound loops
+        uint32_t         args_offset;
+        uint32_t         args_size;
+        Entity          *entity;
+        Level           *level;
+        Sound           *sound;
+        deferred_proc   *proc;
+    };
+
+    struct CommandBuffer {
+        std::vector<DeferredCommand> commands;
+        std::vector<uint8_t>         args;
+    };
+
+    struct ParallelUpdate {
+        SimInput  input;
+        float64_t delta_time;
+    };
+
+    JobSystem *jobs    = NULL;
+    bool       enabled = true;
+
+    std::vector<Entity *>      entities_to_update;
+    std::vector<CommandBuffer> command_buffers; // One per chunk, so the order of commands doesn't depend on which thread ran what
+
+    thread_local CommandBuffer *recording = NULL;
+}
+
+void init_parallel_update(int32_t worker_count) {
+    assert(jobs == NULL);
+    jobs = create_job_system(worker_count);
+}
+
+void free_parallel_update(void) {
+    delete_job_system(jobs);
+    jobs = NULL;
+
+    entities_to_update = std::vector<Entity *>();
+    command_buffers = std::vector<CommandBuffer>();
+}
+
+void set_parallel_update_enabled(bool _enabled) {
+    enabled = _enabled;
+}
+
+bool is_parallel_update_enabled(void) {
+    return jobs != NULL && enabled;
+}
+
+int32_t get_parallel_update_worker_count(void) {
+    return jobs != NULL ? get_job_worker_count(jobs) : 0;
+}
+
+// Only these types run in chunks. The short-lived effects (tile break, enemy fall, timed sprite/anim, coin drop, floating text) are not entities,
+// they're updated in their LevelEffects pools by update_level_effects and those pools are far below PARALLEL_UPDATE_MIN_ENTITIES
+static bool is_parallel_update_type(int32_t entity_type_id) {
+    switch(entity_type_id) {
+        case entity_type_id(BackgroundPlane):
+        case entity_type_id(BackgroundSprite):
+        case entity_type_id(FireBar):
+        case entity_type_id(Coin): {
+            return true;
+        }
+    }
+    return false;
+}
+
+static PARALLEL_FOR_PROC(update_entity_chunk) {
+    auto update = (ParallelUpdate *)user_data;
+
+    CommandBuffer *buffer = &command_buffers[chunk_idx];
+    buffer->commands.clear();
+    buffer->args.clear();
+
+    recording = buffer;
+    for(int32_t idx = begin; idx < end; ++idx) {
+        Entity *entity = entities_to_update[idx];
+        entity->update_proc(entity, update->input, update->delta_time);
+    }
+    recording = NULL;
+}
+
+static void apply_commands(CommandBuffer *buffer) {
+    for(DeferredCommand &command : buffer->commands) {
+        switch(command.type) {
+            case DEFERRED_DELETE_ENTITY: {
+                delete_entity(command.entity);
+            } break;
+
+            case DEFERRED_ADD_POINTS: {
+                add_points(command.level, command.value);
+            } break;
+
+            case DEFERRED_ADD_COINS: {
+                add_coins(command.level, command.value);
+            } break;
+
+            case DEFERRED_PLAY_SOUND: {
+                audio_player::a_play_sound(command.sound, command.value);
+            } break;
+
+            case DEFERRED_CALL: {
+                command.proc(command.entity, command.args_size ? buffer->args.data() + command.args_offset : NULL);
+            } break;
+        }
+    }
+}
+
+bool update_entities_in_parallel(Level *level, int32_t entity_type_id, SimInput input, float64_t delta_time) {
+    if(!is_parallel_update_enabled() || !is_parallel_update_type(entity_type_id) || level->entities.count_of_type[entity_type_id] < PARALLEL_UPDATE_MIN_ENTITIES) {
+        return false;
+    }
+
+    entities_to_update.clear();
+    for_entity_type_id(level, entity_type_id, entity) {
+        if(can_update_entity(entity)) {
+            entities_to_update.push_back(entity);
+        }
+    }
+
+    // Where the serial loop would have continued, entities spawned by the commands are picked up from there
+    EntitySlab *slab = &level->slabs[entity_type_id];
+    EntitySlabBlock *tail_block = slab->last_block;
+    const int32_t    tail_slot  = tail_block->used;
+
+    const int32_t count = (int32_t)entities_to_update.size();
+    level->active_entity_count += count;
+    const int32_t chunk_count = (count + PARALLEL_UPDATE_CHUNK_SIZE - 1) / PARALLEL_UPDATE_CHUNK_SIZE;
+    if((int32_t)command_buffers.size() < chunk_count) {
+        command_buffers.resize(chunk_count);
+    }
+
+    ParallelUpdate update;
+    update.input      = input;
+    update.delta_time = delta_time;
+    parallel_for(jobs, count, PARALLEL_UPDATE_CHUNK_SIZE, update_entity_chunk, &update);
+
+    // Sync point
+    for(int32_t chunk_idx = 0; chunk_idx < chunk_count; ++chunk_idx) {
+        apply_commands(&command_buffers[chunk_idx]);
+    }
+
+    EntitySlabIterator rest = iterate_slabs(slab, 1);
+    rest.block = tail_block;
+    rest.slot  = tail_slot;
+    while(Entity *entity = rest.next()) {
+        if(can_update_entity(entity)) {
+            level->active_entity_count += 1;
+            entity->update_proc(entity, input, delta_time);
+        }
+    }
+    return true;
+}
+
+bool is_recording_commands(void) {
+    return recording != NULL;
+}
+
+static DeferredCommand *push_command(EDeferredCommand type) {
+    DeferredCommand command = { };
+    command.type = type;
+    recording->commands.push_back(command);
+    return &recording->commands.back();
+}
+
+bool defer_delete_entity(Entity *entity) {
+    if(recording == NULL) {
+        return false;
+    }
+
+    push_command(DEFERRED_DELETE_ENTITY)->entity = entity;
+    return true;
+}
+
+bool defer_add_points(Level *level, int32_t points) {
+    if(recording == NULL) {
+        return false;
+    }
+
+    auto command = push_command(DEFERRED_ADD_POINTS);
+    command->level = level;
+    command->value = points;
+    return true;
+}
+
+bool defer_add_coins(Level *level, int32_t coins) {
+    if(recording == NULL) {
+        return false;
+    }
+
+    auto command = push_command(DEFERRED_ADD_COINS);
+    command->level = level;
+    command->value = coins;
+    return true;
+}
+
+bool defer_play_sound(Sound *sound, int32_t loops) {
+    if(recording == NULL) {
+        return false;
+    }
+
+    auto command = push_command(DEFERRED_PLAY_SOUND);
+    command->sound = sound;
+    command->value = loops;
+    return true;
+}
+
+void run_or_defer(Entity *entity, deferred_proc *proc, const void *args, size_t args_size) {
+    assert(args_size <= DEFERRED_PROC_MAX_ARGS_SIZE, "Too big args for deferred proc");
+
+    if(recording == NULL) {
+        proc(entity, args);
+        return;
+    }
+
+    auto command = push_command(DEFERRED_CALL);
+    command->entity = entity;
+    command->proc   = proc;
+    if(args_size > 0) {
+        // Keep args 16 byte aligned, so the proc can read them as a struct
+        const size_t offset = (recording->args.size() + 15) & ~(size_t)15;
+        recording->args.resize(offset + args_size);
+        memcpy(recording->args.data() + offset, args, args_size);
+
+        command->args_offset = (uint32_t)offset;
+        command->args_size   = (uint32_t)args_size;
+    }
+}
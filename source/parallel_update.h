@@ -0,0 +1,38 @@
+#ifndef _PARALLEL_UPDATE_H
+#define _PARALLEL_UPDATE_H
+
+#include "common.h"
+#include "entity.h"
+
+// Entity types that don't write to other entities (background planes and sprites, fire bars, coins) get their update procs run in chunks on the job system.
+// Anything that touches shared state from there (deleting entities, points, coins, sounds, spawns, writes to other entities)
+// is recorded into the command buffer of the chunk and applied at the sync point in chunk order, so the result is the same as updating serially.
+
+#define PARALLEL_UPDATE_CHUNK_SIZE   64
+#define PARALLEL_UPDATE_MIN_ENTITIES 256 // Below this the type is updated serially, not worth waking the workers
+
+void init_parallel_update(int32_t worker_count); // worker_count < 0 picks based on hardware threads
+void free_parallel_update(void);
+void set_parallel_update_enabled(bool enabled);
+bool is_parallel_update_enabled(void);
+int32_t get_parallel_update_worker_count(void);
+
+// Returns false if the type should be updated serially by the caller
+bool update_entities_in_parallel(struct Level *level, int32_t entity_type_id, SimInput input, float64_t delta_time);
+
+// Recording, these return false when not called from a parallel update and the caller should do it right away
+bool is_recording_commands(void);
+bool defer_delete_entity(Entity *entity);
+bool defer_add_points(struct Level *level, int32_t points);
+bool defer_add_coins(struct Level *level, int32_t coins);
+bool defer_play_sound(struct Sound *sound, int32_t loops);
+
+#define DEFERRED_PROC(name) void name(Entity *entity, const void *args)
+typedef DEFERRED_PROC(deferred_proc);
+
+#define DEFERRED_PROC_MAX_ARGS_SIZE 64
+
+// For spawning and writing to other entities, args are copied
+void run_or_defer(Entity *entity, deferred_proc *proc, const void *args = NULL, size_t args_size = 0);
+
+#endif /* _PARALLEL_UPDATE_H */
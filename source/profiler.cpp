@@ -0,0 +1,210 @@
+#include "profiler.h"
+#include "data.h"
+
+#include <SDL.h>
+#include <mutex>
+#include <atomic>
+
+namespace {
+    static_assert((PROFILER_MAX_ZONES & (PROFILER_MAX_ZONES - 1)) == 0);
+
+    // Ring of closed zones, only the owner writes zones and only the thread ending the frame collects them
+    struct ProfilerThread {
+        ProfileZoneRecord zones[PROFILER_MAX_ZONES];
+        std::atomic<uint32_t> written;   // Advanced by the owner after the zone is filled in
+        std::atomic<uint32_t> collected; // Advanced by the collecting thread after the zones are copied
+        std::atomic<int32_t>  dropped;
+        int32_t thread_idx;
+        char    name[32]; // Under threads_mutex
+    };
+
+    std::mutex           threads_mutex;
+    ProfilerThread      *threads[PROFILER_MAX_THREADS];
+    std::atomic<int32_t> thread_count = 0;
+    std::atomic<bool>    enabled = true;
+
+    thread_local ProfilerThread *this_thread = NULL;
+    thread_local bool this_thread_untracked = false; // Came after PROFILER_MAX_THREADS
+    thread_local int32_t this_thread_depth = 0;      // Open zones
+
+    ProfilerFrame last_frame;
+    uint64_t      frame_begin = 0;
+
+    int32_t     capture_frames_left = 0;
+    std::string capture_filepath;
+    std::vector<ProfileZoneRecord> capture_zones;
+}
+
+static
+ProfilerThread *get_profiler_thread(void) {
+    if(this_thread != NULL || this_thread_untracked) {
+        return this_thread;
+    }
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    const int32_t thread_idx = thread_count.load(std::memory_order_relaxed);
+    if(thread_idx >= PROFILER_MAX_THREADS) {
+        this_thread_untracked = true;
+        return NULL;
+    }
+
+    this_thread = new ProfilerThread(); // Kept until exit, collection can happen after the thread is gone
+    this_thread->thread_idx = thread_idx;
+    sprintf_s(this_thread->name, array_count(this_thread->name), "thread %d", thread_idx);
+    threads[thread_idx] = this_thread;
+    thread_count.store(thread_idx + 1, std::memory_order_release);
+    return this_thread;
+}
+
+void set_profiler_enabled(bool is_enabled) {
+    enabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+bool is_profiler_enabled(void) {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void set_profiler_thread_name(const char *name) {
+    ProfilerThread *thread = get_profiler_thread();
+    if(thread != NULL) {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        strcpy_s(thread->name, array_count(thread->name), name);
+    }
+}
+
+uint64_t profiler_begin_zone(void) {
+    if(!enabled.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    this_thread_depth += 1;
+    return SDL_GetPerformanceCounter();
+}
+
+void profiler_end_zone(const char *name, uint64_t begin) {
+    if(begin == 0) {
+        return;
+    }
+
+    const uint64_t end = SDL_GetPerformanceCounter();
+    this_thread_depth -= 1;
+
+    ProfilerThread *thread = get_profiler_thread();
+    if(thread == NULL) {
+        return;
+    }
+
+    const uint32_t write_idx = thread->written.load(std::memory_order_relaxed);
+    if(write_idx - thread->collected.load(std::memory_order_acquire) >= PROFILER_MAX_ZONES) {
+        thread->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ProfileZoneRecord *zone = &thread->zones[write_idx % PROFILER_MAX_ZONES];
+    zone->name  = name;
+    zone->begin = begin;
+    zone->end   = end;
+    zone->depth = this_thread_depth;
+    zone->thread_idx = thread->thread_idx;
+    thread->written.store(write_idx + 1, std::memory_order_release);
+}
+
+void profiler_begin_frame(void) {
+    frame_begin = SDL_GetPerformanceCounter();
+}
+
+static
+void write_capture(void) {
+    uint64_t base = UINT64_MAX;
+    for(auto &zone : capture_zones) {
+        base = min_value(base, zone.begin);
+    }
+    const float64_t ticks_to_us = 1000000.0 / (float64_t)SDL_GetPerformanceFrequency();
+
+    std::string json = "{\"traceEvents\":[\n";
+    char buffer[256];
+
+    const int32_t count = thread_count.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> names_lock(threads_mutex);
+    for(int32_t thread_idx = 0; thread_idx < count; ++thread_idx) {
+        sprintf_s(buffer, array_count(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", thread_idx, get_profiler_thread_name(thread_idx));
+        json += buffer;
+    }
+    names_lock.unlock();
+
+    for(auto &zone : capture_zones) {
+        sprintf_s(buffer, array_count(buffer), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n",
+                  zone.name, zone.thread_idx, (float64_t)(zone.begin - base) * ticks_to_us, (float64_t)(zone.end - zone.begin) * ticks_to_us);
+        json += buffer;
+    }
+
+    // Trailing comma isn't valid JSON
+    if(json.back() == '\n' && json[json.size() - 2] == ',') {
+        json.erase(json.size() - 2, 1);
+    }
+    json += "]}\n";
+
+    if(save_file(capture_filepath.c_str(), (char *)json.c_str(), json.size())) {
+        printf("Profiler capture with %d zones written to \"%s\".\n", (int32_t)capture_zones.size(), capture_filepath.c_str());
+    } else {
+        printf("Failed to write profiler capture to \"%s\".\n", capture_filepath.c_str());
+    }
+    capture_zones.clear();
+    capture_zones.shrink_to_fit();
+}
+
+void profiler_end_frame(void) {
+    last_frame.zones.clear();
+    last_frame.begin = frame_begin;
+    last_frame.end = SDL_GetPerformanceCounter();
+    last_frame.dropped = 0;
+
+    const int32_t count = thread_count.load(std::memory_order_acquire);
+    for(int32_t thread_idx = 0; thread_idx < count; ++thread_idx) {
+        ProfilerThread *thread = threads[thread_idx];
+        const uint32_t written = thread->written.load(std::memory_order_acquire);
+        for(uint32_t idx = thread->collected.load(std::memory_order_relaxed); idx != written; ++idx) {
+            last_frame.zones.push_back(thread->zones[idx % PROFILER_MAX_ZONES]);
+        }
+        thread->collected.store(written, std::memory_order_release);
+        last_frame.dropped += thread->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    last_frame.thread_count = count;
+
+    if(capture_frames_left > 0) {
+        capture_zones.insert(capture_zones.end(), last_frame.zones.begin(), last_frame.zones.end());
+        capture_frames_left -= 1;
+        if(capture_frames_left == 0) {
+            write_capture();
+        }
+    }
+}
+
+const ProfilerFrame *get_profiler_last_frame(void) {
+    return &last_frame;
+}
+
+const char *get_profiler_thread_name(int32_t thread_idx) {
+    if(thread_idx < 0 || thread_idx >= thread_count.load(std::memory_order_acquire)) {
+        return "";
+    }
+    return threads[thread_idx]->name;
+}
+
+float64_t profiler_ticks_to_ms(uint64_t ticks) {
+    return (float64_t)ticks / (float64_t)SDL_GetPerformanceFrequency() * 1000.0;
+}
+
+void request_profiler_capture(int32_t frame_count, const char *filepath) {
+    if(capture_frames_left > 0 || frame_count <= 0) {
+        return;
+    }
+
+    capture_frames_left = frame_count;
+    capture_filepath = filepath;
+    capture_zones.clear();
+}
+
+bool is_profiler_capturing(void) {
+    return capture_frames_left > 0;
+}
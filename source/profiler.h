@@ -0,0 +1,62 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "common.h"
+
+// Scoped CPU timing zones, every thread records into its own buffer and the buffers are collected at the end of the frame.
+// A zone is written when it closes, the owner and the collecting thread only share an atomic count per buffer.
+// Only compiled in with ENABLE_PROFILER (always on in debug mode), otherwise PROFILE_ZONE expands to nothing.
+// Zone names aren't copied, they have to be string literals or other strings that live for the whole run.
+
+#define PROFILER_MAX_THREADS 16
+#define PROFILER_MAX_ZONES   8192 // Per thread between collections, zones past this are dropped. Power of two, the counts wrap around.
+
+struct ProfileZoneRecord {
+    const char *name;
+    uint64_t begin; // Performance counter
+    uint64_t end;
+    int32_t  depth;
+    int32_t  thread_idx;
+};
+
+struct ProfilerFrame {
+    std::vector<ProfileZoneRecord> zones; // Closed during the frame, by thread then by end
+    uint64_t begin;
+    uint64_t end;
+    int32_t  thread_count; // Threads that recorded something so far
+    int32_t  dropped;
+};
+
+void set_profiler_enabled(bool enabled);
+bool is_profiler_enabled(void);
+void set_profiler_thread_name(const char *name); // Shows up in the capture, call from the thread
+
+void profiler_begin_frame(void);
+void profiler_end_frame(void); // Collects the zones closed so far, zones still open come with a later frame
+const ProfilerFrame *get_profiler_last_frame(void);
+const char *get_profiler_thread_name(int32_t thread_idx);
+float64_t profiler_ticks_to_ms(uint64_t ticks);
+
+// Records the next frames and writes them out as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev)
+void request_profiler_capture(int32_t frame_count, const char *filepath);
+bool is_profiler_capturing(void);
+
+uint64_t profiler_begin_zone(void); // Returns the begin for profiler_end_zone, 0 when the profiler is disabled
+void     profiler_end_zone(const char *name, uint64_t begin);
+
+struct ProfileZone {
+    const char *name;
+    uint64_t    begin;
+    ProfileZone(const char *name) : name(name) { begin = profiler_begin_zone(); }
+    ~ProfileZone() { profiler_end_zone(name, begin); }
+};
+
+#if defined(ENABLE_PROFILER)
+#define PROFILE_ZONE(name) ProfileZone CONCAT(_profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#endif
+
+#endif /* _PROFILER_H */
@@ -1,4 +1,8 @@
 #include "renderer.h"
+#include "profiler.h"
+#include "memory_tags.h"
+
+#include <SDL.h>
 
 #include "../data/preloaded_data.h"
 
@@ -31,6 +35,25 @@ namespace {
     bool scene_began = false;
 
     RenderStats render_stats;
+    uint64_t    quads_pushed; // Never reset
+    uint64_t    flush_ticks;  // Never reset, performance counter ticks spent in flush
+
+    // --- gpu timers ---
+    struct GpuTimerFrame {
+        int32_t     count;
+        const char *labels[MAX_GPU_TIMERS];
+        float64_t   cpu_times[MAX_GPU_TIMERS];
+    };
+
+    bool          gpu_timers_available;
+    gl_id         gpu_queries[GPU_TIMER_LATENCY][MAX_GPU_TIMERS];
+    GpuTimerFrame gpu_timer_frames[GPU_TIMER_LATENCY];
+    int32_t       gpu_timer_frame_idx;
+    int32_t       gpu_timer_active = -1; // Query slot of the running timer
+    uint64_t      gpu_timer_zone_begin;  // Profiler zone of the running timer
+    uint64_t      gpu_timer_cpu_begin;
+    GpuTiming     gpu_timings[MAX_GPU_TIMERS];
+    int32_t       gpu_timing_count;
 
     Texture *white_texture;
     Font    *default_font;
@@ -91,8 +114,8 @@ void init_quads(void) {
     // Allocate memory for quad vertices and indices
     size_t vb_data_bytes = max_quad_verts * sizeof(QuadVertex);
     size_t ib_data_bytes = max_quad_indices * sizeof(uint32_t);
-    quad_vb_data = (QuadVertex *)malloc(vb_data_bytes);
-    quad_ib_data = (uint32_t *)malloc(ib_data_bytes);
+    quad_vb_data = (QuadVertex *)tagged_malloc(MEMORY_TAG_RENDER_BUFFERS, vb_data_bytes);
+    quad_ib_data = (uint32_t *)tagged_malloc(MEMORY_TAG_RENDER_BUFFERS, ib_data_bytes);
     assert(quad_vb_data != nullptr && quad_ib_data != nullptr);
 
     // Setup quad vertex buffer
@@ -140,8 +163,8 @@ static
 void free_quads(void) {
     delete_shader(quad_shader);
     delete_vertex_array(quad_va);
-    free(quad_ib_data);
-    free(quad_vb_data);
+    tagged_free(quad_ib_data);
+    tagged_free(quad_vb_data);
 }
 
 static
@@ -151,7 +174,7 @@ void init_lines(void) {
 
     // Allocate memory for line vertices
     size_t vb_data_bytes = max_line_verts * sizeof(LineVertex);
-    line_vb_data = (LineVertex *)malloc(vb_data_bytes);
+    line_vb_data = (LineVertex *)tagged_malloc(MEMORY_TAG_RENDER_BUFFERS, vb_data_bytes);
     assert(line_vb_data != nullptr);
 
     // Setup line vertex buffer
@@ -175,7 +198,7 @@ static
 void free_lines(void) {
     delete_shader(line_shader);
     delete_vertex_array(line_va);
-    free(line_vb_data);
+    tagged_free(line_vb_data);
 }
 
 static
@@ -187,8 +210,8 @@ void init_text(void) {
     // Allocate memory for text quads vertices and indices
     size_t vb_data_bytes = max_text_verts * sizeof(TextVertex);
     size_t ib_data_bytes = max_text_indices * sizeof(uint32_t);
-    text_vb_data = (TextVertex *)malloc(vb_data_bytes);
-    text_ib_data = (uint32_t *)malloc(ib_data_bytes);
+    text_vb_data = (TextVertex *)tagged_malloc(MEMORY_TAG_RENDER_BUFFERS, vb_data_bytes);
+    text_ib_data = (uint32_t *)tagged_malloc(MEMORY_TAG_RENDER_BUFFERS, ib_data_bytes);
     assert(text_vb_data != nullptr && text_ib_data != nullptr);
 
     // Setup text vertex buffer
@@ -235,8 +258,8 @@ static
 void free_text(void) {
     delete_shader(text_shader);
     delete_vertex_array(text_va);
-    free(text_vb_data);
-    free(text_ib_data);
+    tagged_free(text_vb_data);
+    tagged_free(text_ib_data);
 }
 
 static
@@ -268,6 +291,13 @@ void render::r_init(void) {
     assert(default_font     != NULL);
     assert(default_font_big != NULL);
 
+    gpu_timers_available = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if(gpu_timers_available) {
+        glGenQueries(GPU_TIMER_LATENCY * MAX_GPU_TIMERS, &gpu_queries[0][0]);
+    } else {
+        printf("Timer queries not available, GPU timers are disabled.\n");
+    }
+
     renderer_initialized = true;
     _reset_renderer();
 }
@@ -280,6 +310,11 @@ void render::r_quit(void) {
     delete_texture(white_texture);
     delete_font(default_font);
 
+    if(gpu_timers_available) {
+        glDeleteQueries(GPU_TIMER_LATENCY * MAX_GPU_TIMERS, &gpu_queries[0][0]);
+        gpu_timers_available = false;
+    }
+
     free_quads();
     free_lines();
     free_text();
@@ -327,6 +362,8 @@ void flush(void) {
     if(!pushed_quads && !pushed_lines && !pushed_text_quads) {
         return;
     }
+    PROFILE_FUNCTION();
+    const uint64_t flush_begin = SDL_GetPerformanceCounter();
 
     if(render_setup.framebuffer) {
         render_setup.framebuffer->bind();
@@ -402,6 +439,7 @@ void flush(void) {
     render_stats.text_quads += pushed_text_quads;
     
     _reset_renderer();
+    flush_ticks += SDL_GetPerformanceCounter() - flush_begin;
 }
 
 void render::r_end(void) {
@@ -473,6 +511,7 @@ void quad_base(vec2i positions[4], int32_t z_pos, vec2 tex_coords[4], vec4 color
         next_vertex += 1;
     }
     pushed_quads += 1;
+    quads_pushed += 1;
 }
 
 inline static
@@ -621,6 +660,7 @@ void text_quad_base(vec2 positions[4], int32_t z_pos, vec2 tex_coords[4], vec4 c
         next_vertex += 1;
     }
     pushed_text_quads += 1;
+    quads_pushed += 1;
 }
 
 // Special characters are not handled -> maybe @todo support '\n' and stuff
@@ -739,6 +779,87 @@ RenderStats render::r_reset_stats(void) {
     return stats;
 }
 
+uint64_t render::r_get_quads_pushed(void) {
+    return quads_pushed;
+}
+
+uint64_t render::r_get_flush_ticks(void) {
+    return flush_ticks;
+}
+
+void render::r_gpu_timer_begin(const char *label) {
+    if(!gpu_timers_available) {
+        return;
+    }
+    assert(scene_began == false, "GPU timer started inside of a scene.");
+    assert(gpu_timer_active == -1, "GPU timers can't be nested.");
+
+    GpuTimerFrame *frame = &gpu_timer_frames[gpu_timer_frame_idx];
+    if(frame->count >= MAX_GPU_TIMERS) {
+        return;
+    }
+
+    gpu_timer_active = frame->count++;
+    frame->labels[gpu_timer_active] = label;
+    glBeginQuery(GL_TIME_ELAPSED, gpu_queries[gpu_timer_frame_idx][gpu_timer_active]);
+    gpu_timer_cpu_begin = SDL_GetPerformanceCounter();
+#if defined(ENABLE_PROFILER)
+    gpu_timer_zone_begin = profiler_begin_zone();
+#endif
+}
+
+void render::r_gpu_timer_end(void) {
+    if(gpu_timer_active == -1) {
+        return;
+    }
+
+    GpuTimerFrame *frame = &gpu_timer_frames[gpu_timer_frame_idx];
+#if defined(ENABLE_PROFILER)
+    profiler_end_zone(frame->labels[gpu_timer_active], gpu_timer_zone_begin);
+#endif
+    glEndQuery(GL_TIME_ELAPSED);
+    frame->cpu_times[gpu_timer_active] = (float64_t)(SDL_GetPerformanceCounter() - gpu_timer_cpu_begin) / (float64_t)SDL_GetPerformanceFrequency();
+    gpu_timer_active = -1;
+}
+
+void render::r_gpu_timers_end_frame(void) {
+    if(!gpu_timers_available) {
+        return;
+    }
+    assert(gpu_timer_active == -1, "GPU timer still running at the end of the frame.");
+
+    // Oldest frame, its slots get reused now
+    gpu_timer_frame_idx = (gpu_timer_frame_idx + 1) % GPU_TIMER_LATENCY;
+    GpuTimerFrame *frame = &gpu_timer_frames[gpu_timer_frame_idx];
+    if(frame->count == 0) {
+        return;
+    }
+
+    // Queries finish in order, if the last one is done the rest are too. If it isn't the frame is skipped
+    GLint available = 0;
+    glGetQueryObjectiv(gpu_queries[gpu_timer_frame_idx][frame->count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(available) {
+        for(int32_t idx = 0; idx < frame->count; ++idx) {
+            GLuint64 elapsed_ns = 0;
+            glGetQueryObjectui64v(gpu_queries[gpu_timer_frame_idx][idx], GL_QUERY_RESULT, &elapsed_ns);
+            gpu_timings[idx].label    = frame->labels[idx];
+            gpu_timings[idx].gpu_time = (float64_t)elapsed_ns / 1000000000.0;
+            gpu_timings[idx].cpu_time = frame->cpu_times[idx];
+        }
+        gpu_timing_count = frame->count;
+    }
+    frame->count = 0;
+}
+
+bool render::r_gpu_timers_available(void) {
+    return gpu_timers_available;
+}
+
+const GpuTiming *render::r_get_gpu_timings(int32_t *out_count) {
+    *out_count = gpu_timing_count;
+    return gpu_timings;
+}
+
 Font *render::def_font(void) {
     return default_font;
 }
@@ -856,13 +977,14 @@ void reset_anim_player(AnimPlayer *anim) {
 #include "data.h"
 
 Font *load_ttf_font_from_memory(uint8_t *_font_data, size_t font_data_size, int32_t height, int32_t atlas_width, int32_t atlas_height) {
-    uint8_t *font_data = (uint8_t *)malloc(font_data_size);
+    uint8_t *font_data = (uint8_t *)tagged_malloc(MEMORY_TAG_FONT, font_data_size);
     assert(font_data);
     memcpy_s(font_data, font_data_size, _font_data, font_data_size);
 
-    stbtt_fontinfo *font_info = malloc_struct(stbtt_fontinfo);
+    stbtt_fontinfo *font_info = tagged_malloc_struct(MEMORY_TAG_FONT, stbtt_fontinfo);
     if(stbtt_InitFont(font_info, font_data, 0) == 0) {
-        free_file(font_data);
+        tagged_free(font_info);
+        tagged_free(font_data);
         return NULL;
     }
 
@@ -876,11 +998,11 @@ Font *load_ttf_font_from_memory(uint8_t *_font_data, size_t font_data_size, int3
     int32_t atlas_w = atlas_width;
     int32_t atlas_h = atlas_height;
     int32_t atlas_bpp = 1;
-    uint8_t *atlas_bitmap = (uint8_t *)malloc_and_zero(atlas_w * atlas_h * atlas_bpp);
+    uint8_t *atlas_bitmap = (uint8_t *)tagged_malloc_and_zero(MEMORY_TAG_FONT, atlas_w * atlas_h * atlas_bpp);
     assert(atlas_bitmap);
 
     const int32_t num_nodes = 4096;
-    stbrp_node *rp_nodes = (stbrp_node *)malloc(sizeof(stbrp_node) * num_nodes);
+    stbrp_node *rp_nodes = (stbrp_node *)tagged_malloc(MEMORY_TAG_FONT, sizeof(stbrp_node) * num_nodes);
     assert(rp_nodes);
 
     stbrp_context rect_pack_context;
@@ -931,10 +1053,10 @@ Font *load_ttf_font_from_memory(uint8_t *_font_data, size_t font_data_size, int3
     Texture *atlas_texture = create_texture((void *)atlas_bitmap, atlas_w, atlas_h, atlas_bpp, GL_RED, GL_UNSIGNED_BYTE, GL_RED);
     assert(atlas_texture);
 
-    free(rp_nodes);
-    free(atlas_bitmap);
+    tagged_free(rp_nodes);
+    tagged_free(atlas_bitmap);
 
-    auto font = malloc_and_zero_struct(Font);
+    auto font = tagged_malloc_and_zero_struct(MEMORY_TAG_FONT, Font);
     font->stbtt_font_info = (void *)font_info;
     font->font_data = font_data;
     font->height = height;
@@ -960,11 +1082,11 @@ Font *load_ttf_font(const char *filepath, int32_t height, int32_t atlas_width, i
 }
 
 void delete_font(Font *font) {
-    free(font->stbtt_font_info);
-    free(font->font_data);
+    tagged_free(font->stbtt_font_info);
+    tagged_free(font->font_data);
     delete font->glyphs;
     delete_texture(font->texture);
-    free(font);
+    tagged_free(font);
 }
 
 Font::Glyph *Font::get_glyph(int32_t codepoint) {
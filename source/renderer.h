@@ -11,6 +11,16 @@
 #define R_DEF_FONT_HEIGHT     18
 #define R_DEF_FONT_BIG_HEIGHT 64
 
+#define MAX_GPU_TIMERS    16 // Per frame, scopes past this aren't timed
+#define GPU_TIMER_LATENCY 4  // Frames of queries kept, the end of a frame reads the one from GPU_TIMER_FRAMES_BEHIND frames before
+#define GPU_TIMER_FRAMES_BEHIND (GPU_TIMER_LATENCY - 1)
+
+struct GpuTiming {
+    const char *label;
+    float64_t   gpu_time; // Seconds
+    float64_t   cpu_time; // Of the same frame, between the begin and end calls
+};
+
 struct RenderStats {
     uint32_t draw_calls;
     uint32_t quads;
@@ -43,6 +53,17 @@ namespace render {
     void r_set_flip_x_quads(int32_t num = 1);
     void r_set_flip_y_quads(int32_t num = 1);
     RenderStats r_reset_stats(void);
+    uint64_t r_get_quads_pushed(void); // Since start, text quads included
+    uint64_t r_get_flush_ticks(void);  // Performance counter ticks spent submitting to the GPU since start
+
+    /* --- GPU timers --- */
+    // Time query around a render pass, call outside of r_begin / r_end so the pass is flushed in between. Don't nest.
+    // Results are read GPU_TIMER_FRAMES_BEHIND frames later if the GPU is done with them, so it never waits. No-ops without timer queries.
+    void r_gpu_timer_begin(const char *label); // Label has to live for the whole run
+    void r_gpu_timer_end(void);
+    void r_gpu_timers_end_frame(void); // After the swap
+    bool r_gpu_timers_available(void);
+    const GpuTiming *r_get_gpu_timings(int32_t *out_count); // Latest frame that was read back
     
     /* --- Quads --- */
     void r_quad(vec2i position, int32_t z_pos, vec2i size, vec4 color);
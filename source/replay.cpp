@@ -0,0 +1,293 @@
+#include "replay.h"
+#include "input_session.h"
+#include "level.h"
+#include "save_data.h"
+#include "game.h"
+#include "renderer.h"
+#include "data.h"
+#include "profiler.h"
+#include "frame_timings.h"
+#include "all_entities.h"
+#include "parallel_update.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+namespace {
+    struct ZoneStats {
+        float64_t mean; // ms
+        float64_t p50;
+        float64_t p95;
+        float64_t max;
+    };
+
+    // Frame major, times[frame * runs + run] in ms. A zone that didn't run in a frame took 0
+    typedef std::map<std::string, std::vector<float64_t>> ZoneTimes;
+
+    const char *stage_zones[] = { "simulation", "render record" };
+}
+
+static
+void add_zone_time(ZoneTimes *zones, const std::string &zone, int32_t sample_count, int32_t sample_idx, float64_t ms) {
+    std::vector<float64_t> &times = (*zones)[zone];
+    if(times.empty()) {
+        times.resize(sample_count, 0.0);
+    }
+    times[sample_idx] += ms;
+}
+
+static
+ZoneStats summarize_zone(const std::vector<float64_t> &times, int32_t frames, int32_t runs) {
+    std::vector<float64_t> per_frame(frames);
+    std::vector<float64_t> runs_of_frame(runs);
+    for(int32_t frame = 0; frame < frames; ++frame) {
+        std::copy(times.begin() + frame * runs, times.begin() + (frame + 1) * runs, runs_of_frame.begin());
+        std::nth_element(runs_of_frame.begin(), runs_of_frame.begin() + runs / 2, runs_of_frame.end());
+        per_frame[frame] = runs_of_frame[runs / 2];
+    }
+    std::sort(per_frame.begin(), per_frame.end());
+
+    ZoneStats stats = { };
+    for(float64_t time : per_frame) {
+        stats.mean += time;
+    }
+    stats.mean /= (float64_t)frames;
+    stats.p50 = per_frame[min_value((int32_t)(0.50 * (float64_t)frames), frames - 1)];
+    stats.p95 = per_frame[min_value((int32_t)(0.95 * (float64_t)frames), frames - 1)];
+    stats.max = per_frame[frames - 1];
+    return stats;
+}
+
+// Lines of "zone,mean ms,p50 ms,p95 ms,max ms", the zone is split off at the last four commas because of template names.
+// The comment line has the workers of the parallel update, -1 if it's not there
+static
+bool read_baseline(const char *filepath, std::map<std::string, ZoneStats> *out_baseline, int32_t *out_workers) {
+    std::ifstream in_file;
+    in_file.open(filepath);
+    if(!in_file.is_open()) {
+        return false;
+    }
+
+    *out_workers = -1;
+
+    std::string line;
+    std::getline(in_file, line); // Header
+    while(std::getline(in_file, line)) {
+        if(!line.empty() && line[0] == '#') {
+            int32_t frames, runs, workers;
+            if(sscanf_s(line.c_str(), "# %*[^,], %d frames, %d runs, %d workers", &frames, &runs, &workers) == 3) {
+                *out_workers = workers;
+            }
+            continue;
+        }
+        if(line.empty()) {
+            continue;
+        }
+
+        size_t idx = line.size();
+        for(int32_t field = 0; field < 4 && idx != std::string::npos && idx > 0; ++field) {
+            idx = line.rfind(',', idx - 1);
+        }
+        if(idx == std::string::npos || idx == 0) {
+            continue;
+        }
+
+        ZoneStats stats;
+        const char *values = line.c_str() + idx + 1;
+        char *end = NULL;
+        stats.mean = strtod(values, &end);
+        stats.p50  = strtod(end + 1, &end);
+        stats.p95  = strtod(end + 1, &end);
+        stats.max  = strtod(end + 1, &end);
+        (*out_baseline)[line.substr(0, idx)] = stats;
+    }
+    return true;
+}
+
+static
+bool write_baseline(const char *filepath, InputSession *session, int32_t runs, int32_t workers, const std::vector<std::pair<std::string, ZoneStats>> &zones) {
+    char buffer[512];
+    sprintf_s(buffer, array_count(buffer), "zone,mean ms,p50 ms,p95 ms,max ms\n# %s, %d frames, %d runs, %d workers\n", session->level_name.c_str(), (int32_t)session->frames.size(), runs, workers);
+    std::string csv = buffer;
+    for(auto &zone : zones) {
+        sprintf_s(buffer, array_count(buffer), "%s,%.5f,%.5f,%.5f,%.5f\n", zone.first.c_str(), zone.second.mean, zone.second.p50, zone.second.p95, zone.second.max);
+        csv += buffer;
+    }
+
+    if(!save_file(filepath, (char *)csv.c_str(), csv.size())) {
+        fprintf(stderr, "Failed to write the baseline to \"%s\".\n", filepath);
+        return false;
+    }
+    printf("Baseline of %d zones written to \"%s\".\n", (int32_t)zones.size(), filepath);
+    return true;
+}
+
+// Stages first, in their order
+static
+int32_t zone_rank(const std::string &zone) {
+    for(int32_t idx = 0; idx < array_count(stage_zones); ++idx) {
+        if(zone == stage_zones[idx]) return idx;
+    }
+    return array_count(stage_zones);
+}
+
+static
+float64_t delta_percent(float64_t base, float64_t time) {
+    return base > 0.0 ? (time - base) / base * 100.0 : 0.0;
+}
+
+int32_t run_replay(ReplayOptions options) {
+    InputSession session;
+    if(!load_input_session(options.session_path, &session)) {
+        fprintf(stderr, "Couldn't load the input session \"%s\".\n", options.session_path);
+        return 2;
+    }
+
+    Level *pristine = create_empty_level();
+    load_level(pristine, (global_data::get_data_path() + "\\levels\\" + session.level_name).c_str());
+    if(pristine->entities.count == 0) {
+        fprintf(stderr, "Couldn't load the level \"%s\" of the input session.\n", session.level_name.c_str());
+        delete_level(pristine);
+        return 2;
+    }
+
+    const int32_t frames = (int32_t)session.frames.size();
+    const int32_t runs   = max_value(options.runs, 1);
+    const int32_t sample_count = frames * runs;
+
+    RenderSetup setup;
+    setup.viewport = { 0, 0, GAME_WIDTH, GAME_HEIGHT };
+    setup.framebuffer = NULL;
+
+    // Timed on the same update path as the game, a worker count of 0 still has the job system but no workers
+    init_parallel_update(options.jobs);
+    const int32_t workers = get_parallel_update_worker_count();
+
+    // Only the session state, update_level doesn't read anything else of the game
+    Game *game = malloc_and_zero_struct(Game);
+    Level *level = NULL;
+    ZoneTimes zone_times;
+    vec2i first_end_position = { };
+    bool diverged = false;
+
+    for(int32_t run = 0; run < runs; ++run) {
+        // Bowser picks his jumps and fire with rand(), every run has to see the same ones to time the same frames
+        srand(1);
+        recreate_level_from_clone(&level, pristine);
+        reset_session_for_level(game, session.level_name);
+
+        for(int32_t frame = 0; frame < frames; ++frame) {
+            const InputSessionFrame &session_frame = session.frames[frame];
+
+            profiler_begin_frame();
+            begin_frame_timings();
+
+            begin_frame_stage(FRAME_STAGE_SIMULATION);
+            update_level(level, unpack_sim_input(session_frame.input_bits), game, session_frame.delta_time);
+            end_frame_stage(FRAME_STAGE_SIMULATION);
+
+            begin_frame_stage(FRAME_STAGE_RENDER_RECORD);
+            RenderView *view = &level->render_view;
+            setup.proj_m = view->calc_proj();
+            setup.view_m = view->calc_view();
+            render::r_begin(setup);
+            render_level(level);
+            render::r_end();
+            end_frame_stage(FRAME_STAGE_RENDER_RECORD);
+
+            profiler_end_frame();
+            end_frame_timings();
+
+            const int32_t sample_idx = frame * runs + run;
+            add_zone_time(&zone_times, stage_zones[0], sample_count, sample_idx, get_frame_stage_time(FRAME_STAGE_SIMULATION, 0) * 1000.0);
+            add_zone_time(&zone_times, stage_zones[1], sample_count, sample_idx, get_frame_stage_time(FRAME_STAGE_RENDER_RECORD, 0) * 1000.0);
+#if defined(ENABLE_PROFILER)
+            for(const ProfileZoneRecord &zone : get_profiler_last_frame()->zones) {
+                add_zone_time(&zone_times, zone.name, sample_count, sample_idx, profiler_ticks_to_ms(zone.end - zone.begin));
+            }
+#endif
+        }
+
+        // Same input has to end up in the same place, otherwise the runs timed different frames
+        Player *player = get_player(level);
+        const vec2i end_position = player != NULL ? player->position : vec2i{ };
+        if(run == 0) {
+            first_end_position = end_position;
+        } else if(end_position.x != first_end_position.x || end_position.y != first_end_position.y) {
+            diverged = true;
+        }
+    }
+
+    delete_level(level);
+    delete_level(pristine);
+    free(game);
+    free_parallel_update();
+
+    // Stages first, then the zones by their p50
+    std::vector<std::pair<std::string, ZoneStats>> zones;
+    for(auto &zone : zone_times) {
+        zones.push_back({ zone.first, summarize_zone(zone.second, frames, runs) });
+    }
+    std::sort(zones.begin(), zones.end(), [] (const std::pair<std::string, ZoneStats> &a, const std::pair<std::string, ZoneStats> &b) {
+        const int32_t a_rank = zone_rank(a.first);
+        const int32_t b_rank = zone_rank(b.first);
+        if(a_rank != b_rank) return a_rank < b_rank;
+        return a.second.p50 > b.second.p50;
+    });
+
+    printf("replay of %s, %d frames, %d runs, %d workers\n", session.level_name.c_str(), frames, runs, workers);
+    if(diverged) {
+        printf("warning: the runs didn't end the same, the simulation isn't deterministic\n");
+    }
+
+    if(options.write_baseline_path != NULL && !write_baseline(options.write_baseline_path, &session, runs, workers, zones)) {
+        return 2;
+    }
+
+    std::map<std::string, ZoneStats> baseline;
+    int32_t baseline_workers = -1;
+    const bool has_baseline = options.baseline_path != NULL;
+    if(has_baseline && !read_baseline(options.baseline_path, &baseline, &baseline_workers)) {
+        fprintf(stderr, "Couldn't read the baseline \"%s\".\n", options.baseline_path);
+        return 2;
+    }
+    if(has_baseline && baseline_workers != -1 && baseline_workers != workers) {
+        printf("warning: the baseline was taken with %d workers, this replay has %d (--jobs)\n", baseline_workers, workers);
+    }
+
+    if(!has_baseline) {
+        printf("%-40s %9s %9s %9s %9s\n", "zone", "mean ms", "p50 ms", "p95 ms", "max ms");
+        for(auto &zone : zones) {
+            printf("%-40s %9.4f %9.4f %9.4f %9.4f\n", zone.first.c_str(), zone.second.mean, zone.second.p50, zone.second.p95, zone.second.max);
+        }
+        return 0;
+    }
+
+    int32_t slower_zones = 0;
+    printf("%-40s %9s %9s %8s %9s %9s %8s\n", "zone", "base p50", "p50", "delta", "base p95", "p95", "delta");
+    for(auto &zone : zones) {
+        auto found = baseline.find(zone.first);
+        if(found == baseline.end()) {
+            printf("%-40s %9s %9.4f %8s %9s %9.4f %8s  new\n", zone.first.c_str(), "-", zone.second.p50, "", "-", zone.second.p95, "");
+            continue;
+        }
+
+        const ZoneStats &base = found->second;
+        const bool judged = base.p50 >= REPLAY_MIN_JUDGED_TIME;
+        const bool slower = judged && (zone.second.p50 > base.p50 * (1.0 + options.tolerance) || zone.second.p95 > base.p95 * (1.0 + options.tolerance));
+        slower_zones += slower ? 1 : 0;
+
+        printf("%-40s %9.4f %9.4f %+7.1f%% %9.4f %9.4f %+7.1f%%  %s\n", zone.first.c_str(),
+               base.p50, zone.second.p50, delta_percent(base.p50, zone.second.p50),
+               base.p95, zone.second.p95, delta_percent(base.p95, zone.second.p95),
+               slower ? "SLOWER" : (judged ? "ok" : "too short"));
+        baseline.erase(found);
+    }
+    for(auto &zone : baseline) {
+        printf("%-40s %9.4f %9s %8s %9.4f %9s %8s  gone\n", zone.first.c_str(), zone.second.p50, "-", "", zone.second.p95, "-", "");
+    }
+
+    printf("%s, %d zones more than %.0f%% slower than the baseline\n", slower_zones > 0 ? "FAIL" : "PASS", slower_zones, options.tolerance * 100.0);
+    return slower_zones > 0 ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include "common.h"
+
+// Frame time regression check of no_name_bench --replay. An input session is replayed headlessly runs times and every frame's
+// simulation and render record times are taken, with ENABLE_PROFILER also the profiler zones (all threads added up).
+// A zone's time at a frame is the median of the runs, the p50 and p95 over the frames are compared with the baseline CSV.
+
+#define REPLAY_MIN_JUDGED_TIME 0.01 // ms, zones faster than this in the baseline are printed but can't fail
+
+struct ReplayOptions {
+    const char *session_path;
+    const char *baseline_path;       // NULL only prints the times
+    const char *write_baseline_path; // NULL doesn't write one
+    int32_t   runs;
+    int32_t   jobs;                  // Workers of the parallel update, < 0 picks like the game does. Written to the baseline
+    float64_t tolerance;             // 0.1 fails a zone that got more than 10% slower
+};
+
+int32_t run_replay(ReplayOptions options); // 0 passed, 1 a zone got slower, 2 couldn't replay
+
+#endif /* _REPLAY_H */
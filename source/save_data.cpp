@@ -1,5 +1,7 @@
 #include "save_data.h"
 #include "all_entities.h"
+#include "level_stream.h"
+#include "profiler.h"
 #include <fstream>
 
 #define SERIALIZE(Type) if(entity_type_id == entity_type_id(Type)) { return serialize_entity_##Type; }
@@ -10,80 +12,170 @@ entity_serialize_proc *get_serialize_proc(int32_t entity_type_id)   { TO_SERIALI
 entity_deserialize_proc *get_deserialize_proc(int32_t entity_type_id) { TO_SERIALIZE return NULL; }
 #undef SERIALIZE
 
-void load_level_from_save_data(Level *level, LevelSaveData *save_data) {
+Entity *deserialize_entity(Level *level, const EntitySaveData *es_data) {
+    int32_t type_id;
+
+    /* Get type id */ {
+        std::string type_string;
+        if(!es_data->try_get_string("type", &type_string)) {
+            printf("Error: Couldn't load entity (corrupted).\n");
+            return NULL;
+        } else {
+            type_id = entity_type_id_from_string(type_string.c_str());
+        }
+    }
+
+    entity_deserialize_proc *deserialize_proc = get_deserialize_proc(type_id);
+    if(deserialize_proc == NULL) {
+        return NULL;
+    }
+
+    Entity *entity = deserialize_proc(level, es_data);
+    if(entity == NULL) {
+        fprintf(stderr, "Failed to load entity <%s>! (possibly corrupted)\n", entity_type_string[type_id]);
+        // @todo What should happen, for now just continue
+    }
+    return entity;
+}
+
+void load_level_from_save_data(Level *level, LevelSaveData *save_data, bool allow_streaming) {
+    PROFILE_FUNCTION();
+
     if(level->entities.count != 0) {
         recreate_empty_level(&level); // @check
     }
 
     level->disable_level_timer = save_data->disable_level_timer;
+    level->stream_sections     = save_data->stream_sections;
     level->level_music_id[(int32_t)ELevelMusic::regular]                       = save_data->level_music_id[(int32_t)ELevelMusic::regular];
     level->level_music_id[(int32_t)ELevelMusic::during_star_power]             = save_data->level_music_id[(int32_t)ELevelMusic::during_star_power];
     level->level_music_id[(int32_t)ELevelMusic::during_player_enter_pipe_anim] = save_data->level_music_id[(int32_t)ELevelMusic::during_player_enter_pipe_anim];
     level->level_music_id[(int32_t)ELevelMusic::on_level_completed]            = save_data->level_music_id[(int32_t)ELevelMusic::on_level_completed];
 
-    for(auto &es_data : save_data->entity_save_data) {
-        int32_t type_id;
+    if(level->stream_sections && allow_streaming) {
+        // Sections are loaded once the camera gets close
+        level->stream = create_level_stream();
+        level->stream->sections.resize(save_data->section_entity_counts.size());
+        for(int32_t idx = 0; idx < (int32_t)save_data->section_entity_counts.size(); ++idx) {
+            get_writable_section_entities(&level->stream->sections[idx])->reserve(save_data->section_entity_counts[idx]);
+        }
+    }
 
-        /* Get type id */ {
+    for(auto &es_data : save_data->entity_save_data) {
+        if(level->stream != NULL) {
             std::string type_string;
-            if(!es_data.try_get_string("type", &type_string)) {
-                printf("Error: Couldn't load entity (corrupted).\n");
+            if(es_data.try_get_string("type", &type_string) && is_streamed_entity_type(entity_type_id_from_string(type_string.c_str()))) {
+                int32_t section_idx;
+                if(!es_data.try_get_int32("section", &section_idx, 1)) {
+                    vec2i position = { };
+                    es_data.try_get_int32("position", position.e, 2);
+                    section_idx = get_level_section_idx(position.x);
+                }
+                add_streamed_entity(level->stream, section_idx, &es_data);
                 continue;
-            } else {
-                type_id = entity_type_id_from_string(type_string.c_str());
             }
         }
 
-        entity_deserialize_proc *deserialize_proc = get_deserialize_proc(type_id);
-        if(deserialize_proc != NULL) {
-            Entity *entity = deserialize_proc(level, &es_data);
-            if(entity == NULL) {
-                fprintf(stderr, "Failed to load entity <%s>! (possibly corrupted)\n", entity_type_string[type_id]);
-                // @todo What should happen, for now just continue
+        deserialize_entity(level, &es_data);
+    }
+}
+
+static
+void append_entity_data(std::string *data, int32_t entity_type_id, EntitySaveData *es_data) {
+    // Write common data
+    *data += "type : " + std::string(entity_type_string[entity_type_id]) + "\n";
+
+    for(auto save_value : es_data->save_values) {
+        if(save_value.first == "type") {
+            continue; // Entities kept by a level stream have it
+        }
+
+        // Write token
+        *data += save_value.first + " : ";
+
+        // Write values
+        bool first = true;
+        for(auto &value : save_value.second) {
+            if(!first) {
+                *data += ", ";
             }
+            *data += value;
+            first = false;
         }
+        *data += "\n";
     }
+    *data += "@next\n";
 }
 
 std::string generate_level_save_data(Level *level) {
     std::string data = { };
 
-    data += "disable_level_timer : " + std::string(BOOL_STRING(level->disable_level_timer)) + "\n";
-    data += "music_id_regular : "  + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::regular]]) + "\n";
-    data += "music_id_star : "     + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::during_star_power]]) + "\n";
-    data += "music_id_cutscene : " + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::during_player_enter_pipe_anim]]) + "\n";
-    data += "music_id_complete : " + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::on_level_completed]]) + "\n";
-    data += "@level_params\n";
+    // Streamed entities go after the others, grouped by section
+    std::string entities_data = { };
+    std::vector<std::vector<std::pair<int32_t, EntitySaveData>>> sections;
 
     for_every_entity(level, entity) {
         entity_serialize_proc *serialize_proc = get_serialize_proc(entity->entity_type_id);
         if(serialize_proc) {
-            // Write common data
-            data += "type : " + std::string(entity_type_string[entity->entity_type_id]) + "\n";
-
             EntitySaveData es_data = serialize_proc(entity);
-            for(auto save_value : es_data.save_values) {
-                // Write token
-                data += save_value.first + " : ";
-
-                // Write values
-                bool first = true;
-                for(auto &value : save_value.second) {
-                    if(!first) {
-                        data += ", ";
-                    }
-                    data += value;
-                    first = false;
+            if(level->stream_sections && is_streamed_entity_type(entity->entity_type_id)) {
+                const int32_t section_idx = get_level_section_idx(entity->position.x);
+                if(section_idx >= (int32_t)sections.size()) {
+                    sections.resize(section_idx + 1);
+                }
+                sections[section_idx].push_back({ entity->entity_type_id, es_data });
+            } else {
+                append_entity_data(&entities_data, entity->entity_type_id, &es_data);
+            }
+        }
+    }
+
+    // Entities of sections that aren't loaded in
+    if(level->stream_sections && level->stream != NULL) {
+        for(int32_t section_idx = 0; section_idx < (int32_t)level->stream->sections.size(); ++section_idx) {
+            for(auto &es_data : get_section_entities(&level->stream->sections[section_idx])) {
+                std::string type_string;
+                if(!es_data.try_get_string("type", &type_string)) {
+                    continue;
+                }
+                if(section_idx >= (int32_t)sections.size()) {
+                    sections.resize(section_idx + 1);
                 }
-                data += "\n";
+                sections[section_idx].push_back({ entity_type_id_from_string(type_string.c_str()), es_data });
             }
-            data += "@next\n";
         }
     }
+
+    std::vector<int32_t> section_entity_counts(sections.size());
+    for(int32_t section_idx = 0; section_idx < (int32_t)sections.size(); ++section_idx) {
+        section_entity_counts[section_idx] = (int32_t)sections[section_idx].size();
+        for(auto &section_entity : sections[section_idx]) {
+            section_entity.second.save_values["section"] = { std::to_string(section_idx) };
+            append_entity_data(&entities_data, section_entity.first, &section_entity.second);
+        }
+    }
+
+    data += "disable_level_timer : " + std::string(BOOL_STRING(level->disable_level_timer)) + "\n";
+    data += "stream_sections : "     + std::string(BOOL_STRING(level->stream_sections)) + "\n";
+    if(!section_entity_counts.empty()) {
+        data += "section_entity_counts : ";
+        for(int32_t section_idx = 0; section_idx < (int32_t)section_entity_counts.size(); ++section_idx) {
+            data += (section_idx == 0 ? "" : ", ") + std::to_string(section_entity_counts[section_idx]);
+        }
+        data += "\n";
+    }
+    data += "music_id_regular : "  + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::regular]]) + "\n";
+    data += "music_id_star : "     + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::during_star_power]]) + "\n";
+    data += "music_id_cutscene : " + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::during_player_enter_pipe_anim]]) + "\n";
+    data += "music_id_complete : " + std::string(music_string[level->level_music_id[(int32_t)ELevelMusic::on_level_completed]]) + "\n";
+    data += "@level_params\n";
+
+    data += entities_data;
     return data;
 }
 
 LevelSaveData parse_level_save_data(const char *filepath) {
+    PROFILE_FUNCTION();
     LevelSaveData level_save_data = { };
 
     std::ifstream in_file;
@@ -150,6 +242,14 @@ LevelSaveData parse_level_save_data(const char *filepath) {
                 std::string music_id_string = "";
 
                 if(!es_data.try_get_bool("disable_level_timer", &level_save_data.disable_level_timer, 1)) level_save_data.disable_level_timer = false;
+                if(!es_data.try_get_bool("stream_sections", &level_save_data.stream_sections, 1)) level_save_data.stream_sections = false;
+
+                std::vector<std::string> section_entity_counts;
+                if(es_data.try_get_all("section_entity_counts", &section_entity_counts)) {
+                    for(auto &count : section_entity_counts) {
+                        level_save_data.section_entity_counts.push_back(std::stoi(count));
+                    }
+                }
                 if(es_data.try_get_string("music_id_regular",  &music_id_string)) music_id_regular  = music_id_from_string(music_id_string.c_str());
                 if(es_data.try_get_string("music_id_star",     &music_id_string)) music_id_star     = music_id_from_string(music_id_string.c_str());
                 if(es_data.try_get_string("music_id_cutscene", &music_id_string)) music_id_cutscene = music_id_from_string(music_id_string.c_str());
@@ -166,9 +266,10 @@ LevelSaveData parse_level_save_data(const char *filepath) {
     return level_save_data;
 }
 
-void load_level(Level *level, const char *level_path, LevelSaveData *out_save_data) {
+void load_level(Level *level, const char *level_path, LevelSaveData *out_save_data, bool allow_streaming) {
+    PROFILE_FUNCTION();
     LevelSaveData save_data = parse_level_save_data(level_path);
-    load_level_from_save_data(level, &save_data);
+    load_level_from_save_data(level, &save_data, allow_streaming);
 
     if(out_save_data != NULL) {
         *out_save_data = save_data;
@@ -209,7 +310,7 @@ void EntitySaveData::add_bool(const char *token, bool *values, int32_t count) {
     }
 }
 
-bool EntitySaveData::try_get_int32(const char *token, int32_t *values, int32_t count) {
+bool EntitySaveData::try_get_int32(const char *token, int32_t *values, int32_t count) const {
     auto _int32_values = this->save_values.find(token);
     if(_int32_values == this->save_values.end() || _int32_values->second.size() != count) {
         return false;
@@ -220,7 +321,7 @@ bool EntitySaveData::try_get_int32(const char *token, int32_t *values, int32_t c
     return true;
 }
 
-bool EntitySaveData::try_get_float32(const char *token, float32_t *values, int32_t count) {
+bool EntitySaveData::try_get_float32(const char *token, float32_t *values, int32_t count) const {
     auto _float32_values = this->save_values.find(token);
     if(_float32_values == this->save_values.end() || _float32_values->second.size() != count) {
         return false;
@@ -231,7 +332,7 @@ bool EntitySaveData::try_get_float32(const char *token, float32_t *values, int32
     return true;
 }
 
-bool EntitySaveData::try_get_string(const char *token, std::string *strings, int32_t count) {
+bool EntitySaveData::try_get_string(const char *token, std::string *strings, int32_t count) const {
     auto _strings = this->save_values.find(token);
     if(_strings == this->save_values.end() || _strings->second.size() != count) {
         return false;
@@ -242,7 +343,7 @@ bool EntitySaveData::try_get_string(const char *token, std::string *strings, int
     return true;
 }
 
-bool EntitySaveData::try_get_cstring(const char *token, const char **cstrings, int32_t *sizes, int32_t count) {
+bool EntitySaveData::try_get_cstring(const char *token, const char **cstrings, int32_t *sizes, int32_t count) const {
     auto _strings = this->save_values.find(token);
     if(_strings == this->save_values.end() || _strings->second.size() != count) {
         return false;
@@ -253,11 +354,11 @@ bool EntitySaveData::try_get_cstring(const char *token, const char **cstrings, i
     return true;
 }
 
-bool EntitySaveData::try_get_cstring(const char *token, const char *cstring, int32_t size) {
+bool EntitySaveData::try_get_cstring(const char *token, const char *cstring, int32_t size) const {
     return this->try_get_cstring(token, &cstring, &size, 1);
 }
 
-bool EntitySaveData::try_get_bool(const char *token, bool *values, int32_t count) {
+bool EntitySaveData::try_get_bool(const char *token, bool *values, int32_t count) const {
     auto _bool_values = this->save_values.find(token);
     if(_bool_values == this->save_values.end() || _bool_values->second.size() != count) {
         return false;
@@ -274,11 +375,11 @@ bool EntitySaveData::try_get_bool(const char *token, bool *values, int32_t count
     return true;
 }
 
-bool EntitySaveData::try_get_all(const char *token, std::vector<std::string> *values) {
+bool EntitySaveData::try_get_all(const char *token, std::vector<std::string> *values) const {
     auto _values = this->save_values.find(token);
     if(_values == this->save_values.end()) {
         return false;
     }
-    *values = _values->second;
+    values->assign(_values->second.begin(), _values->second.end());
     return true;
 }
\ No newline at end of file
@@ -4,10 +4,11 @@
 #include "common.h"
 #include "maths.h"
 #include "level.h"
+#include "memory_tags.h"
 
 // Serialize function declarations
 #define _ENTITY_SERIALIZE_PROC(name)   struct EntitySaveData name(struct Entity *self_base)
-#define _ENTITY_DESERIALIZE_PROC(name) struct Entity *name(struct Level *level, struct EntitySaveData *es_data)
+#define _ENTITY_DESERIALIZE_PROC(name) struct Entity *name(struct Level *level, const struct EntitySaveData *es_data)
 typedef _ENTITY_SERIALIZE_PROC(entity_serialize_proc);
 typedef _ENTITY_DESERIALIZE_PROC(entity_deserialize_proc);
 
@@ -17,6 +18,12 @@ typedef _ENTITY_DESERIALIZE_PROC(entity_deserialize_proc);
 
 // @todo Including commas in strings is bad... Should make strings be betwen ""
 
+// Accounted under MEMORY_TAG_SAVE_DATA, strings too long to be stored inline still come from the default allocator
+template<typename T>
+using SaveDataVector = std::vector<T, TaggedAllocator<T, MEMORY_TAG_SAVE_DATA>>;
+typedef std::unordered_map<std::string, SaveDataVector<std::string>, std::hash<std::string>, std::equal_to<std::string>,
+                           TaggedAllocator<std::pair<const std::string, SaveDataVector<std::string>>, MEMORY_TAG_SAVE_DATA>> SaveValues;
+
 struct EntitySaveData {
     void add_int32(const char *token, int32_t *values, int32_t count);
     void add_float32(const char *token, float32_t *values, int32_t count);
@@ -25,27 +32,33 @@ struct EntitySaveData {
     void add_cstring(const char *token, const char **cstrings, int32_t count);
     void add_bool(const char *token, bool *values, int32_t count);
 
-    bool try_get_int32(const char *token, int32_t *values, int32_t count = 1);
-    bool try_get_float32(const char *token, float32_t *values, int32_t count = 1);
-    bool try_get_string(const char *token, std::string *strings, int32_t count = 1);
-    bool try_get_cstring(const char *token, const char **cstrings, int32_t *sizes, int32_t count = 1);
-    bool try_get_cstring(const char *token, const char *cstring, int32_t size);
-    bool try_get_bool(const char *token, bool *values, int32_t count = 1);
+    bool try_get_int32(const char *token, int32_t *values, int32_t count = 1) const;
+    bool try_get_float32(const char *token, float32_t *values, int32_t count = 1) const;
+    bool try_get_string(const char *token, std::string *strings, int32_t count = 1) const;
+    bool try_get_cstring(const char *token, const char **cstrings, int32_t *sizes, int32_t count = 1) const;
+    bool try_get_cstring(const char *token, const char *cstring, int32_t size) const;
+    bool try_get_bool(const char *token, bool *values, int32_t count = 1) const;
 
-    bool try_get_all(const char *token, std::vector<std::string> *values);
+    bool try_get_all(const char *token, std::vector<std::string> *values) const;
 
-    std::unordered_map<std::string, std::vector<std::string>> save_values;
+    SaveValues save_values;
 };
 
 struct LevelSaveData {
     bool disable_level_timer;
+    bool stream_sections;
     int32_t level_music_id[(int32_t)ELevelMusic::__COUNT];
-    std::vector<EntitySaveData> entity_save_data;
+    SaveDataVector<int32_t> section_entity_counts; // Index of the streamed entities, those are written after the others sorted by section
+    SaveDataVector<EntitySaveData> entity_save_data;
 };
 
+entity_serialize_proc   *get_serialize_proc(int32_t entity_type_id);   // NULL if the type isn't serialized
+entity_deserialize_proc *get_deserialize_proc(int32_t entity_type_id); // NULL if the type isn't serialized
+Entity *deserialize_entity(Level *level, const EntitySaveData *es_data);     // Type comes from the "type" token
+
 std::string generate_level_save_data(Level *level);
 LevelSaveData parse_level_save_data(const char *filepath);
-void load_level_from_save_data(Level *level, LevelSaveData *save_data);
-void load_level(Level *level, const char *level_path, LevelSaveData *out_save_data = NULL);
+void load_level_from_save_data(Level *level, LevelSaveData *save_data, bool allow_streaming = false); // Streamed levels keep their sections as save data only if allowed, the editor wants everything
+void load_level(Level *level, const char *level_path, LevelSaveData *out_save_data = NULL, bool allow_streaming = false);
 
 #endif /* _SAVE_DATA_H */
\ No newline at end of file
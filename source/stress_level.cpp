@@ -0,0 +1,181 @@
+#include "stress_level.h"
+#include "all_entities.h"
+#include "save_data.h"
+#include "data.h"
+#include "game.h"
+
+namespace {
+    // What 1_2.level has
+    constexpr int32_t base_x_tiles        = 200;
+    constexpr int32_t base_goombas        = 14;
+    constexpr int32_t base_koopas         = 1;
+    constexpr int32_t base_piranhas       = 3;
+    constexpr int32_t base_coins          = 27;
+    constexpr int32_t base_fire_bars      = 2; // 1_2 has none, the castle levels do
+    constexpr int32_t base_platforms      = 4;
+    constexpr int32_t base_camera_regions = 5;
+
+    constexpr int32_t ground_y      = -2; // Tile rows below the camera regions, like the shipped levels
+    constexpr int32_t ground_height = 4;
+    constexpr int32_t surface_y     = ground_y + ground_height;
+    constexpr int32_t first_enemy_x = GAME_WIDTH / TILE_SIZE + 8;
+    constexpr int32_t player_x      = 3;
+}
+
+static
+uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static
+int32_t random_range(uint32_t *state, int32_t min, int32_t max) {
+    if(max <= min) {
+        return min;
+    }
+    return min + (int32_t)(next_random(state) % (uint32_t)(max - min));
+}
+
+static
+int32_t scale_count(int32_t base, float32_t scale) {
+    return max_value(0, (int32_t)((float32_t)base * scale + 0.5f));
+}
+
+StressLevelDesc stress_level_desc(float32_t density, float32_t length) {
+    StressLevelDesc desc;
+    desc.x_tiles         = max_value(first_enemy_x + 8, scale_count(base_x_tiles, length));
+    desc.y_tiles         = CameraRegion::const_height_in_tiles;
+    desc.goombas         = scale_count(base_goombas,        density * length);
+    desc.koopas          = scale_count(base_koopas,         density * length);
+    desc.piranhas        = scale_count(base_piranhas,       density * length);
+    desc.coins           = scale_count(base_coins,          density * length);
+    desc.fire_bars       = scale_count(base_fire_bars,      density * length);
+    desc.platforms       = scale_count(base_platforms,      density * length);
+    desc.camera_regions  = max_value(1, scale_count(base_camera_regions, density * length));
+    desc.stream_sections = false;
+    desc.seed            = 0x2545f491;
+    return desc;
+}
+
+bool is_stress_level_desc_valid(StressLevelDesc desc) {
+    return desc.x_tiles >= first_enemy_x + 8 && desc.y_tiles > surface_y - ground_y + 2 &&
+           desc.goombas >= 0 && desc.koopas >= 0 && desc.piranhas >= 0 && desc.coins >= 0 &&
+           desc.fire_bars >= 0 && desc.platforms >= 0 && desc.camera_regions >= 1 && desc.seed != 0;
+}
+
+Level *generate_stress_level(StressLevelDesc desc) {
+    assert(desc.x_tiles > 0 && desc.y_tiles > surface_y - ground_y + 2, "Stress level is too small.");
+    assert(desc.seed != 0, "xorshift needs a seed that isn't 0.");
+
+    Level *level = create_empty_level();
+    level->stream_sections = desc.stream_sections;
+    level->level_music_id[(int32_t)ELevelMusic::regular] = MUSIC_OVERWORLD;
+
+    uint32_t state = desc.seed;
+    const int32_t top_y = ground_y + desc.y_tiles - 1;
+
+    Tilemap *tilemap = spawn_tilemap(level, { 0, ground_y }, desc.x_tiles, desc.y_tiles);
+
+    /* Ground, brick rows and question blocks */ {
+        TileDesc ground = { };
+        ground.tile_flags  = TILE_FLAG_BLOCKS_MOVEMENT;
+        ground.tile_drop   = TILE_DROP_NONE;
+        ground.tile_sprite = TILE_SPRITE_COBBLESTONE;
+        ground.tile_sprite_after_drop = TILE_SPRITE_SOLID;
+
+        TileDesc brick = ground;
+        brick.tile_flags      = TILE_FLAG_BLOCKS_MOVEMENT | TILE_FLAG_DO_ANIM_ON_HIT | TILE_FLAG_BREAKABLE;
+        brick.tile_sprite     = TILE_SPRITE_BRICK;
+        brick.tile_break_anim = TILE_BREAK_ANIM_BRICK;
+
+        TileDesc question = ground;
+        question.tile_flags  = TILE_FLAG_BLOCKS_MOVEMENT | TILE_FLAG_DO_ANIM_ON_HIT | TILE_FLAG_CHANGES_SPRITE_AFTER_DROP;
+        question.tile_drop   = TILE_DROP_COINS;
+        question.drops_left  = 1;
+        question.is_animated = true;
+        question.tile_anim   = TILE_ANIM_QUESTION;
+        question.tile_sprite_after_drop = TILE_SPRITE_QUESTION_EMPTY;
+
+        for(int32_t x = 0; x < desc.x_tiles; ++x) {
+            for(int32_t y = 0; y < ground_height; ++y) {
+                tilemap->set_tile(x, y, ground);
+            }
+        }
+
+        // A row of five every 12 tiles, 3 above the ground so walkers pass under it
+        for(int32_t x = first_enemy_x; x + 5 < desc.x_tiles; x += 12) {
+            for(int32_t idx = 0; idx < 5; ++idx) {
+                tilemap->set_tile(x + idx, surface_y + 3 - ground_y, idx == 2 ? question : brick);
+            }
+        }
+    }
+
+    spawn_player(level, tile_info({ player_x, surface_y }).position);
+
+    for(int32_t idx = 0; idx < desc.goombas; ++idx) {
+        const int32_t x = random_range(&state, first_enemy_x, desc.x_tiles - 2);
+        spawn_goomba(level, tile_info({ x, surface_y }).position);
+    }
+
+    for(int32_t idx = 0; idx < desc.koopas; ++idx) {
+        const int32_t x = random_range(&state, first_enemy_x, desc.x_tiles - 2);
+        spawn_koopa(level, tile_info({ x, surface_y }).position);
+    }
+
+    // Without pipes, they go up and down in front of the ground
+    for(int32_t idx = 0; idx < desc.piranhas; ++idx) {
+        const int32_t x = random_range(&state, first_enemy_x, desc.x_tiles - 2);
+        spawn_piranha(level, tile_info({ x, surface_y }).position);
+    }
+
+    for(int32_t idx = 0; idx < desc.coins; ++idx) {
+        const int32_t x = random_range(&state, player_x + 2, desc.x_tiles - 1);
+        const int32_t y = random_range(&state, surface_y + 1, top_y - 1);
+        spawn_coin(level, tile_info({ x, y }).position);
+    }
+
+    // Every fire bar turns around a solid block of its own
+    for(int32_t idx = 0; idx < desc.fire_bars; ++idx) {
+        const int32_t x = random_range(&state, first_enemy_x, desc.x_tiles - 1);
+        const int32_t y = random_range(&state, surface_y + 5, top_y - 2);
+
+        TileDesc block = { };
+        block.tile_flags  = TILE_FLAG_BLOCKS_MOVEMENT;
+        block.tile_drop   = TILE_DROP_NONE;
+        block.tile_sprite = TILE_SPRITE_QUESTION_EMPTY;
+        block.tile_sprite_after_drop = TILE_SPRITE_SOLID;
+        tilemap->set_tile(x, y - ground_y, block);
+
+        spawn_fire_bar(level, tile_info({ x, y }).position + vec2i{ TILE_SIZE / 2, TILE_SIZE / 2 }, 6);
+    }
+
+    for(int32_t idx = 0; idx < desc.platforms; ++idx) {
+        const int32_t x = random_range(&state, first_enemy_x, desc.x_tiles - 8);
+        if(idx % 2 == 0) {
+            const int32_t y_start = tile_info({ x, surface_y }).position.y;
+            const int32_t y_end   = tile_info({ x, top_y }).position.y;
+            spawn_moving_platform(level, tile_info({ x, random_range(&state, surface_y, top_y) }).position, y_start, y_end);
+        } else {
+            spawn_side_moving_platform(level, tile_info({ x, surface_y + 6 }).position, 6 * TILE_SIZE);
+        }
+    }
+
+    // A fifth of the width like in 1_2, they overlap once there are more than five
+    const int32_t region_tiles = min_value(desc.x_tiles, max_value(GAME_WIDTH / TILE_SIZE, scale_count(desc.x_tiles, 1.0f / (float32_t)base_camera_regions)));
+    for(int32_t idx = 0; idx < desc.camera_regions; ++idx) {
+        const int32_t x = desc.camera_regions > 1 ? (desc.x_tiles - region_tiles) * idx / (desc.camera_regions - 1) : 0;
+        spawn_camera_region(level, tile_info({ x, 0 }).position.x, 0, region_tiles);
+    }
+
+    return level;
+}
+
+bool write_stress_level(const char *filepath, StressLevelDesc desc) {
+    Level *level = generate_stress_level(desc);
+    std::string data = generate_level_save_data(level);
+    delete_level(level);
+
+    return save_file(filepath, data.data(), data.size());
+}
@@ -0,0 +1,32 @@
+#ifndef _STRESS_LEVEL_H
+#define _STRESS_LEVEL_H
+
+#include "common.h"
+#include "level.h"
+
+// Synthetic levels to measure how load time, memory and frame cost scale with the amount of content.
+// A flat ground with brick rows and question blocks, the rest is placed at random from the seed so the same desc always gives the same level.
+// stress_level_desc(1.0f) has the counts of 1_2.level, enemies are kept out of the first screen so the player survives a while.
+
+struct StressLevelDesc {
+    int32_t x_tiles;
+    int32_t y_tiles;
+    int32_t goombas;
+    int32_t koopas;
+    int32_t piranhas;
+    int32_t coins;
+    int32_t fire_bars;
+    int32_t platforms;      // Every other one moves sideways
+    int32_t camera_regions; // Split the width evenly
+    bool     stream_sections;
+    uint32_t seed;
+};
+
+// density multiplies the counts on the same width, length multiplies the width and the counts with it
+StressLevelDesc stress_level_desc(float32_t density, float32_t length = 1.0f);
+bool is_stress_level_desc_valid(StressLevelDesc desc); // Counts aren't negative and the level is big enough for the ground and the player
+
+Level *generate_stress_level(StressLevelDesc desc);
+bool write_stress_level(const char *filepath, StressLevelDesc desc);
+
+#endif /* _STRESS_LEVEL_H */
@@ -0,0 +1,93 @@
+#include "stub_gl.h"
+#include "opengl_abs.h"
+
+namespace {
+    GLuint next_name = 1;
+}
+
+static void GLAPIENTRY stub_gen_names(GLsizei count, GLuint *names) {
+    for(GLsizei idx = 0; idx < count; ++idx) {
+        names[idx] = next_name++;
+    }
+}
+
+static void GLAPIENTRY stub_create_names(GLenum, GLsizei count, GLuint *names) { stub_gen_names(count, names); }
+static GLuint GLAPIENTRY stub_create_shader(GLenum) { return next_name++; }
+static GLuint GLAPIENTRY stub_create_program(void) { return next_name++; }
+static GLboolean GLAPIENTRY stub_is_shader(GLuint) { return GL_TRUE; }
+static GLint GLAPIENTRY stub_get_uniform_location(GLuint, const GLchar *) { return 0; }
+static GLenum GLAPIENTRY stub_check_framebuffer_status(GLuint, GLenum) { return GL_FRAMEBUFFER_COMPLETE; }
+
+// Compile and link status are all queried through these
+static void GLAPIENTRY stub_get_iv(GLuint, GLenum, GLint *params) { *params = GL_TRUE; }
+static void GLAPIENTRY stub_get_info_log(GLuint, GLsizei size, GLsizei *length, GLchar *log) {
+    if(length) *length = 0;
+    if(size > 0) log[0] = '\0';
+}
+static void GLAPIENTRY stub_get_query_ui64v(GLuint, GLenum, GLuint64 *params) { *params = 0; }
+
+static void GLAPIENTRY stub_delete_names(GLsizei, const GLuint *) { }
+static void GLAPIENTRY stub_name(GLuint) { }
+static void GLAPIENTRY stub_enum(GLenum) { }
+static void GLAPIENTRY stub_enum_name(GLenum, GLuint) { }
+static void GLAPIENTRY stub_name_name(GLuint, GLuint) { }
+static void GLAPIENTRY stub_shader_source(GLuint, GLsizei, const GLchar *const *, const GLint *) { }
+static void GLAPIENTRY stub_buffer_data(GLenum, GLsizeiptr, const void *, GLenum) { }
+static void GLAPIENTRY stub_buffer_sub_data(GLenum, GLintptr, GLsizeiptr, const void *) { }
+static void GLAPIENTRY stub_framebuffer_texture_2d(GLenum, GLenum, GLenum, GLuint, GLint) { }
+static void GLAPIENTRY stub_vertex_attrib_pointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) { }
+static void GLAPIENTRY stub_vertex_attrib_i_pointer(GLuint, GLint, GLenum, GLsizei, const void *) { }
+static void GLAPIENTRY stub_uniform_1f(GLint, GLfloat) { }
+static void GLAPIENTRY stub_uniform_1i(GLint, GLint) { }
+static void GLAPIENTRY stub_uniform_1iv(GLint, GLsizei, const GLint *) { }
+static void GLAPIENTRY stub_uniform_4f(GLint, GLfloat, GLfloat, GLfloat, GLfloat) { }
+static void GLAPIENTRY stub_uniform_matrix_4fv(GLint, GLsizei, GLboolean, const GLfloat *) { }
+
+void install_stub_gl(void) {
+    __glewGenBuffers           = stub_gen_names;
+    __glewGenVertexArrays      = stub_gen_names;
+    __glewGenQueries           = stub_gen_names;
+    __glewCreateTextures       = stub_create_names;
+    __glewCreateFramebuffers   = stub_gen_names;
+    __glewCreateShader         = stub_create_shader;
+    __glewCreateProgram        = stub_create_program;
+    __glewIsShader             = stub_is_shader;
+    __glewGetUniformLocation   = stub_get_uniform_location;
+    __glewCheckNamedFramebufferStatus = stub_check_framebuffer_status;
+
+    __glewGetShaderiv          = stub_get_iv;
+    __glewGetProgramiv         = stub_get_iv;
+    __glewGetQueryObjectiv     = stub_get_iv;
+    __glewGetShaderInfoLog     = stub_get_info_log;
+    __glewGetProgramInfoLog    = stub_get_info_log;
+    __glewGetQueryObjectui64v  = stub_get_query_ui64v;
+
+    __glewDeleteBuffers        = stub_delete_names;
+    __glewDeleteVertexArrays   = stub_delete_names;
+    __glewDeleteQueries        = stub_delete_names;
+    __glewDeleteFramebuffers   = stub_delete_names;
+    __glewDeleteShader         = stub_name;
+    __glewDeleteProgram        = stub_name;
+    __glewCompileShader        = stub_name;
+    __glewLinkProgram          = stub_name;
+    __glewUseProgram           = stub_name;
+    __glewBindVertexArray      = stub_name;
+    __glewEnableVertexAttribArray = stub_name;
+    __glewEndQuery             = stub_enum;
+    __glewBeginQuery           = stub_enum_name;
+    __glewBindBuffer           = stub_enum_name;
+    __glewBindFramebuffer      = stub_enum_name;
+    __glewBindTextureUnit      = stub_name_name;
+    __glewAttachShader         = stub_name_name;
+    __glewShaderSource         = stub_shader_source;
+    __glewBufferData           = stub_buffer_data;
+    __glewBufferSubData        = stub_buffer_sub_data;
+    __glewFramebufferTexture2D = stub_framebuffer_texture_2d;
+    __glewVertexAttribPointer  = stub_vertex_attrib_pointer;
+    __glewVertexAttribIPointer = stub_vertex_attrib_i_pointer;
+    __glewUniform1f            = stub_uniform_1f;
+    __glewUniform1i            = stub_uniform_1i;
+    __glewUniform1iv           = stub_uniform_1iv;
+    __glewUniform4f            = stub_uniform_4f;
+    __glewUniformMatrix4fv     = stub_uniform_matrix_4fv;
+}
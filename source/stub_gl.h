@@ -0,0 +1,11 @@
+#ifndef _STUB_GL_H
+#define _STUB_GL_H
+
+#include "common.h"
+
+// Points the GLEW loaded entry points the engine uses at no-ops, so the renderer and textures work without a window.
+// Object names are handed out from a counter and shaders always compile. Call instead of glewInit, before r_init.
+// GL 1.1 functions aren't loaded by GLEW, without a current context the system library ignores those.
+void install_stub_gl(void);
+
+#endif /* _STUB_GL_H */